@@ -4,7 +4,9 @@
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <sys/stat.h>
+#include "common/latencystats.h"
 #include "common/logger.h"
+#include "common/timeline.h"
 
 
 namespace Airwave {
@@ -13,7 +15,11 @@ namespace Airwave {
 DataPort::DataPort() :
 	id_(-1),
 	frameSize_(0),
-	buffer_(nullptr)
+	buffer_(nullptr),
+	stats_(nullptr),
+	requestTime_(0),
+	requestCommand_(Command::Response),
+	requestOpcode_(0)
 {
 }
 
@@ -48,6 +54,7 @@ bool DataPort::create(size_t frameSize)
 	}
 
 	new (controlBlock()) ControlBlock;
+	controlBlock()->layout = kLayoutVersion;
 
 	frameSize_ = frameSize;
 	return true;
@@ -76,6 +83,13 @@ bool DataPort::connect(int id)
 	}
 
 	size_t bufferSize = info.shm_segsz;
+	if(bufferSize < sizeof(ControlBlock) || controlBlock()->layout != kLayoutVersion) {
+		ERROR("Shared memory segment with id %d has incompatible layout", id);
+		shmdt(buffer_);
+		buffer_ = nullptr;
+		return false;
+	}
+
 	frameSize_ = bufferSize - sizeof(ControlBlock);
 
 	id_ = id;
@@ -138,10 +152,30 @@ void* DataPort::frameBuffer()
 }
 
 
+LatencyStats* DataPort::latencyStats() const
+{
+	return stats_;
+}
+
+
+void DataPort::setLatencyStats(LatencyStats* stats)
+{
+	stats_ = stats;
+}
+
+
 void DataPort::sendRequest()
 {
-	if(!isNull())
+	if(!isNull()) {
+		if(stats_) {
+			DataFrame* frame = this->frame<DataFrame>();
+			requestCommand_ = frame->command;
+			requestOpcode_ = frame->opcode;
+			requestTime_ = monotonicTime();
+		}
+
 		controlBlock()->request.post();
+	}
 }
 
 
@@ -160,7 +194,29 @@ bool DataPort::waitRequest(int msecs)
 
 bool DataPort::waitResponse(int msecs)
 {
-	return controlBlock()->response.wait(msecs);
+	TimelineScope scope("DataPort::waitResponse");
+
+	if(!controlBlock()->response.wait(msecs))
+		return false;
+
+	if(stats_)
+		stats_->record(requestCommand_, requestOpcode_, monotonicTime() - requestTime_);
+
+	return true;
+}
+
+
+bool DataPort::waitResponseUntil(const timespec& deadline)
+{
+	TimelineScope scope("DataPort::waitResponse");
+
+	if(!controlBlock()->response.waitUntil(deadline))
+		return false;
+
+	if(stats_)
+		stats_->record(requestCommand_, requestOpcode_, monotonicTime() - requestTime_);
+
+	return true;
 }
 
 
@@ -2,12 +2,16 @@
 #define COMMON_DATAPORT_H
 
 #include "common/event.h"
+#include "common/protocol.h"
 #include "common/types.h"
 
 
 namespace Airwave {
 
 
+class LatencyStats;
+
+
 class DataPort {
 public:
 	DataPort();
@@ -27,22 +31,38 @@ public:
 	template<typename T>
 	T* frame();
 
+	LatencyStats* latencyStats() const;
+	void setLatencyStats(LatencyStats* stats);
+
 	void sendRequest();
 	void sendResponse();
 
 	bool waitRequest(int msecs = -1);
 	bool waitResponse(int msecs = -1);
+	bool waitResponseUntil(const timespec& deadline);
 
 private:
+	// The version of the shared memory layout is checked on connect, so the endpoints of
+	// the different versions fail early. The request and the response events are placed
+	// on the separate cache lines, since they are written by the different processes.
 	struct ControlBlock {
-		Event request;
-		Event response;
+		u32 layout;
+		alignas(kCacheLineSize) Event request;
+		alignas(kCacheLineSize) Event response;
 	};
 
+	static const u32 kLayoutVersion = 2;
+
 	int id_;
 	size_t frameSize_;
 	void* buffer_;
 
+	// Round trips of the requests, sent through this port, are recorded into the stats.
+	LatencyStats* stats_;
+	u64 requestTime_;
+	Command requestCommand_;
+	i32 requestOpcode_;
+
 	ControlBlock* controlBlock();
 };
 
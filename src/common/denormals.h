@@ -0,0 +1,69 @@
+#ifndef COMMON_DENORMALS_H
+#define COMMON_DENORMALS_H
+
+#include <cmath>
+#include "common/types.h"
+
+
+namespace Airwave {
+
+
+// Sets the flush-to-zero and denormals-are-zero modes of the SSE unit for the current
+// thread, while the guard is alive. It helps the VST plugins, which do their math with
+// SSE and have no protection of their own, and slow down by an order of magnitude on the
+// decaying tails of the filters and reverbs. The x87 code isn't affected by these modes.
+class DenormalGuard {
+public:
+	explicit DenormalGuard(bool isEnabled) :
+		isEnabled_(isEnabled)
+	{
+#if defined(__i386__) || defined(__x86_64__)
+		if(isEnabled_) {
+			asm volatile("stmxcsr %0" : "=m"(mxcsr_));
+			u32 mxcsr = mxcsr_ | kFlushToZero | kDenormalsAreZero;
+			asm volatile("ldmxcsr %0" : : "m"(mxcsr));
+		}
+#endif
+	}
+
+	~DenormalGuard()
+	{
+#if defined(__i386__) || defined(__x86_64__)
+		if(isEnabled_)
+			asm volatile("ldmxcsr %0" : : "m"(mxcsr_));
+#endif
+	}
+
+	DenormalGuard(const DenormalGuard&) = delete;
+	DenormalGuard& operator=(const DenormalGuard&) = delete;
+
+private:
+	static const u32 kFlushToZero = 0x8000;
+	static const u32 kDenormalsAreZero = 0x0040;
+
+	bool isEnabled_;
+	u32 mxcsr_;
+};
+
+
+// Returns the number of the denormal samples in the channels.
+template<typename T>
+u64 countDenormals(T* const* channels, int channelCount, int sampleCount)
+{
+	u64 count = 0;
+	for(int i = 0; i < channelCount; ++i) {
+		const T* samples = channels[i];
+		for(int j = 0; j < sampleCount; ++j) {
+			if(std::fpclassify(samples[j]) == FP_SUBNORMAL)
+				count++;
+		}
+	}
+
+	return count;
+}
+
+
+} // namespace Airwave
+
+
+#endif // COMMON_DENORMALS_H
@@ -10,6 +10,10 @@
 #define futex_wait(futex, count, timeout) \
 		(syscall(SYS_futex, futex, FUTEX_WAIT, count, timeout, nullptr, 0) == 0)
 
+#define futex_wait_until(futex, count, deadline) \
+		(syscall(SYS_futex, futex, FUTEX_WAIT_BITSET, count, deadline, nullptr, \
+		FUTEX_BITSET_MATCH_ANY) == 0)
+
 #define futex_post(futex, count) \
 		(syscall(SYS_futex, futex, FUTEX_WAKE, count, nullptr, nullptr, 0) == 0)
 
@@ -52,6 +56,21 @@ bool Event::wait(int msecs)
 }
 
 
+// The deadline is an absolute CLOCK_MONOTONIC time point, so the waiting can be safely
+// restarted after spurious wakeups without extending the total waiting time.
+bool Event::waitUntil(const timespec& deadline)
+{
+	while(count_ == 0) {
+		if(!futex_wait_until(&count_, 0, &deadline) && errno != EWOULDBLOCK &&
+				errno != EINTR)
+			return false;
+	}
+
+	count_--;
+	return true;
+}
+
+
 void Event::post()
 {
 	count_++;
@@ -2,6 +2,7 @@
 #define COMMON_EVENT_H
 
 #include <atomic>
+#include <ctime>
 
 #ifdef bool
 #undef bool
@@ -16,6 +17,7 @@ public:
 	~Event();
 
 	bool wait(int msecs = kInfinite);
+	bool waitUntil(const timespec& deadline);
 	void post();
 
 private:
@@ -0,0 +1,213 @@
+#include "hostpark.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "common/config.h"
+
+
+namespace Airwave {
+
+
+static socklen_t makeAddress(const std::string& name, sockaddr_un* address)
+{
+	std::memset(address, 0, sizeof(sockaddr_un));
+	address->sun_family = AF_UNIX;
+
+	// The name is placed in the abstract namespace, so there is no file to remove, when
+	// the host process crashes.
+	size_t length = std::min(name.size(), sizeof(address->sun_path) - 1);
+	std::memcpy(address->sun_path + 1, name.data(), length);
+	return offsetof(sockaddr_un, sun_path) + 1 + length;
+}
+
+
+// The abstract sockets have no permissions, so the peer is checked by its credentials.
+static bool getPeerCredentials(int fd, ucred* credentials)
+{
+	socklen_t length = sizeof(ucred);
+	if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, credentials, &length) != 0)
+		return false;
+
+	return credentials->uid == getuid();
+}
+
+
+static void setTimeout(int fd, int msecs)
+{
+	timeval tv;
+	tv.tv_sec = msecs / 1000;
+	tv.tv_usec = (msecs % 1000) * 1000;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+
+static i64 monotonicMsecs()
+{
+	timespec tm;
+	clock_gettime(CLOCK_MONOTONIC, &tm);
+	return static_cast<i64>(tm.tv_sec) * 1000 + tm.tv_nsec / 1000000;
+}
+
+
+HostPark::HostPark() :
+	fd_(-1)
+{
+}
+
+
+HostPark::~HostPark()
+{
+	close();
+}
+
+
+bool HostPark::listen(const std::string& name)
+{
+	close();
+
+	fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if(fd_ < 0)
+		return false;
+
+	sockaddr_un address;
+	socklen_t length = makeAddress(name, &address);
+
+	if(bind(fd_, reinterpret_cast<sockaddr*>(&address), length) != 0 ||
+			::listen(fd_, 4) != 0) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+
+bool HostPark::wait(int msecs, Request* request)
+{
+	if(fd_ < 0)
+		return false;
+
+	i64 deadline = monotonicMsecs() + msecs;
+
+	for(;;) {
+		i64 remaining = deadline - monotonicMsecs();
+		if(remaining <= 0)
+			return false;
+
+		pollfd pfd;
+		pfd.fd = fd_;
+		pfd.events = POLLIN;
+
+		int result = poll(&pfd, 1, static_cast<int>(remaining));
+		if(result < 0 && errno != EINTR)
+			return false;
+
+		if(result <= 0)
+			continue;
+
+		int fd = accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+		if(fd < 0)
+			continue;
+
+		setTimeout(fd, 1000);
+
+		ucred credentials;
+		bool isAccepted = getPeerCredentials(fd, &credentials) &&
+				recv(fd, request, sizeof(Request), 0) == sizeof(Request) &&
+				request->magic == kMagic;
+
+		if(isAccepted) {
+			i32 pid = getpid();
+			isAccepted = send(fd, &pid, sizeof(pid), MSG_NOSIGNAL) == sizeof(pid);
+		}
+
+		::close(fd);
+
+		if(isAccepted)
+			return true;
+	}
+}
+
+
+void HostPark::close()
+{
+	if(fd_ >= 0) {
+		::close(fd_);
+		fd_ = -1;
+	}
+}
+
+
+int HostPark::adopt(const std::string& name, int controlPortId, int logLevel)
+{
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if(fd < 0)
+		return -1;
+
+	sockaddr_un address;
+	socklen_t length = makeAddress(name, &address);
+
+	// Nobody is listening in most cases, so the connect() fails immediately.
+	if(connect(fd, reinterpret_cast<sockaddr*>(&address), length) != 0) {
+		::close(fd);
+		return -1;
+	}
+
+	setTimeout(fd, 2000);
+
+	Request request;
+	std::memset(&request, 0, sizeof(request));
+	request.magic = kMagic;
+	request.controlPortId = controlPortId;
+	request.logLevel = logLevel;
+
+	// The parked host could give up waiting right after the connection was queued, then
+	// the reply is never received and the new host process should be started.
+	ucred credentials;
+	i32 reply;
+	int pid = -1;
+
+	if(getPeerCredentials(fd, &credentials) &&
+			send(fd, &request, sizeof(request), MSG_NOSIGNAL) == sizeof(request) &&
+			recv(fd, &reply, sizeof(reply), 0) == sizeof(reply) &&
+			reply == credentials.pid) {
+		pid = credentials.pid;
+	}
+
+	::close(fd);
+	return pid;
+}
+
+
+std::string HostPark::name(const std::string& vstPath, const std::string& prefixPath,
+		const std::string& loaderPath)
+{
+	// The host binaries of the different versions can't adopt the plugin endpoint.
+	std::string key = VERSION_STRING;
+	key += '\0' + vstPath + '\0' + prefixPath + '\0' + loaderPath;
+
+	// FNV-1a hash
+	u64 hash = 0xcbf29ce484222325ULL;
+	for(char c : key) {
+		hash ^= static_cast<u8>(c);
+		hash *= 0x100000001b3ULL;
+	}
+
+	char buffer[64];
+	std::snprintf(buffer, sizeof(buffer), "%s-host-%u-%016llx", PROJECT_NAME, getuid(),
+			static_cast<unsigned long long>(hash));
+
+	return buffer;
+}
+
+
+} // namespace Airwave
@@ -0,0 +1,56 @@
+#ifndef COMMON_HOSTPARK_H
+#define COMMON_HOSTPARK_H
+
+#include <string>
+#include "common/types.h"
+
+
+namespace Airwave {
+
+
+// Rendezvous point of the parked host endpoint. When the plugin is closed, its host
+// process can stay alive with the VST library loaded and wait on the abstract unix
+// socket, named after the user, the VST binary, the WINE prefix and the WINE loader. The
+// next plugin endpoint of the same link connects to this socket before starting the new
+// host process, and passes its control port to the parked one.
+class HostPark {
+public:
+	// The plugin endpoint passes the name to the host endpoint, which is allowed to park.
+	static constexpr const char* kNameEnv = "AIRWAVE_HOST_PARK";
+
+	struct Request {
+		u32 magic;
+		i32 controlPortId;
+		i32 logLevel;
+		u32 reserved;
+	};
+
+	HostPark();
+	~HostPark();
+
+	HostPark(const HostPark&) = delete;
+	HostPark& operator=(const HostPark&) = delete;
+
+	// Host endpoint side. The listen() fails, if another host process is already parked
+	// with the same name.
+	bool listen(const std::string& name);
+	bool wait(int msecs, Request* request);
+	void close();
+
+	// Plugin endpoint side. Returns the pid of the adopted host process, or -1.
+	static int adopt(const std::string& name, int controlPortId, int logLevel);
+
+	static std::string name(const std::string& vstPath, const std::string& prefixPath,
+			const std::string& loaderPath);
+
+private:
+	static const u32 kMagic = 0x4b525041;
+
+	int fd_;
+};
+
+
+} // namespace Airwave
+
+
+#endif // COMMON_HOSTPARK_H
@@ -0,0 +1,249 @@
+#include "latencystats.h"
+
+#include <cstdio>
+#include "common/logger.h"
+#include "common/vst24.h"
+
+
+namespace Airwave {
+
+
+Histogram::Histogram() :
+	count_(0),
+	sum_(0),
+	max_(0)
+{
+	for(int i = 0; i < kBucketCount; ++i)
+		buckets_[i].store(0, std::memory_order_relaxed);
+}
+
+
+void Histogram::record(u64 value)
+{
+	buckets_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	count_.fetch_add(1, std::memory_order_relaxed);
+	sum_.fetch_add(value, std::memory_order_relaxed);
+
+	u64 max = max_.load(std::memory_order_relaxed);
+	while(value > max && !max_.compare_exchange_weak(max, value,
+			std::memory_order_relaxed)) {
+	}
+}
+
+
+void Histogram::reset()
+{
+	for(int i = 0; i < kBucketCount; ++i)
+		buckets_[i].store(0, std::memory_order_relaxed);
+
+	count_.store(0, std::memory_order_relaxed);
+	sum_.store(0, std::memory_order_relaxed);
+	max_.store(0, std::memory_order_relaxed);
+}
+
+
+u64 Histogram::count() const
+{
+	return count_.load(std::memory_order_relaxed);
+}
+
+
+u64 Histogram::mean() const
+{
+	u64 count = count_.load(std::memory_order_relaxed);
+	return count ? sum_.load(std::memory_order_relaxed) / count : 0;
+}
+
+
+u64 Histogram::max() const
+{
+	return max_.load(std::memory_order_relaxed);
+}
+
+
+u64 Histogram::percentile(double percent) const
+{
+	u64 count = count_.load(std::memory_order_relaxed);
+	if(count == 0)
+		return 0;
+
+	u64 target = static_cast<u64>(count * percent / 100.0 + 0.5);
+	if(target == 0)
+		target = 1;
+
+	u64 total = 0;
+	for(int i = 0; i < kBucketCount; ++i) {
+		total += buckets_[i].load(std::memory_order_relaxed);
+
+		if(total >= target) {
+			u64 value = bucketValue(i);
+			return value < max() ? value : max();
+		}
+	}
+
+	return max();
+}
+
+
+int Histogram::bucketIndex(u64 value)
+{
+	const u64 kMaxValue = (u64(1) << kMaxBits) - 1;
+	if(value > kMaxValue)
+		value = kMaxValue;
+
+	if(value < kSubCount)
+		return static_cast<int>(value);
+
+	int exponent = 63 - __builtin_clzll(value);
+	int shift = exponent - kSubBits;
+	return (shift + 1) * kSubCount + static_cast<int>((value >> shift) & (kSubCount - 1));
+}
+
+
+u64 Histogram::bucketValue(int index)
+{
+	if(index < kSubCount)
+		return index;
+
+	int shift = index / kSubCount - 1;
+	u64 lower = static_cast<u64>(kSubCount + index % kSubCount) << shift;
+
+	// Report the highest value, which belongs to the bucket.
+	return lower + (u64(1) << shift) - 1;
+}
+
+
+LatencyStats::LatencyStats()
+{
+	for(int i = 0; i < kSlotCount; ++i)
+		slots_[i].store(nullptr, std::memory_order_relaxed);
+
+	// The histograms are allocated on demand. Those, which are recorded from the audio
+	// threads, are allocated in advance to avoid memory allocations there.
+	histogram(slotIndex(Command::ProcessSingle, 0));
+	histogram(slotIndex(Command::ProcessDouble, 0));
+	histogram(slotIndex(Command::GetParameter, 0));
+	histogram(slotIndex(Command::SetParameter, 0));
+	histogram(slotIndex(Command::Dispatch, effProcessEvents));
+	histogram(slotIndex(Command::AudioMaster, audioMasterAutomate));
+	histogram(slotIndex(Command::AudioMaster, audioMasterGetTime));
+	histogram(slotIndex(Command::AudioMaster, audioMasterProcessEvents));
+}
+
+
+LatencyStats::~LatencyStats()
+{
+	for(int i = 0; i < kSlotCount; ++i)
+		delete slots_[i].load(std::memory_order_relaxed);
+}
+
+
+void LatencyStats::record(Command command, i32 opcode, u64 nsecs)
+{
+	int slot = slotIndex(command, opcode);
+	if(slot >= 0)
+		histogram(slot)->record(nsecs);
+}
+
+
+void LatencyStats::reset()
+{
+	for(int i = 0; i < kSlotCount; ++i) {
+		Histogram* histogram = slots_[i].load(std::memory_order_acquire);
+		if(histogram)
+			histogram->reset();
+	}
+}
+
+
+void LatencyStats::dump(const char* title) const
+{
+	TRACE("%s round trip latencies (usec):", title);
+	TRACE("%-42s %8s %9s %9s %9s %9s", "request", "count", "p50", "p99", "p99.9",
+			"max");
+
+	char name[64];
+
+	for(int i = 0; i < kSlotCount; ++i) {
+		const Histogram* histogram = slots_[i].load(std::memory_order_acquire);
+		if(!histogram || histogram->count() == 0)
+			continue;
+
+		TRACE("%-42s %8llu %9.1f %9.1f %9.1f %9.1f", slotName(i, name, sizeof(name)),
+				histogram->count(), histogram->percentile(50.0) / 1000.0,
+				histogram->percentile(99.0) / 1000.0,
+				histogram->percentile(99.9) / 1000.0, histogram->max() / 1000.0);
+	}
+}
+
+
+int LatencyStats::slotIndex(Command command, i32 opcode)
+{
+	int index = static_cast<int>(command);
+	if(index < 0 || index >= kCommandCount)
+		return -1;
+
+	if(command == Command::Dispatch || command == Command::AudioMaster) {
+		if(opcode < 0 || opcode >= kMaxOpcodes)
+			return index;
+
+		int base = command == Command::Dispatch ? kCommandCount :
+				kCommandCount + kMaxOpcodes;
+
+		return base + opcode;
+	}
+
+	return index;
+}
+
+
+Histogram* LatencyStats::histogram(int slot)
+{
+	Histogram* histogram = slots_[slot].load(std::memory_order_acquire);
+	if(histogram)
+		return histogram;
+
+	Histogram* created = new Histogram;
+	if(slots_[slot].compare_exchange_strong(histogram, created,
+			std::memory_order_acq_rel)) {
+		return created;
+	}
+
+	delete created;
+	return histogram;
+}
+
+
+const char* LatencyStats::slotName(int slot, char* buffer, size_t size) const
+{
+	const int kDispatchCount = sizeof(kDispatchEvents) / sizeof(kDispatchEvents[0]);
+	const int kAudioMasterCount = sizeof(kAudioMasterEvents) /
+			sizeof(kAudioMasterEvents[0]);
+
+	if(slot < kCommandCount)
+		return kCommandNames[slot];
+
+	int opcode = (slot - kCommandCount) % kMaxOpcodes;
+
+	if(slot < kCommandCount + kMaxOpcodes) {
+		if(opcode < kDispatchCount) {
+			std::snprintf(buffer, size, "Dispatch(%s)", kDispatchEvents[opcode]);
+		}
+		else {
+			std::snprintf(buffer, size, "Dispatch(%d)", opcode);
+		}
+	}
+	else {
+		if(opcode < kAudioMasterCount) {
+			std::snprintf(buffer, size, "AudioMaster(%s)", kAudioMasterEvents[opcode]);
+		}
+		else {
+			std::snprintf(buffer, size, "AudioMaster(%d)", opcode);
+		}
+	}
+
+	return buffer;
+}
+
+
+} // namespace Airwave
@@ -0,0 +1,81 @@
+#ifndef COMMON_LATENCYSTATS_H
+#define COMMON_LATENCYSTATS_H
+
+#include <atomic>
+#include <ctime>
+#include "common/protocol.h"
+#include "common/types.h"
+
+
+namespace Airwave {
+
+
+inline u64 monotonicTime()
+{
+	timespec tm;
+	clock_gettime(CLOCK_MONOTONIC, &tm);
+	return static_cast<u64>(tm.tv_sec) * 1000000000 + tm.tv_nsec;
+}
+
+
+// HDR-style histogram: values are grouped by powers of two and every group is split
+// into kSubCount linear sub-buckets, so the relative error is below 1/kSubCount.
+// Recording is wait-free and can be done concurrently from several threads.
+class Histogram {
+public:
+	Histogram();
+
+	void record(u64 value);
+	void reset();
+
+	u64 count() const;
+	u64 mean() const;
+	u64 max() const;
+	u64 percentile(double percent) const;
+
+private:
+	static const int kSubBits = 4;
+	static const int kSubCount = 1 << kSubBits;
+	static const int kMaxBits = 40;
+	static const int kBucketCount = (kMaxBits - kSubBits + 1) * kSubCount;
+
+	std::atomic<u32> buckets_[kBucketCount];
+	std::atomic<u64> count_;
+	std::atomic<u64> sum_;
+	std::atomic<u64> max_;
+
+	static int bucketIndex(u64 value);
+	static u64 bucketValue(int index);
+};
+
+
+// Round trip latencies (in nanoseconds) of the requests, keyed by the command and, for
+// the Dispatch and AudioMaster commands, by the opcode.
+class LatencyStats {
+public:
+	LatencyStats();
+	~LatencyStats();
+
+	LatencyStats(const LatencyStats&) = delete;
+	LatencyStats& operator=(const LatencyStats&) = delete;
+
+	void record(Command command, i32 opcode, u64 nsecs);
+	void reset();
+	void dump(const char* title) const;
+
+private:
+	static const int kMaxOpcodes = 128;
+	static const int kSlotCount = kCommandCount + kMaxOpcodes * 2;
+
+	std::atomic<Histogram*> slots_[kSlotCount];
+
+	static int slotIndex(Command command, i32 opcode);
+	Histogram* histogram(int slot);
+	const char* slotName(int slot, char* buffer, size_t size) const;
+};
+
+
+} // namespace Airwave
+
+
+#endif // COMMON_LATENCYSTATS_H
@@ -0,0 +1,349 @@
+#include "linkindex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common/storage.h"
+
+
+namespace Airwave {
+
+
+struct LinkIndex::Header {
+	u32 magic;
+	u32 version;
+	u64 configMtime;       // Nanoseconds
+	u64 configSize;
+	u32 linkCount;
+	u32 entriesOffset;
+	u32 logSocketPath;
+	u32 binariesPath;
+	i32 defaultLogLevel;
+	i32 processDeadline;
+	u32 size;
+	i32 hostKeepAlive;
+	i32 bootLimit;
+	u32 reserved;
+};
+
+
+// All strings are stored as the offsets of null-terminated strings from the beginning
+// of the file.
+struct LinkIndex::Entry {
+	u32 path;
+	u32 target;
+	u32 prefix;
+	u32 prefixPath;
+	u32 loader;
+	u32 loaderPath;
+	i32 level;
+	i32 editorRate;
+	i32 options;
+	u32 reserved;
+};
+
+
+static u64 modificationTime(const struct stat& st)
+{
+	return static_cast<u64>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+
+LinkIndex::LinkIndex() :
+	data_(nullptr),
+	size_(0),
+	device_(0),
+	inode_(0),
+	mtime_(0)
+{
+	static_assert(sizeof(Header) == 64, "LinkIndex header layout is changed");
+	static_assert(sizeof(Entry) == 40, "LinkIndex entry layout is changed");
+}
+
+
+LinkIndex::~LinkIndex()
+{
+	unmap();
+}
+
+
+LinkIndex* LinkIndex::instance()
+{
+	static LinkIndex index;
+	return &index;
+}
+
+
+LinkIndex::Result LinkIndex::lookup(const std::string& path, Config* config, Link* link)
+{
+	std::string configPath = Storage::defaultFilePath();
+	std::string indexPath = LinkIndex::path(configPath);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	struct stat st;
+	if(stat(indexPath.c_str(), &st) != 0) {
+		unmap();
+		return kUnavailable;
+	}
+
+	// The index is replaced by rename(), so the new file has a different inode.
+	if(!data_ || static_cast<u64>(st.st_dev) != device_ ||
+			static_cast<u64>(st.st_ino) != inode_ || modificationTime(st) != mtime_) {
+		unmap();
+
+		if(!map(indexPath))
+			return kUnavailable;
+	}
+
+	const Header* header = reinterpret_cast<const Header*>(data_);
+
+	// The configuration file could be edited by hand after the index was written.
+	if(stat(configPath.c_str(), &st) != 0 || modificationTime(st) != header->configMtime ||
+			static_cast<u64>(st.st_size) != header->configSize) {
+		return kUnavailable;
+	}
+
+	config->logSocketPath = string(header->logSocketPath);
+	config->binariesPath = string(header->binariesPath);
+	config->defaultLogLevel = static_cast<LogLevel>(header->defaultLogLevel);
+	config->processDeadline = header->processDeadline;
+	config->hostKeepAlive = header->hostKeepAlive;
+	config->bootLimit = header->bootLimit;
+
+	const Entry* begin = reinterpret_cast<const Entry*>(data_ + header->entriesOffset);
+	const Entry* end = begin + header->linkCount;
+
+	const Entry* entry = std::lower_bound(begin, end, path.c_str(),
+			[this](const Entry& item, const char* key) {
+				return std::strcmp(string(item.path), key) < 0;
+			});
+
+	if(entry == end || path != string(entry->path))
+		return kNotFound;
+
+	link->target = string(entry->target);
+	link->prefix = string(entry->prefix);
+	link->prefixPath = string(entry->prefixPath);
+	link->loader = string(entry->loader);
+	link->loaderPath = string(entry->loaderPath);
+	link->level = static_cast<LogLevel>(entry->level);
+	link->editorRate = entry->editorRate;
+	link->options = entry->options;
+	return kFound;
+}
+
+
+bool LinkIndex::write(Storage* storage, const std::string& configPath)
+{
+	struct stat st;
+	if(configPath.empty() || stat(configPath.c_str(), &st) != 0)
+		return false;
+
+	struct Record {
+		std::string path;
+		std::string target;
+		std::string prefix;
+		std::string prefixPath;
+		std::string loader;
+		std::string loaderPath;
+		LogLevel level;
+		int editorRate;
+		int options;
+	};
+
+	std::vector<Record> records;
+
+	Storage::Link link = storage->link();
+	while(!link.isNull()) {
+		Record record;
+		record.path = link.path();
+		record.target = link.target();
+		record.prefix = link.prefix();
+		record.loader = link.loader();
+		record.level = link.logLevel();
+		record.editorRate = link.editorRate();
+		record.options = link.options();
+
+		Storage::Prefix prefix = storage->prefix(record.prefix);
+		if(!prefix.isNull())
+			record.prefixPath = prefix.path();
+
+		Storage::Loader loader = storage->loader(record.loader);
+		if(!loader.isNull())
+			record.loaderPath = loader.path();
+
+		records.push_back(record);
+		link = link.next();
+	}
+
+	std::sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+		return std::strcmp(a.path.c_str(), b.path.c_str()) < 0;
+	});
+
+	u32 entriesOffset = sizeof(Header);
+	u32 stringsOffset = entriesOffset + records.size() * sizeof(Entry);
+
+	std::string strings;
+	auto addString = [&](const std::string& value) -> u32 {
+		u32 offset = stringsOffset + strings.size();
+		strings.append(value.c_str(), value.size() + 1);
+		return offset;
+	};
+
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	header.magic = kMagic;
+	header.version = kVersion;
+	header.configMtime = modificationTime(st);
+	header.configSize = st.st_size;
+	header.linkCount = records.size();
+	header.entriesOffset = entriesOffset;
+	header.logSocketPath = addString(storage->logSocketPath());
+	header.binariesPath = addString(storage->binariesPath());
+	header.defaultLogLevel = static_cast<i32>(storage->defaultLogLevel());
+	header.processDeadline = storage->processDeadline();
+	header.hostKeepAlive = storage->hostKeepAlive();
+	header.bootLimit = storage->bootLimit();
+
+	std::vector<Entry> entries;
+	entries.reserve(records.size());
+
+	for(const Record& record : records) {
+		Entry entry;
+		std::memset(&entry, 0, sizeof(entry));
+		entry.path = addString(record.path);
+		entry.target = addString(record.target);
+		entry.prefix = addString(record.prefix);
+		entry.prefixPath = addString(record.prefixPath);
+		entry.loader = addString(record.loader);
+		entry.loaderPath = addString(record.loaderPath);
+		entry.level = static_cast<i32>(record.level);
+		entry.editorRate = record.editorRate;
+		entry.options = record.options;
+		entries.push_back(entry);
+	}
+
+	header.size = stringsOffset + strings.size();
+
+	// The new index replaces the old one atomically, the plugin endpoints that are
+	// reading it at this moment keep their mapping of the old file.
+	std::string indexPath = path(configPath);
+	std::string tempPath = indexPath + ".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::trunc | std::ios::binary);
+		if(!file.is_open())
+			return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entries.data()),
+				entries.size() * sizeof(Entry));
+		file.write(strings.data(), strings.size());
+
+		if(!file.good()) {
+			file.close();
+			unlink(tempPath.c_str());
+			return false;
+		}
+	}
+
+	if(std::rename(tempPath.c_str(), indexPath.c_str()) != 0) {
+		unlink(tempPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+std::string LinkIndex::path(const std::string& configPath)
+{
+	std::string result = configPath;
+
+	std::size_t pos = result.rfind(".conf");
+	if(pos != std::string::npos && pos + 5 == result.size())
+		result.erase(pos);
+
+	return result + ".idx";
+}
+
+
+bool LinkIndex::map(const std::string& indexPath)
+{
+	int fd = open(indexPath.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return false;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if(data == MAP_FAILED)
+		return false;
+
+	data_ = static_cast<const char*>(data);
+	size_ = st.st_size;
+	device_ = st.st_dev;
+	inode_ = st.st_ino;
+	mtime_ = modificationTime(st);
+
+	if(!isValid()) {
+		unmap();
+		return false;
+	}
+
+	return true;
+}
+
+
+void LinkIndex::unmap()
+{
+	if(data_)
+		munmap(const_cast<char*>(data_), size_);
+
+	data_ = nullptr;
+	size_ = 0;
+	device_ = 0;
+	inode_ = 0;
+	mtime_ = 0;
+}
+
+
+bool LinkIndex::isValid() const
+{
+	const Header* header = reinterpret_cast<const Header*>(data_);
+
+	if(header->magic != kMagic || header->version != kVersion || header->size != size_)
+		return false;
+
+	u64 entriesEnd = header->entriesOffset +
+			static_cast<u64>(header->linkCount) * sizeof(Entry);
+
+	if(header->entriesOffset < sizeof(Header) || entriesEnd > size_)
+		return false;
+
+	// The last string is null-terminated, so any offset inside the file points to the
+	// null-terminated string.
+	return data_[size_ - 1] == '\0';
+}
+
+
+const char* LinkIndex::string(u32 offset) const
+{
+	return offset < size_ ? data_ + offset : "";
+}
+
+
+} // namespace Airwave
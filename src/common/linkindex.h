@@ -0,0 +1,88 @@
+#ifndef COMMON_LINKINDEX_H
+#define COMMON_LINKINDEX_H
+
+#include <mutex>
+#include <string>
+#include "common/logger.h"
+#include "common/types.h"
+
+
+namespace Airwave {
+
+
+class Storage;
+
+
+// Compact binary copy of the configuration file, written along with it. The links are
+// sorted by path, and the prefix and loader names are already resolved to paths, so the
+// plugin endpoint finds its link in the memory-mapped file by the binary search instead
+// of parsing the whole JSON configuration. The mapping is shared by all plugin endpoints
+// of the process and remapped only when the index file is replaced.
+class LinkIndex {
+public:
+	enum Result {
+		kUnavailable,   // The index is missing or outdated, use the configuration file
+		kNotFound,
+		kFound
+	};
+
+	struct Config {
+		std::string logSocketPath;
+		std::string binariesPath;
+		LogLevel defaultLogLevel;
+		int processDeadline;
+		int hostKeepAlive;     // Seconds
+		int bootLimit;
+	};
+
+	struct Link {
+		std::string target;
+		std::string prefix;
+		std::string prefixPath;    // Empty if the prefix doesn't exist
+		std::string loader;
+		std::string loaderPath;    // Empty if the loader doesn't exist
+		LogLevel level;
+		int editorRate;
+		int options;               // Storage::LinkOption bits
+	};
+
+	static LinkIndex* instance();
+
+	LinkIndex(const LinkIndex&) = delete;
+	LinkIndex& operator=(const LinkIndex&) = delete;
+
+	~LinkIndex();
+
+	Result lookup(const std::string& path, Config* config, Link* link);
+
+	static bool write(Storage* storage, const std::string& configPath);
+	static std::string path(const std::string& configPath);
+
+private:
+	struct Header;
+	struct Entry;
+
+	static const u32 kMagic = 0x58495741;
+	static const u32 kVersion = 5;
+
+	std::mutex mutex_;
+	const char* data_;
+	size_t size_;
+	u64 device_;
+	u64 inode_;
+	u64 mtime_;
+
+	LinkIndex();
+
+	bool map(const std::string& indexPath);
+	void unmap();
+	bool isValid() const;
+
+	const char* string(u32 offset) const;
+};
+
+
+} // namespace Airwave
+
+
+#endif // COMMON_LINKINDEX_H
@@ -1,112 +1,662 @@
 #include "logger.h"
 
+#include <atomic>
 #include <cstdarg>
-#include <cstring>
+#include <cstdio>
 #include <ctime>
+#include <mutex>
+#include <thread>
 #include <unistd.h>
 #include <linux/un.h>
 #include <sys/socket.h>
 #include <vector>
-#include "common/types.h"
 
 
 namespace Airwave {
 
 
-static int fd = -1;
-static std::string id;
-static std::vector<char> buffer;
-static LogLevel defaultLevel = LogLevel::kDebug;
+namespace {
+
+
+// Single producer (the owning thread), single consumer (the drain thread) ring. The
+// ring is owned by a thread until it exits, then the drain thread sends the remaining
+// records and returns the ring to the pool. The head and the tail are never reset, so
+// the reused ring continues the sequence.
+struct LogRing {
+	static const u32 kCapacity = 256;
+
+	enum Owner : u32 {
+		kFree,
+		kUsed,
+		kReleased
+	};
+
+	std::atomic<u32> owner;
+	std::atomic<u32> head;
+	std::atomic<u32> tail;
+	std::atomic<u32> dropped;
+	LogRecord records[kCapacity];
+};
+
+
+// Fixed pool of the rings, so the first message of a thread (e.g. the audio thread of
+// the VST host) never allocates memory or takes a lock. The pool is allocated in one
+// piece, so the pages of the unused records are never touched.
+const size_t kRingCount = 64;
+
+
+// The state is allocated once and is never destroyed, since the rings are referenced by
+// the thread local pointers, and the threads can outlive the logger.
+struct LoggerState {
+	std::mutex guard;
+	LogRing* rings = nullptr;
+	int refCount = 0;
+
+	// Messages of the threads, which didn't get a ring from the pool.
+	std::atomic<u32> lost;
+
+	std::thread* thread = nullptr;
+	std::atomic_flag isRunning = ATOMIC_FLAG_INIT;
+	std::vector<char> buffer;
+};
+
+
+std::atomic<int> fd(-1);
+LogContext defaultContext("", LogLevel::kDebug);
+LoggerState* state = nullptr;
+std::mutex stateGuard;
+
+thread_local const LogContext* currentContext = nullptr;
+
+// Releases the ring of the thread on its exit.
+struct ThreadRing {
+	LogRing* ring = nullptr;
+
+	~ThreadRing()
+	{
+		if(ring)
+			ring->owner.store(LogRing::kReleased, std::memory_order_release);
+	}
+};
+
+
+thread_local ThreadRing threadRing;
+
+
+LogRing* currentRing()
+{
+	if(threadRing.ring)
+		return threadRing.ring;
+
+	// Happens once per thread: the first message of the thread claims a free ring.
+	for(size_t i = 0; i < kRingCount; ++i) {
+		LogRing* ring = &state->rings[i];
+		u32 owner = LogRing::kFree;
+
+		if(ring->owner.compare_exchange_strong(owner, LogRing::kUsed,
+				std::memory_order_acquire, std::memory_order_relaxed)) {
+			threadRing.ring = ring;
+			return ring;
+		}
+	}
+
+	return nullptr;
+}
+
+
+// Returns the argument of the record, converted to the requested type. The missing
+// argument is returned as zero.
+template<typename T>
+T takeArg(const LogRecord* record, size_t* offset, LogRecord::Tag* tag)
+{
+	*tag = LogRecord::Tag(0);
+
+	if(*offset >= record->length || *offset >= LogRecord::kDataSize)
+		return T();
+
+	*tag = static_cast<LogRecord::Tag>(record->data[(*offset)++]);
+	const u8* data = record->data + *offset;
+
+	if(*tag == LogRecord::kString) {
+		u16 size;
+		std::memcpy(&size, data, sizeof(size));
+		*offset += sizeof(size) + size;
+		return T();
+	}
+
+	*offset += sizeof(u64);
+
+	if(*tag == LogRecord::kDouble) {
+		double value;
+		std::memcpy(&value, data, sizeof(value));
+		return static_cast<T>(value);
+	}
+	else if(*tag == LogRecord::kSigned) {
+		i64 value;
+		std::memcpy(&value, data, sizeof(value));
+		return static_cast<T>(value);
+	}
+
+	u64 value;
+	std::memcpy(&value, data, sizeof(value));
+	return static_cast<T>(value);
+}
+
+
+size_t append(char* output, size_t size, size_t count, const char* format, ...)
+{
+	if(count >= size)
+		return count;
+
+	va_list args;
+	va_start(args, format);
+	int result = std::vsnprintf(output + count, size - count, format, args);
+	va_end(args);
+
+	if(result < 0)
+		return count;
+
+	count += result;
+	return count < size ? count : size - 1;
+}
+
+
+// Formats the record by passing every conversion specification of the format string
+// along with the stored argument to snprintf() separately.
+size_t formatRecord(const LogRecord* record, char* output, size_t size)
+{
+	const char* format = record->format;
+	size_t offset = 0;
+	size_t count = 0;
+	LogRecord::Tag tag;
+
+	output[0] = '\0';
+
+	while(*format && count < size - 1) {
+		if(*format != '%') {
+			output[count++] = *format++;
+			continue;
+		}
+
+		if(format[1] == '%') {
+			output[count++] = '%';
+			format += 2;
+			continue;
+		}
+
+		// Collect the flags, width and precision of the conversion specification.
+		char spec[32];
+		size_t length = 0;
+		int stars[2];
+		int starCount = 0;
+
+		spec[length++] = *format++;
+
+		while(*format && std::strchr("-+ #0123456789.*", *format)) {
+			if(*format == '*' && starCount < 2)
+				stars[starCount++] = takeArg<int>(record, &offset, &tag);
+
+			if(length < sizeof(spec) - 8)
+				spec[length++] = *format;
+
+			format++;
+		}
+
+		// Skip the original length modifier, the stored arguments have their own size.
+		char modifier = 0;
+		while(*format && std::strchr("hlLqjzt", *format))
+			modifier = *format++;
+
+		char conversion = *format;
+		if(!conversion)
+			break;
+
+		format++;
+
+		switch(conversion) {
+		case 'd':
+		case 'i': {
+			long long value = takeArg<long long>(record, &offset, &tag);
+			if(!modifier)
+				value = static_cast<int>(value);
+
+			spec[length++] = 'l';
+			spec[length++] = 'l';
+			spec[length++] = conversion;
+			spec[length] = '\0';
+
+			if(starCount == 2) {
+				count = append(output, size, count, spec, stars[0], stars[1], value);
+			}
+			else if(starCount == 1) {
+				count = append(output, size, count, spec, stars[0], value);
+			}
+			else {
+				count = append(output, size, count, spec, value);
+			}
+			break; }
+
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'o':
+		case 'c': {
+			unsigned long long value = takeArg<unsigned long long>(record, &offset, &tag);
+			if(!modifier)
+				value = static_cast<unsigned int>(value);
+
+			if(conversion != 'c') {
+				spec[length++] = 'l';
+				spec[length++] = 'l';
+			}
+
+			spec[length++] = conversion;
+			spec[length] = '\0';
+
+			if(conversion == 'c') {
+				count = append(output, size, count, spec, static_cast<int>(value));
+			}
+			else if(starCount == 2) {
+				count = append(output, size, count, spec, stars[0], stars[1], value);
+			}
+			else if(starCount == 1) {
+				count = append(output, size, count, spec, stars[0], value);
+			}
+			else {
+				count = append(output, size, count, spec, value);
+			}
+			break; }
+
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A': {
+			double value = takeArg<double>(record, &offset, &tag);
+			spec[length++] = conversion;
+			spec[length] = '\0';
+
+			if(starCount == 2) {
+				count = append(output, size, count, spec, stars[0], stars[1], value);
+			}
+			else if(starCount == 1) {
+				count = append(output, size, count, spec, stars[0], value);
+			}
+			else {
+				count = append(output, size, count, spec, value);
+			}
+			break; }
+
+		case 'p': {
+			uintptr_t value = takeArg<uintptr_t>(record, &offset, &tag);
+			count = append(output, size, count, "%p", reinterpret_cast<void*>(value));
+			break; }
+
+		case 's': {
+			size_t start = offset;
+			takeArg<int>(record, &offset, &tag);
+
+			std::string string;
+			if(tag == LogRecord::kString) {
+				u16 stringSize;
+				std::memcpy(&stringSize, record->data + start + 1, sizeof(stringSize));
+				const u8* data = record->data + start + 1 + sizeof(stringSize);
+				string.assign(data, data + stringSize);
+			}
+			else {
+				string = tag ? "(invalid)" : "(missing)";
+			}
+
+			spec[length++] = 's';
+			spec[length] = '\0';
+
+			if(starCount == 2) {
+				count = append(output, size, count, spec, stars[0], stars[1],
+						string.c_str());
+			}
+			else if(starCount == 1) {
+				count = append(output, size, count, spec, stars[0], string.c_str());
+			}
+			else {
+				count = append(output, size, count, spec, string.c_str());
+			}
+			break; }
+
+		default:
+			break;
+		}
+	}
+
+	output[count] = '\0';
+	return count;
+}
+
+
+void sendRecord(const LogRecord* record)
+{
+	std::vector<char>& buffer = state->buffer;
+
+	u64* timestamp = reinterpret_cast<u64*>(buffer.data());
+	*timestamp = record->timestamp;
+
+	buffer[sizeof(u64)] = static_cast<char>(record->level);
+
+	char* output = buffer.data() + sizeof(u64) + 1;
+	size_t length = strnlen(record->senderId, LogRecord::kSenderIdSize);
+	output = std::copy(record->senderId, record->senderId + length, output);
+
+	*output = '\x01';
+	++output;
+
+	size_t count = output - buffer.data();
+	count += formatRecord(record, output, buffer.size() - count) + 1;
+
+	send(fd, buffer.data(), count, 0);
+}
+
+
+void sendDropNotice(u32 dropped)
+{
+	LogRecord record;
+	timespec tm;
+	clock_gettime(CLOCK_REALTIME, &tm);
+
+	record.timestamp = (static_cast<u64>(tm.tv_sec) << 32) + tm.tv_nsec;
+	record.format = "%u log messages were dropped";
+	record.level = LogLevel::kError;
+	record.length = 0;
+	std::memcpy(record.senderId, defaultContext.senderId(), LogRecord::kSenderIdSize);
+	loggerEncode(&record, dropped);
+
+	sendRecord(&record);
+}
+
+
+// Sends the records of all rings in the timestamp order. Returns false if there were
+// no records.
+bool drain()
+{
+	// Only the rings with the pending records take part in the merge.
+	LogRing* rings[kRingCount];
+	u32 heads[kRingCount];
+	size_t count = 0;
+	u32 dropped = state->lost.exchange(0, std::memory_order_relaxed);
+
+	for(size_t i = 0; i < kRingCount; ++i) {
+		LogRing* ring = &state->rings[i];
+		u32 owner = ring->owner.load(std::memory_order_acquire);
+		if(owner == LogRing::kFree)
+			continue;
+
+		u32 head = ring->head.load(std::memory_order_acquire);
+		dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+
+		if(head != ring->tail.load(std::memory_order_relaxed)) {
+			rings[count] = ring;
+			heads[count] = head;
+			count++;
+		}
+		else if(owner == LogRing::kReleased) {
+			// The thread has exited and all its records are sent.
+			ring->owner.store(LogRing::kFree, std::memory_order_release);
+		}
+	}
+
+	bool hasRecords = count > 0;
+
+	while(count > 0) {
+		size_t next = 0;
+		u64 timestamp = 0;
+
+		for(size_t i = 0; i < count; ++i) {
+			u32 tail = rings[i]->tail.load(std::memory_order_relaxed);
+			const LogRecord& record = rings[i]->records[tail % LogRing::kCapacity];
+
+			if(i == 0 || record.timestamp < timestamp) {
+				next = i;
+				timestamp = record.timestamp;
+			}
+		}
+
+		LogRing* ring = rings[next];
+		u32 tail = ring->tail.load(std::memory_order_relaxed);
+		sendRecord(&ring->records[tail % LogRing::kCapacity]);
+		ring->tail.store(++tail, std::memory_order_release);
+
+		if(tail == heads[next]) {
+			rings[next] = rings[count - 1];
+			heads[next] = heads[count - 1];
+			count--;
+		}
+	}
+
+	if(dropped)
+		sendDropNotice(dropped);
+
+	return hasRecords;
+}
+
+
+void drainThread()
+{
+	const useconds_t kMinDelay = 1000;
+	const useconds_t kMaxDelay = 50000;
+
+	useconds_t delay = kMinDelay;
+
+	// The writers never wake up the drain thread to stay realtime-safe, so it polls
+	// the rings, backing off while there are no messages.
+	while(state->isRunning.test_and_set()) {
+		if(drain()) {
+			delay = kMinDelay;
+		}
+		else if(delay < kMaxDelay) {
+			delay *= 2;
+		}
+
+		usleep(delay);
+	}
+
+	drain();
+}
+
+
+} // anonymous namespace
+
+
+LogContext::LogContext(const std::string& senderId, LogLevel level) :
+	level_(level)
+{
+	setSenderId(senderId);
+}
+
+
+const char* LogContext::senderId() const
+{
+	return senderId_;
+}
+
+
+void LogContext::setSenderId(const std::string& senderId)
+{
+	// The whole array is copied into the records, so it's padded with zeros.
+	std::memset(senderId_, 0, sizeof(senderId_));
+	senderId.copy(senderId_, sizeof(senderId_) - 1);
+}
+
+
+LogLevel LogContext::logLevel() const
+{
+	return level_.load(std::memory_order_relaxed);
+}
+
+
+void LogContext::setLogLevel(LogLevel level)
+{
+	level_.store(level, std::memory_order_relaxed);
+}
+
+
+LogScope::LogScope(const LogContext* context) :
+	previous_(currentContext)
+{
+	currentContext = context;
+}
+
+
+LogScope::~LogScope()
+{
+	currentContext = previous_;
+}
 
 
 bool loggerInit(const std::string& socketPath, const std::string& senderId)
 {
-	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
-	if(fd < 0)
+	std::lock_guard<std::mutex> lock(stateGuard);
+
+	if(!state) {
+		state = new LoggerState;
+
+		// NOTE The buffer size is hardcoded, increase it if necessary.
+		state->buffer.resize(1024);
+
+		state->lost.store(0, std::memory_order_relaxed);
+		state->rings = new LogRing[kRingCount];
+		for(size_t i = 0; i < kRingCount; ++i) {
+			LogRing* ring = &state->rings[i];
+			ring->owner.store(LogRing::kFree, std::memory_order_relaxed);
+			ring->head.store(0, std::memory_order_relaxed);
+			ring->tail.store(0, std::memory_order_relaxed);
+			ring->dropped.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	// Each plugin endpoint of the process initializes the logger, the socket and the
+	// drain thread are shared by all of them.
+	if(state->refCount++ == 0 && fd < 0)
+		defaultContext.setSenderId(senderId);
+
+	if(fd >= 0)
+		return true;
+
+	int socketFd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if(socketFd < 0)
 		return false;
 
 	sockaddr_un address;
 	memset(&address, 0, sizeof(sockaddr_un));
 	address.sun_family = AF_UNIX;
-	snprintf(address.sun_path, UNIX_PATH_MAX, socketPath.c_str());
+	snprintf(address.sun_path, UNIX_PATH_MAX, "%s", socketPath.c_str());
 
-	if(connect(fd, reinterpret_cast<sockaddr*>(&address),
+	if(connect(socketFd, reinterpret_cast<sockaddr*>(&address),
 			sizeof(sockaddr_un)) != 0) {
-		close(fd);
-		fd = -1;
+		close(socketFd);
 		return false;
 	}
 
-	id = senderId;
+	fd = socketFd;
 
-	// NOTE The buffer size is hardcoded, increase it if necessary.
-	buffer.resize(1024);
+	state->isRunning.test_and_set();
+	state->thread = new std::thread(drainThread);
 	return true;
 }
 
 
 void loggerFree()
 {
+	std::lock_guard<std::mutex> lock(stateGuard);
+
+	if(!state || state->refCount == 0 || --state->refCount > 0)
+		return;
+
+	if(state->thread) {
+		// The drain thread sends the remaining records before termination.
+		state->isRunning.clear();
+		state->thread->join();
+		delete state->thread;
+		state->thread = nullptr;
+	}
+
 	if(fd >= 0) {
 		close(fd);
-		id.clear();
+		fd = -1;
 	}
 }
 
 
 LogLevel loggerLogLevel()
 {
-	return defaultLevel;
+	const LogContext* context = currentContext ? currentContext : &defaultContext;
+	return context->logLevel();
 }
 
 
 void loggerSetLogLevel(LogLevel level)
 {
-	defaultLevel = level;
+	defaultContext.setLogLevel(level);
 }
 
 
 std::string loggerSenderId()
 {
-	return id;
+	const LogContext* context = currentContext ? currentContext : &defaultContext;
+	return context->senderId();
 }
 
 
 void loggerSetSenderId(const std::string& senderId)
 {
-	id = senderId;
+	defaultContext.setSenderId(senderId);
 }
 
 
-void loggerMessage(LogLevel level, const char* format, ...)
+LogRecord* loggerAcquireRecord(LogLevel level, const char* format, bool isForced)
 {
-	if(level > defaultLevel)
-		return;
+	const LogContext* context = currentContext ? currentContext : &defaultContext;
 
-	if(fd == -1)
-		return;
+	if((!isForced && level > context->logLevel()) ||
+			fd.load(std::memory_order_relaxed) == -1) {
+		return nullptr;
+	}
 
-	timespec tm;
-	clock_gettime(CLOCK_REALTIME, &tm);
+	LogRing* ring = currentRing();
+	if(!ring) {
+		state->lost.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
 
-	u64* timestamp = reinterpret_cast<u64*>(buffer.data());
-	*timestamp = (static_cast<u64>(tm.tv_sec) << 32) + tm.tv_nsec;
+	u32 head = ring->head.load(std::memory_order_relaxed);
 
-	char* output = buffer.data() + sizeof(u64);
-	output = std::copy(id.begin(), id.end(), output);
-	*output = '\x01';
-	++output;
+	if(head - ring->tail.load(std::memory_order_acquire) >= LogRing::kCapacity) {
+		ring->dropped.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
 
-	uint count = output - buffer.data();
+	timespec tm;
+	clock_gettime(CLOCK_REALTIME, &tm);
 
-	va_list args;
-	va_start(args, format);
+	LogRecord* record = &ring->records[head % LogRing::kCapacity];
+	record->timestamp = (static_cast<u64>(tm.tv_sec) << 32) + tm.tv_nsec;
+	record->format = format;
+	record->level = level;
+	record->length = 0;
 
-	count += std::vsnprintf(output, buffer.size() - count, format, args) + 1;
+	// The drain thread sends the record later, so the sender id is captured here.
+	std::memcpy(record->senderId, context->senderId(), LogRecord::kSenderIdSize);
+	return record;
+}
 
-	va_end(args);
 
-	send(fd, buffer.data(), count, 0);
+void loggerCommitRecord(LogRecord* record)
+{
+	UNUSED(record);
+
+	LogRing* ring = threadRing.ring;
+	ring->head.store(ring->head.load(std::memory_order_relaxed) + 1,
+			std::memory_order_release);
 }
 
 
@@ -1,7 +1,10 @@
 #ifndef COMMON_LOGGER_H
 #define COMMON_LOGGER_H
 
+#include <atomic>
+#include <cstring>
 #include <string>
+#include "common/types.h"
 
 
 #define FLOOD(format, ...) \
@@ -21,6 +24,11 @@
 #define ERROR(format, ...) \
 		Airwave::loggerMessage(Airwave::LogLevel::kError, format, ##__VA_ARGS__)
 
+// The report is sent at the trace level regardless of the log level of the sender. It's
+// used for the records, which are aggregated by the airwave-manager.
+#define REPORT(format, ...) \
+		Airwave::loggerReport(format, ##__VA_ARGS__)
+
 namespace Airwave {
 
 
@@ -34,13 +42,227 @@ enum class LogLevel {
 };
 
 
+// The message is not formatted by the calling thread. Its format string pointer and the
+// arguments are stored into the record of the lock-free per-thread ring, then the
+// background thread formats and sends it. The format must be a string literal.
+struct LogRecord {
+	enum Tag : u8 {
+		kSigned = 1,
+		kUnsigned,
+		kDouble,
+		kPointer,
+		kString
+	};
+
+	static const size_t kSenderIdSize = 64;
+	static const size_t kDataSize = 232;
+
+	u64 timestamp;
+	const char* format;
+	LogLevel level;
+	u16 length;
+	char senderId[kSenderIdSize];
+	u8 data[kDataSize];
+
+	void put(Tag tag, const void* value, size_t size)
+	{
+		if(length + 1 + size > kDataSize) {
+			length = kDataSize;
+			return;
+		}
+
+		data[length++] = tag;
+		std::memcpy(data + length, value, size);
+		length += size;
+	}
+
+	void putString(const char* string)
+	{
+		if(!string)
+			string = "(null)";
+
+		// The string is truncated to fit the remaining space.
+		size_t used = length + 1 + sizeof(u16);
+		if(used >= kDataSize) {
+			length = kDataSize;
+			return;
+		}
+
+		size_t size = std::strlen(string);
+		if(used + size > kDataSize)
+			size = kDataSize - used;
+
+		u16 count = size;
+		data[length++] = kString;
+		std::memcpy(data + length, &count, sizeof(count));
+		std::memcpy(data + length + sizeof(count), string, size);
+		length += sizeof(count) + size;
+	}
+};
+
+
+// Sender id and log level of an endpoint. All plugin endpoints of the process share the
+// logger, so each of them makes its context current for the calling thread with
+// LogScope. The messages outside of any scope use the default context of the process,
+// which is set by loggerInit(), loggerSetSenderId() and loggerSetLogLevel().
+class LogContext {
+public:
+	LogContext(const std::string& senderId, LogLevel level);
+
+	LogContext(const LogContext&) = delete;
+	LogContext& operator=(const LogContext&) = delete;
+
+	const char* senderId() const;
+
+	// The sender id isn't synchronized, it should be set before the context is used by
+	// the other threads.
+	void setSenderId(const std::string& senderId);
+
+	LogLevel logLevel() const;
+	void setLogLevel(LogLevel level);
+
+private:
+	char senderId_[LogRecord::kSenderIdSize];
+	std::atomic<LogLevel> level_;
+};
+
+
+class LogScope {
+public:
+	explicit LogScope(const LogContext* context);
+	~LogScope();
+
+	LogScope(const LogScope&) = delete;
+	LogScope& operator=(const LogScope&) = delete;
+
+private:
+	const LogContext* previous_;
+};
+
+
+// The sender id is the id of the default context. It's set only by the first call, the
+// plugin endpoints of the process use their own contexts.
 bool loggerInit(const std::string& socketPath, const std::string& senderId);
 void loggerFree();
+
+// The getters return the values of the current context, the setters change the default
+// context.
 LogLevel loggerLogLevel();
 void loggerSetLogLevel(LogLevel level);
 std::string loggerSenderId();
 void loggerSetSenderId(const std::string& senderId);
-void loggerMessage(LogLevel level, const char* format, ...);
+
+LogRecord* loggerAcquireRecord(LogLevel level, const char* format,
+		bool isForced = false);
+void loggerCommitRecord(LogRecord* record);
+
+
+inline void loggerEncode(LogRecord* record, const char* value)
+{
+	record->putString(value);
+}
+
+
+inline void loggerEncode(LogRecord* record, const std::string& value)
+{
+	record->putString(value.c_str());
+}
+
+
+template<typename T>
+inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+loggerEncode(LogRecord* record, T value)
+{
+	i64 number = value;
+	record->put(LogRecord::kSigned, &number, sizeof(number));
+}
+
+
+template<typename T>
+inline typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+loggerEncode(LogRecord* record, T value)
+{
+	u64 number = value;
+	record->put(LogRecord::kUnsigned, &number, sizeof(number));
+}
+
+
+template<typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type
+loggerEncode(LogRecord* record, T value)
+{
+	double number = value;
+	record->put(LogRecord::kDouble, &number, sizeof(number));
+}
+
+
+template<typename T>
+inline typename std::enable_if<std::is_enum<T>::value>::type
+loggerEncode(LogRecord* record, T value)
+{
+	loggerEncode(record, static_cast<typename std::underlying_type<T>::type>(value));
+}
+
+
+template<typename T>
+inline typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type,
+		char>::value>::type
+loggerEncode(LogRecord* record, T* value)
+{
+	u64 number = reinterpret_cast<uintptr_t>(value);
+	record->put(LogRecord::kPointer, &number, sizeof(number));
+}
+
+
+// Small opaque values (like std::thread::id) are stored by their bytes.
+template<typename T>
+inline typename std::enable_if<std::is_class<T>::value>::type
+loggerEncode(LogRecord* record, const T& value)
+{
+	static_assert(sizeof(T) <= sizeof(u64), "The value is too large for the log record");
+
+	u64 number = 0;
+	std::memcpy(&number, &value, sizeof(T));
+	record->put(LogRecord::kUnsigned, &number, sizeof(number));
+}
+
+
+inline void loggerEncodeArgs(LogRecord* record)
+{
+	UNUSED(record);
+}
+
+
+template<typename T, typename... Args>
+inline void loggerEncodeArgs(LogRecord* record, const T& value, const Args&... args)
+{
+	loggerEncode(record, value);
+	loggerEncodeArgs(record, args...);
+}
+
+
+template<typename... Args>
+inline void loggerMessage(LogLevel level, const char* format, const Args&... args)
+{
+	LogRecord* record = loggerAcquireRecord(level, format);
+	if(!record)
+		return;
+
+	loggerEncodeArgs(record, args...);
+	loggerCommitRecord(record);
+}
+
+
+template<typename... Args>
+inline void loggerReport(const char* format, const Args&... args)
+{
+	LogRecord* record = loggerAcquireRecord(LogLevel::kTrace, format, true);
+	if(!record)
+		return;
+
+	loggerEncodeArgs(record, args...);
+	loggerCommitRecord(record);
+}
 
 
 } // namespace Airwave
@@ -1,26 +1,83 @@
 #include "moduleinfo.h"
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
-ModuleInfo::ModuleInfo() :
-	isInitialized_(false)
+
+namespace {
+
+
+const u16 kDosMagic          = 0x5A4D;     // "MZ"
+const u32 kPeSignature       = 0x00004550; // "PE\0\0"
+const u16 kMachineI386       = 0x014C;
+const u16 kMachineAmd64      = 0x8664;
+const u16 kCharacteristicDll = 0x2000;
+const u16 kOptionalMagic32   = 0x010B;
+const u16 kOptionalMagic64   = 0x020B;
+
+const size_t kFileHeaderSize    = 20;
+const size_t kSectionHeaderSize = 40;
+const size_t kExportDirSize     = 40;
+const u32 kMaxSectionCount      = 96;
+const u32 kMaxExportNameCount   = 65536;
+
+
+template<typename T>
+T readValue(const u8* data)
 {
-	magic_ = magic_open(MAGIC_NONE);
-	if(!magic_) {
-		return;
-	}
+	T value;
+	std::memcpy(&value, data, sizeof(T));
+	return value;
+}
+
+
+bool readAt(int fd, off_t offset, void* buffer, size_t size)
+{
+	ssize_t count = pread(fd, buffer, size, offset);
+	return count >= 0 && static_cast<size_t>(count) == size;
+}
+
+
+struct Section {
+	u32 virtualAddress;
+	u32 virtualSize;
+	u32 rawOffset;
+	u32 rawSize;
+};
+
 
-	if(magic_load(magic_, nullptr) != 0) {
-		magic_close(magic_);
-		return;
+// Converts the relative virtual address to the file offset, returns 0 if the address
+// doesn't belong to any section.
+off_t rvaToOffset(const std::vector<Section>& sections, u32 rva)
+{
+	for(const Section& section : sections) {
+		u32 size = section.virtualSize ? section.virtualSize : section.rawSize;
+
+		if(rva >= section.virtualAddress && rva - section.virtualAddress < size &&
+				rva - section.virtualAddress < section.rawSize) {
+			return static_cast<off_t>(section.rawOffset) + rva - section.virtualAddress;
+		}
 	}
 
-	isInitialized_ = true;
+	return 0;
+}
+
+
+} // namespace
+
+
+ModuleInfo::ModuleInfo()
+{
 }
 
 
 ModuleInfo::~ModuleInfo()
 {
-	magic_close(magic_);
 }
 
 
@@ -33,20 +90,289 @@ ModuleInfo* ModuleInfo::instance()
 
 ModuleInfo::Arch ModuleInfo::getArch(const std::string& fileName) const
 {
-	if(isInitialized_) {
-		const char* buffer = magic_file(magic_, fileName.c_str());
+	return getInfo(fileName).arch;
+}
+
+
+ModuleInfo::Info ModuleInfo::getInfo(const std::string& fileName) const
+{
+	Info info;
+	info.arch = kArchUnknown;
+	info.isDll = false;
+	info.hasVstEntry = false;
+
+	int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return info;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0) {
+		close(fd);
+		return info;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		auto it = cache_.find(fileName);
+		if(it != cache_.end() && it->second.size == st.st_size &&
+				it->second.mtime.tv_sec == st.st_mtim.tv_sec &&
+				it->second.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+			close(fd);
+			return it->second.info;
+		}
+	}
+
+	info = readInfo(fd, st.st_size);
+	close(fd);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if(cache_.size() >= kMaxCacheSize)
+		cache_.clear();
+
+	CacheEntry& entry = cache_[fileName];
+	entry.mtime = st.st_mtim;
+	entry.size = st.st_size;
+	entry.info = info;
+	return info;
+}
+
+
+bool ModuleInfo::findCached(const std::string& fileName, Info* info) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	auto it = cache_.find(fileName);
+	if(it == cache_.end())
+		return false;
+
+	*info = it->second.info;
+	return true;
+}
+
+
+bool ModuleInfo::loadCache(const std::string& path)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if(!file.is_open())
+		return false;
+
+	u32 header[3];
+	if(!file.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+			header[0] != kCacheMagic || header[1] != kCacheVersion) {
+		return false;
+	}
+
+	std::map<std::string, CacheEntry> cache;
+
+	for(u32 i = 0; i < header[2] && i < kMaxCacheSize; ++i) {
+		u32 nameLength;
+		if(!file.read(reinterpret_cast<char*>(&nameLength), sizeof(nameLength)) ||
+				nameLength == 0 || nameLength > 4096) {
+			return false;
+		}
+
+		std::string name(nameLength, '\0');
+		i64 values[3];
+		u8 flags[3];
+
+		if(!file.read(&name[0], nameLength) ||
+				!file.read(reinterpret_cast<char*>(values), sizeof(values)) ||
+				!file.read(reinterpret_cast<char*>(flags), sizeof(flags))) {
+			return false;
+		}
+
+		CacheEntry& entry = cache[name];
+		entry.mtime.tv_sec = values[0];
+		entry.mtime.tv_nsec = values[1];
+		entry.size = values[2];
+		entry.info.arch = static_cast<Arch>(flags[0]);
+		entry.info.isDll = flags[1];
+		entry.info.hasVstEntry = flags[2];
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// The entries, that were added during this session, are newer than the loaded ones.
+	for(const auto& item : cache) {
+		if(cache_.size() >= kMaxCacheSize)
+			break;
+
+		cache_.insert(item);
+	}
+
+	return true;
+}
+
+
+bool ModuleInfo::saveCache(const std::string& path) const
+{
+	std::string tempPath = path + ".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::trunc | std::ios::binary);
+		if(!file.is_open())
+			return false;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		u32 header[3] = { kCacheMagic, kCacheVersion, u32(cache_.size()) };
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+		for(const auto& item : cache_) {
+			u32 nameLength = item.first.size();
+			const CacheEntry& entry = item.second;
+
+			i64 values[3] = { entry.mtime.tv_sec, entry.mtime.tv_nsec, entry.size };
+			u8 flags[3] = { u8(entry.info.arch), entry.info.isDll, entry.info.hasVstEntry };
+
+			file.write(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
+			file.write(item.first.data(), nameLength);
+			file.write(reinterpret_cast<const char*>(values), sizeof(values));
+			file.write(reinterpret_cast<const char*>(flags), sizeof(flags));
+		}
+
+		if(!file) {
+			file.close();
+			unlink(tempPath.c_str());
+			return false;
+		}
+	}
+
+	if(std::rename(tempPath.c_str(), path.c_str()) != 0) {
+		unlink(tempPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+ModuleInfo::Info ModuleInfo::readInfo(int fd, off_t fileSize)
+{
+	Info info;
+	info.arch = kArchUnknown;
+	info.isDll = false;
+	info.hasVstEntry = false;
+
+	// DOS header
+	u8 dosHeader[64];
+	if(!readAt(fd, 0, dosHeader, sizeof(dosHeader)) ||
+			readValue<u16>(dosHeader) != kDosMagic) {
+		return info;
+	}
+
+	u32 peOffset = readValue<u32>(dosHeader + 0x3C);
+	if(static_cast<u64>(peOffset) + 4 + kFileHeaderSize > static_cast<u64>(fileSize))
+		return info;
+
+	// PE signature and COFF file header
+	u8 fileHeader[4 + kFileHeaderSize];
+	if(!readAt(fd, peOffset, fileHeader, sizeof(fileHeader)) ||
+			readValue<u32>(fileHeader) != kPeSignature) {
+		return info;
+	}
+
+	u16 machine = readValue<u16>(fileHeader + 4);
+	u16 sectionCount = readValue<u16>(fileHeader + 6);
+	u16 optionalSize = readValue<u16>(fileHeader + 20);
+	u16 characteristics = readValue<u16>(fileHeader + 22);
+
+	if(machine == kMachineI386) {
+		info.arch = kArch32;
+	}
+	else if(machine == kMachineAmd64) {
+		info.arch = kArch64;
+	}
+	else {
+		return info;
+	}
+
+	info.isDll = characteristics & kCharacteristicDll;
+
+	// Optional header, only the export directory entry is needed
+	std::vector<u8> optional(optionalSize);
+	off_t optionalOffset = peOffset + sizeof(fileHeader);
+
+	if(optionalSize < 2 || !readAt(fd, optionalOffset, optional.data(), optionalSize))
+		return info;
+
+	size_t dirCountOffset;
+	u16 optionalMagic = readValue<u16>(optional.data());
+
+	if(optionalMagic == kOptionalMagic32) {
+		dirCountOffset = 92;
+	}
+	else if(optionalMagic == kOptionalMagic64) {
+		dirCountOffset = 108;
+	}
+	else {
+		return info;
+	}
+
+	if(dirCountOffset + 12 > optionalSize ||
+			readValue<u32>(optional.data() + dirCountOffset) < 1) {
+		return info;
+	}
+
+	u32 exportRva = readValue<u32>(optional.data() + dirCountOffset + 4);
+	u32 exportSize = readValue<u32>(optional.data() + dirCountOffset + 8);
+	if(exportRva == 0 || exportSize < kExportDirSize)
+		return info;
+
+	// Section table
+	if(sectionCount == 0 || sectionCount > kMaxSectionCount)
+		return info;
+
+	std::vector<u8> sectionTable(sectionCount * kSectionHeaderSize);
+	if(!readAt(fd, optionalOffset + optionalSize, sectionTable.data(), sectionTable.size()))
+		return info;
+
+	std::vector<Section> sections(sectionCount);
+	for(u16 i = 0; i < sectionCount; ++i) {
+		const u8* header = sectionTable.data() + i * kSectionHeaderSize;
+		sections[i].virtualSize = readValue<u32>(header + 8);
+		sections[i].virtualAddress = readValue<u32>(header + 12);
+		sections[i].rawSize = readValue<u32>(header + 16);
+		sections[i].rawOffset = readValue<u32>(header + 20);
+	}
+
+	// Export directory
+	u8 exportDir[kExportDirSize];
+	off_t offset = rvaToOffset(sections, exportRva);
+	if(!offset || !readAt(fd, offset, exportDir, sizeof(exportDir)))
+		return info;
+
+	u32 nameCount = readValue<u32>(exportDir + 24);
+	u32 namesRva = readValue<u32>(exportDir + 32);
+	if(nameCount == 0 || nameCount > kMaxExportNameCount)
+		return info;
+
+	std::vector<u32> nameRvas(nameCount);
+	offset = rvaToOffset(sections, namesRva);
+	if(!offset || !readAt(fd, offset, nameRvas.data(), nameCount * sizeof(u32)))
+		return info;
+
+	for(u32 nameRva : nameRvas) {
+		// Both of the names are shorter than the buffer, so the longer names can be
+		// skipped after the comparison of their beginning.
+		char name[16];
+		std::memset(name, 0, sizeof(name));
+
+		offset = rvaToOffset(sections, nameRva);
+		if(!offset)
+			continue;
 
-		if(buffer) {
-			std::string string = buffer;
+		ssize_t count = pread(fd, name, sizeof(name) - 1, offset);
+		if(count <= 0)
+			continue;
 
-			if(string.find("80386") != std::string::npos) {
-				return kArch32;
-			}
-			else if(string.find("x86-64") != std::string::npos) {
-				return kArch64;
-			}
+		if(std::strcmp(name, "VSTPluginMain") == 0 || std::strcmp(name, "main") == 0) {
+			info.hasVstEntry = true;
+			break;
 		}
 	}
 
-	return kArchUnknown;
+	return info;
 }
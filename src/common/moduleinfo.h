@@ -1,10 +1,16 @@
 #ifndef COMMON_MODULEINFO_H
 #define COMMON_MODULEINFO_H
 
+#include <ctime>
+#include <map>
+#include <mutex>
 #include <string>
-#include <magic.h>
+#include "common/types.h"
 
 
+// Reads the architecture and the exports of the Windows PE module directly from its
+// headers. The results are cached by the file path and invalidated when the modification
+// time or the size of the file is changed.
 class ModuleInfo {
 public:
 	enum Arch {
@@ -13,6 +19,12 @@ public:
 		kArch64      = 64
 	};
 
+	struct Info {
+		Arch arch;
+		bool isDll;
+		bool hasVstEntry;    // Exports VSTPluginMain or main
+	};
+
 	static ModuleInfo* instance();
 
 	ModuleInfo(const ModuleInfo&) = delete;
@@ -21,12 +33,33 @@ public:
 	~ModuleInfo();
 
 	Arch getArch(const std::string& fileName) const;
+	Info getInfo(const std::string& fileName) const;
+
+	// Returns the cached information without checking the file, so it could be outdated.
+	bool findCached(const std::string& fileName, Info* info) const;
+
+	// The cache could be kept between sessions. The loaded entries are validated by the
+	// modification time and the size of the file, as usual.
+	bool loadCache(const std::string& path);
+	bool saveCache(const std::string& path) const;
 
 private:
-	bool isInitialized_;
-	magic_t magic_;
+	struct CacheEntry {
+		timespec mtime;
+		off_t size;
+		Info info;
+	};
+
+	static const size_t kMaxCacheSize = 4096;
+	static const u32 kCacheMagic = 0x494D5741;
+	static const u32 kCacheVersion = 1;
+
+	mutable std::mutex mutex_;
+	mutable std::map<std::string, CacheEntry> cache_;
 
 	ModuleInfo();
+
+	static Info readInfo(int fd, off_t fileSize);
 };
 
 
@@ -1,12 +1,14 @@
 #ifndef COMMON_PROTOCOL_H
 #define COMMON_PROTOCOL_H
 
+#include <cstddef>
 #include "common/types.h"
 
 
 namespace Airwave {
 
 
+// The new commands are appended to the end, along with their names and kCommandCount.
 enum class Command {
 	Response,
 	Dispatch,
@@ -19,17 +21,73 @@ enum class Command {
 	ShowWindow,
 	GetDataBlock,
 	SetDataBlock,
-	AudioMaster
+	AudioMaster,
+	DumpStats,
+	Park,
+	EditorState
 };
 
 
+static const char* const kCommandNames[] = {
+	"Response",
+	"Dispatch",
+	"GetParameter",
+	"SetParameter",
+	"ProcessSingle",
+	"ProcessDouble",
+	"HostInfo",
+	"PluginInfo",
+	"ShowWindow",
+	"GetDataBlock",
+	"SetDataBlock",
+	"AudioMaster",
+	"DumpStats",
+	"Park",
+	"EditorState"
+};
+
+
+const int kCommandCount = static_cast<int>(Command::EditorState) + 1;
+
+static_assert(sizeof(kCommandNames) / sizeof(kCommandNames[0]) == kCommandCount,
+		"Every command should have a name");
+
+
+// Size of the cache line, the shared memory structures are aligned to.
+const size_t kCacheLineSize = 64;
+
+
+// The header fields are naturally aligned and placed so, that the layout is the same for
+// the 32-bit and 64-bit endpoints. The payload starts on the cache line boundary.
 struct DataFrame {
 	Command command;
 	i32     opcode;
 	i32     index;
-	i64     value;	// The 64-bit value is used here to avoid 64->32 bridging issues
 	float   opt;
-	u8      data[];
+	i64     value;	// The 64-bit value is used here to avoid 64->32 bridging issues
+	alignas(kCacheLineSize) u8 data[];
+};
+
+static_assert(offsetof(DataFrame, value) == 16, "DataFrame layout is changed");
+static_assert(offsetof(DataFrame, data) == kCacheLineSize, "DataFrame layout is changed");
+
+
+// Distance between the audio channels in the payload of the process request, in samples.
+// Every channel starts on the cache line boundary, so the VST plugin gets the aligned
+// buffers.
+template<typename T>
+inline size_t channelStride(size_t sampleCount)
+{
+	size_t size = (sampleCount * sizeof(T) + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+	return size / sizeof(T);
+}
+
+
+// Per-link options, sent to the host endpoint along with the HostInfo command.
+struct HostOptions {
+	i32 editorRate;     // Hz, zero for the refresh rate of the display
+	i32 flushDenormals;
+	i32 countDenormals;
 } __attribute__((packed));
 
 
@@ -45,6 +103,17 @@ struct PluginInfo {
 } __attribute__((packed));
 
 
+// Startup timestamps of the host endpoint, sent after the PluginInfo. The values are
+// taken from CLOCK_MONOTONIC in nanoseconds.
+struct HostTimings {
+	u64 bootTime;       // Entry of main()
+	u64 loadTime;       // The VST library is loaded
+	u64 attachTime;     // The HostInfo command is received
+	u64 mainTime;       // VSTPluginMain() has returned
+	i32 isAdopted;      // The host process was parked by another plugin endpoint
+} __attribute__((packed));
+
+
 } // namespace Airwave
 
 
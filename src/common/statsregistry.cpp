@@ -0,0 +1,165 @@
+#include "statsregistry.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common/config.h"
+
+
+namespace Airwave {
+
+
+StatsRegistry::StatsRegistry() :
+	header_(nullptr),
+	slots_(nullptr)
+{
+}
+
+
+StatsRegistry::~StatsRegistry()
+{
+	if(header_)
+		munmap(header_, sizeof(Header) + sizeof(InstanceStats) * kSlotCount);
+}
+
+
+StatsRegistry* StatsRegistry::instance()
+{
+	static StatsRegistry registry;
+	return &registry;
+}
+
+
+bool StatsRegistry::open()
+{
+	if(header_)
+		return true;
+
+	const size_t size = sizeof(Header) + sizeof(InstanceStats) * kSlotCount;
+
+	int fd = ::open(path().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if(fd < 0)
+		return false;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (static_cast<size_t>(st.st_size) < size &&
+			ftruncate(fd, size) != 0)) {
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if(data == MAP_FAILED)
+		return false;
+
+	Header* header = static_cast<Header*>(data);
+
+	// The header content is the same for all processes, so the concurrent
+	// initialization is harmless.
+	u32 magic = __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE);
+	if(magic == 0) {
+		header->version = kVersion;
+		header->slotCount = kSlotCount;
+		header->slotSize = sizeof(InstanceStats);
+		__atomic_store_n(&header->magic, kMagic, __ATOMIC_RELEASE);
+	}
+	else if(magic != kMagic || header->version != kVersion ||
+			header->slotCount != kSlotCount || header->slotSize != sizeof(InstanceStats)) {
+		munmap(data, size);
+		return false;
+	}
+
+	header_ = header;
+	slots_ = reinterpret_cast<InstanceStats*>(header + 1);
+	return true;
+}
+
+
+bool StatsRegistry::isOpen() const
+{
+	return header_;
+}
+
+
+InstanceStats* StatsRegistry::slot(int index) const
+{
+	if(!slots_ || index < 0 || index >= kSlotCount)
+		return nullptr;
+
+	return &slots_[index];
+}
+
+
+int StatsRegistry::indexOf(const InstanceStats* slot) const
+{
+	if(!slots_ || !slot)
+		return -1;
+
+	return static_cast<int>(slot - slots_);
+}
+
+
+InstanceStats* StatsRegistry::acquire(const std::string& name)
+{
+	if(!slots_)
+		return nullptr;
+
+	i32 pid = getpid();
+
+	for(int i = 0; i < kSlotCount; ++i) {
+		InstanceStats* slot = &slots_[i];
+		i32 owner = __atomic_load_n(&slot->pluginPid, __ATOMIC_ACQUIRE);
+
+		// Slots of the crashed processes are never released, so reclaim them too.
+		if(owner != 0 && isAlive(slot))
+			continue;
+
+		if(!__atomic_compare_exchange_n(&slot->pluginPid, &owner, pid, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			continue;
+		}
+
+		// Everything after the owner is cleared, so the new instance never inherits the
+		// counters of the previous one, including the crashed one.
+		const size_t offset = offsetof(InstanceStats, hostPid);
+		std::memset(reinterpret_cast<u8*>(slot) + offset, 0, sizeof(InstanceStats) - offset);
+
+		std::strncpy(slot->name, name.c_str(), sizeof(slot->name) - 1);
+		return slot;
+	}
+
+	return nullptr;
+}
+
+
+void StatsRegistry::release(InstanceStats* slot)
+{
+	if(slot)
+		__atomic_store_n(&slot->pluginPid, 0, __ATOMIC_RELEASE);
+}
+
+
+bool StatsRegistry::isAlive(const InstanceStats* slot)
+{
+	i32 pid = __atomic_load_n(&slot->pluginPid, __ATOMIC_ACQUIRE);
+	return pid != 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+
+std::string StatsRegistry::path()
+{
+	// The layout version is a part of the name, so the file of the previous version, left
+	// in the tmpfs, doesn't prevent the new one from being created.
+	return "/dev/shm/" PROJECT_NAME "-stats-" + std::to_string(getuid()) + ".v" +
+			std::to_string(kVersion);
+}
+
+
+} // namespace Airwave
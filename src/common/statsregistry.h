@@ -0,0 +1,135 @@
+#ifndef COMMON_STATSREGISTRY_H
+#define COMMON_STATSREGISTRY_H
+
+#include <ctime>
+#include <string>
+#include "common/types.h"
+
+
+namespace Airwave {
+
+
+// Number of the output channels, which levels are published by the output sanitizer.
+const int kStatsMeterChannels = 8;
+
+
+// Live counters of a single plugin/host endpoint pair. The structure is shared between
+// the 32-bit and 64-bit processes, so it contains only fixed size fields and all 64-bit
+// fields are placed at 8-byte aligned offsets.
+struct InstanceStats {
+	i32 pluginPid;         // Zero for the free slot
+	i32 hostPid;
+	u32 sampleRate;
+	u32 blockSize;
+	char name[64];
+
+	u64 blockCount;
+	u64 xrunCount;
+	u64 roundTripSum;      // Nanoseconds, summed over the blockCount blocks
+	u64 roundTripMax;      // Nanoseconds
+	u64 hostCpuTime;       // Nanoseconds of the host audio thread CPU time
+	u64 hostBlockCount;    // Blocks, which were measured by the hostCpuTime
+	u64 chunkBytes;        // Bytes transferred by effGetChunk and effSetChunk
+	u64 denormalInputs;    // Denormal samples in the sampled blocks, if counted
+	u64 denormalOutputs;
+	u64 nonFiniteOutputs;  // NaN and infinite output samples, replaced by zero
+	u64 clippedOutputs;    // Output samples, clamped to the output limit
+	u32 meterChannelCount; // Zero, if the output sanitizer is disabled
+	u32 reserved1;
+
+	// Linear levels of the output channels over the last meter window. The 32-bit
+	// values are never torn, so they are written without the atomic accesses. Like the
+	// rest of the slot, they are zeroed by acquire(), so the levels and the counters
+	// of the previous owner are never shown for the new instance.
+	float outputPeak[kStatsMeterChannels];
+	float outputRms[kStatsMeterChannels];
+	u64 reserved[2];
+};
+
+static_assert(sizeof(InstanceStats) == 256, "InstanceStats layout is changed");
+
+
+// The counters are written by a single thread, so there is no need in read-modify-write
+// atomic operations. The relaxed atomic accesses just guarantee that the readers will
+// never see the torn 64-bit values on the 32-bit architecture.
+inline u64 statsLoad(const u64* counter)
+{
+	return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+
+inline void statsStore(u64* counter, u64 value)
+{
+	__atomic_store_n(counter, value, __ATOMIC_RELAXED);
+}
+
+
+inline void statsAdd(u64* counter, u64 value)
+{
+	statsStore(counter, statsLoad(counter) + value);
+}
+
+
+inline void statsMax(u64* counter, u64 value)
+{
+	if(value > statsLoad(counter))
+		statsStore(counter, value);
+}
+
+
+inline u64 threadCpuTime()
+{
+	timespec tm;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tm);
+	return static_cast<u64>(tm.tv_sec) * 1000000000 + tm.tv_nsec;
+}
+
+
+// Per-user shared memory file with the fixed number of InstanceStats slots. Every plugin
+// endpoint claims a slot for its lifetime, the host endpoint attaches to the same slot,
+// and the manager periodically reads all of them.
+class StatsRegistry {
+public:
+	static const int kSlotCount = 256;
+
+	static StatsRegistry* instance();
+
+	StatsRegistry(const StatsRegistry&) = delete;
+	StatsRegistry& operator=(const StatsRegistry&) = delete;
+
+	~StatsRegistry();
+
+	bool open();
+	bool isOpen() const;
+
+	InstanceStats* slot(int index) const;
+	int indexOf(const InstanceStats* slot) const;
+
+	InstanceStats* acquire(const std::string& name);
+	void release(InstanceStats* slot);
+
+	static bool isAlive(const InstanceStats* slot);
+	static std::string path();
+
+private:
+	struct Header {
+		u32 magic;
+		u32 version;
+		u32 slotCount;
+		u32 slotSize;
+	};
+
+	static const u32 kMagic = 0x53575241;
+	static const u32 kVersion = 2;
+
+	Header* header_;
+	InstanceStats* slots_;
+
+	StatsRegistry();
+};
+
+
+} // namespace Airwave
+
+
+#endif // COMMON_STATSREGISTRY_H
@@ -4,11 +4,24 @@
 #include "common/config.h"
 #include "common/filesystem.h"
 #include "common/json.h"
+#include "common/linkindex.h"
 
 
 namespace Airwave {
 
 
+// The link options are stored as the separate boolean values.
+static const struct {
+	Storage::LinkOption option;
+	const char* key;
+} kLinkOptionKeys[] = {
+	{ Storage::kFlushDenormals, "flush_denormals" },
+	{ Storage::kCountDenormals, "count_denormals" },
+	{ Storage::kSanitizeOutput, "sanitize_output" },
+	{ Storage::kClampOutput, "clamp_output" }
+};
+
+
 Storage::Storage() :
 	isChanged_(false)
 {
@@ -53,21 +66,18 @@ bool Storage::reload()
 	logSocketPath_ = tempPath + "/" PROJECT_NAME ".sock";
 
 	defaultLogLevel_ = LogLevel::kTrace;
+	processDeadline_ = 0;
+	hostKeepAlive_ = 10;
+	bootLimit_ = 4;
 
 	// Find and read a configuration file
-	string = getenv("XDG_CONFIG_PATH");
-	std::string configPath = string ? string : std::string();
-	if(configPath.empty())
-		configPath = "~/.config";
-
-	configPath = FileSystem::realPath(configPath);
-	if(configPath.back() != '/')
-		configPath += '/';
+	std::string filePath = defaultFilePath();
+	std::string configPath = filePath.substr(0, filePath.rfind("/" PROJECT_NAME "/"));
 
 	if(!FileSystem::isDirExists(configPath))
 		return false;
 
-	storageFilePath_ = configPath + PROJECT_NAME "/" PROJECT_NAME ".conf";
+	storageFilePath_ = filePath;
 
 	std::ifstream file(storageFilePath_);
 	if(!file.is_open())
@@ -94,6 +104,27 @@ bool Storage::reload()
 			defaultLogLevel_ = LogLevel::kTrace;
 	}
 
+	value = root["process_deadline"];
+	if(!value.isNull()) {
+		processDeadline_ = value.asInt();
+		if(processDeadline_ < 0)
+			processDeadline_ = 0;
+	}
+
+	value = root["host_keep_alive"];
+	if(!value.isNull()) {
+		hostKeepAlive_ = value.asInt();
+		if(hostKeepAlive_ < 0)
+			hostKeepAlive_ = 0;
+	}
+
+	value = root["boot_limit"];
+	if(!value.isNull()) {
+		bootLimit_ = value.asInt();
+		if(bootLimit_ < 0)
+			bootLimit_ = 0;
+	}
+
 	// Load prefixes
 	Json::Value prefixes = root["prefixes"];
 	for(uint i = 0; i < prefixes.size(); ++i) {
@@ -148,6 +179,22 @@ bool Storage::reload()
 				info.level = LogLevel::kDefault;
 		}
 
+		value = link["editor_rate"];
+		if(value.isNull()) {
+			info.editorRate = kDefaultEditorRate;
+		}
+		else {
+			info.editorRate = value.asInt();
+			if(info.editorRate < 0 || info.editorRate > kMaxEditorRate)
+				info.editorRate = kDefaultEditorRate;
+		}
+
+		info.options = 0;
+		for(const auto& item : kLinkOptionKeys) {
+			if(link[item.key].asBool())
+				info.options |= item.option;
+		}
+
 		path = link["path"].asString();
 		linkByPath_.emplace(makePair(path, info));
 	}
@@ -177,6 +224,9 @@ bool Storage::save()
 	root["binaries_path"] = binariesPath_;
 	root["log_socket_path"] = logSocketPath_;
 	root["default_log_level"] = static_cast<int>(defaultLogLevel_);
+	root["process_deadline"] = processDeadline_;
+	root["host_keep_alive"] = hostKeepAlive_;
+	root["boot_limit"] = bootLimit_;
 
 	Json::Value prefixes(Json::arrayValue);
 	for(auto it : prefixByName_) {
@@ -214,6 +264,12 @@ bool Storage::save()
 		link["prefix"] = it.second.prefix;
 		link["target"] = it.second.target;
 		link["log_level"] = static_cast<int>(it.second.level);
+		link["editor_rate"] = it.second.editorRate;
+
+		for(const auto& item : kLinkOptionKeys) {
+			if(it.second.options & item.option)
+				link[item.key] = true;
+		}
 
 		links.append(link);
 	}
@@ -222,9 +278,34 @@ bool Storage::save()
 
 	Json::StyledWriter writer;
 	file << writer.write(root);
+	file.close();
 
 	isChanged_ = false;
-	return true;
+	return saveIndex();
+}
+
+
+bool Storage::saveIndex()
+{
+	if(storageFilePath_.empty())
+		return false;
+
+	return LinkIndex::write(this, storageFilePath_);
+}
+
+
+std::string Storage::defaultFilePath()
+{
+	const char* string = getenv("XDG_CONFIG_PATH");
+	std::string configPath = string ? string : std::string();
+	if(configPath.empty())
+		configPath = "~/.config";
+
+	configPath = FileSystem::realPath(configPath);
+	if(configPath.empty() || configPath.back() != '/')
+		configPath += '/';
+
+	return configPath + PROJECT_NAME "/" PROJECT_NAME ".conf";
 }
 
 
@@ -267,6 +348,45 @@ void Storage::setDefaultLogLevel(LogLevel level)
 }
 
 
+int Storage::processDeadline() const
+{
+	return processDeadline_;
+}
+
+
+void Storage::setProcessDeadline(int percent)
+{
+	processDeadline_ = percent;
+	isChanged_ = true;
+}
+
+
+int Storage::hostKeepAlive() const
+{
+	return hostKeepAlive_;
+}
+
+
+void Storage::setHostKeepAlive(int seconds)
+{
+	hostKeepAlive_ = seconds;
+	isChanged_ = true;
+}
+
+
+int Storage::bootLimit() const
+{
+	return bootLimit_;
+}
+
+
+void Storage::setBootLimit(int count)
+{
+	bootLimit_ = count;
+	isChanged_ = true;
+}
+
+
 Storage::Prefix Storage::prefix(const std::string& name)
 {
 	if(name.empty())
@@ -360,6 +480,8 @@ Storage::Link Storage::createLink(const std::string& path, const std::string& ta
 	info.prefix = prefix;
 	info.loader = loader;
 	info.level  = LogLevel::kDefault;
+	info.editorRate = kDefaultEditorRate;
+	info.options = 0;
 
 	auto result = linkByPath_.emplace(makePair(path, info));
 	if(!result.second)
@@ -699,6 +821,42 @@ void Storage::Link::setLogLevel(LogLevel level)
 }
 
 
+int Storage::Link::editorRate() const
+{
+	if(isNull())
+		return kDefaultEditorRate;
+
+	return it_->second.editorRate;
+}
+
+
+void Storage::Link::setEditorRate(int rate)
+{
+	if(!isNull() && rate != it_->second.editorRate) {
+		it_->second.editorRate = rate;
+		storage_->isChanged_ = true;
+	}
+}
+
+
+int Storage::Link::options() const
+{
+	if(isNull())
+		return 0;
+
+	return it_->second.options;
+}
+
+
+void Storage::Link::setOptions(int options)
+{
+	if(!isNull() && options != it_->second.options) {
+		it_->second.options = options;
+		storage_->isChanged_ = true;
+	}
+}
+
+
 Storage::Link Storage::Link::next() const
 {
 	if(storage_ && it_ != storage_->linkByPath_.end()) {
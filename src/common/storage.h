@@ -60,12 +60,24 @@ public:
 		Loader(Storage* storage, LoaderMap::iterator it);
 	};
 
+	static const int kDefaultEditorRate = 10;
+	static const int kMaxEditorRate = 240;
+
+	// Audio processing options of the link, the bits of Link::options().
+	enum LinkOption {
+		kFlushDenormals = 1 << 0,   // Force FTZ/DAZ while the VST plugin processes
+		kCountDenormals = 1 << 1,   // Count the denormal samples of the sampled blocks
+		kSanitizeOutput = 1 << 2,   // Replace NaN/Inf of the output and meter it
+		kClampOutput    = 1 << 3    // Clamp the sanitized output to the output limit
+	};
 
 	struct LinkInfo {
 		std::string target;
 		std::string prefix;
 		std::string loader;
 		LogLevel level;
+		int editorRate;
+		int options;
 	};
 
 	class Link {
@@ -88,6 +100,14 @@ public:
 		LogLevel logLevel() const;
 		void setLogLevel(LogLevel level);
 
+		// Rate of the effEditIdle events of the visible editor, in Hz. Zero means the
+		// refresh rate of the display.
+		int editorRate() const;
+		void setEditorRate(int rate);
+
+		int options() const;
+		void setOptions(int options);
+
 		Link next() const;
 		bool operator!() const;
 
@@ -106,6 +126,9 @@ public:
 
 	bool reload();
 	bool save();
+	bool saveIndex();
+
+	static std::string defaultFilePath();
 
 	std::string logSocketPath() const;
 	void setLogSocketPath(const std::string& path);
@@ -116,6 +139,17 @@ public:
 	LogLevel defaultLogLevel() const;
 	void setDefaultLogLevel(LogLevel level);
 
+	int processDeadline() const;
+	void setProcessDeadline(int percent);
+
+	int hostKeepAlive() const;
+	void setHostKeepAlive(int seconds);
+
+	// Maximum number of the host processes, booting in the same WINE prefix at once.
+	// Zero means no limit.
+	int bootLimit() const;
+	void setBootLimit(int count);
+
 	Prefix prefix(const std::string& name = std::string());
 	Prefix createPrefix(const std::string& name, const std::string& path);
 	bool removePrefix(Prefix prefix);
@@ -142,6 +176,9 @@ private:
 	std::string logSocketPath_;
 	std::string binariesPath_;
 	LogLevel defaultLogLevel_;
+	int processDeadline_;
+	int hostKeepAlive_;
+	int bootLimit_;
 
 	std::map<std::string, std::string> prefixByName_;
 	std::map<std::string, std::string> loaderByName_;
@@ -0,0 +1,267 @@
+#include "timeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+
+namespace Airwave {
+
+
+namespace {
+
+
+struct Event {
+	u64 time;
+	const char* category;
+	const char* name;
+	char phase;
+};
+
+
+struct ThreadBuffer {
+	static const u64 kCapacity = 8192;
+
+	std::atomic<bool> isUsed;
+	int tid;
+	char name[32];
+	std::atomic<u64> head;
+
+	// Head at the moment of the last export, which is accessed under the guard.
+	u64 exportedHead;
+
+	Event events[kCapacity];
+};
+
+
+// The first event of a thread usually comes from the audio thread, which is the one
+// being measured, so its buffer is taken from the pool, allocated in advance, without
+// any locks. The buffers are never released, so the events of the finished threads
+// are exported too. The threads beyond the pool aren't traced.
+const int kBufferCount = 64;
+
+ThreadBuffer* buffers = nullptr;
+std::atomic<int> bufferCount(0);
+
+std::mutex guard;
+std::string processName;
+std::string outputDirectory;
+
+thread_local ThreadBuffer* threadBuffer = nullptr;
+thread_local bool isThreadTraced = true;
+
+
+ThreadBuffer* currentBuffer()
+{
+	if(threadBuffer || !isThreadTraced)
+		return threadBuffer;
+
+	int index = bufferCount.fetch_add(1, std::memory_order_relaxed);
+	if(index >= kBufferCount) {
+		isThreadTraced = false;
+		return nullptr;
+	}
+
+	ThreadBuffer* buffer = &buffers[index];
+	buffer->tid = syscall(SYS_gettid);
+	buffer->name[0] = '\0';
+	buffer->head.store(0, std::memory_order_relaxed);
+	buffer->exportedHead = 0;
+	buffer->isUsed.store(true, std::memory_order_release);
+
+	threadBuffer = buffer;
+	return buffer;
+}
+
+
+void record(char phase, const char* category, const char* name)
+{
+	timespec tm;
+	clock_gettime(CLOCK_MONOTONIC, &tm);
+
+	ThreadBuffer* buffer = currentBuffer();
+	if(!buffer)
+		return;
+
+	u64 head = buffer->head.load(std::memory_order_relaxed);
+
+	Event& event = buffer->events[head % ThreadBuffer::kCapacity];
+	event.time = static_cast<u64>(tm.tv_sec) * 1000000000 + tm.tv_nsec;
+	event.category = category;
+	event.name = name;
+	event.phase = phase;
+
+	buffer->head.store(head + 1, std::memory_order_release);
+}
+
+
+std::string escape(const std::string& string)
+{
+	std::string result;
+
+	for(char c : string) {
+		if(c == '"' || c == '\\') {
+			result += '\\';
+		}
+		else if(static_cast<unsigned char>(c) < 0x20) {
+			continue;
+		}
+
+		result += c;
+	}
+
+	return result;
+}
+
+
+void writeEvents(FILE* file)
+{
+	int pid = getpid();
+
+	std::lock_guard<std::mutex> lock(guard);
+
+	for(int i = 0; i < kBufferCount; ++i) {
+		ThreadBuffer* buffer = &buffers[i];
+		if(!buffer->isUsed.load(std::memory_order_acquire))
+			continue;
+
+		if(buffer->name[0]) {
+			std::fprintf(file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,"
+					"\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n", pid, buffer->tid,
+					escape(buffer->name).c_str());
+		}
+
+		// The oldest events may be overwritten while they are being exported, but that's
+		// acceptable for the diagnostic output. Every plugin instance exports the trace
+		// on close, so only the events since the previous export are written, otherwise
+		// the events of the shared threads would be repeated in every trace.
+		u64 head = buffer->head.load(std::memory_order_acquire);
+		u64 tail = head > ThreadBuffer::kCapacity ? head - ThreadBuffer::kCapacity : 0;
+		tail = std::max(tail, buffer->exportedHead);
+		buffer->exportedHead = head;
+
+		for(u64 j = tail; j < head; ++j) {
+			const Event& event = buffer->events[j % ThreadBuffer::kCapacity];
+			const char* name = event.name ? event.name : event.category;
+
+			std::fprintf(file, "{\"ph\":\"%c\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":%d,"
+					"\"tid\":%d,\"ts\":%llu.%03llu},\n", event.phase, event.category, name,
+					pid, buffer->tid, static_cast<unsigned long long>(event.time / 1000),
+					static_cast<unsigned long long>(event.time % 1000));
+		}
+	}
+}
+
+
+void writeProcessName(FILE* file, const char* separator)
+{
+	std::fprintf(file, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,"
+			"\"args\":{\"name\":\"%s\"}}%s", getpid(), escape(processName).c_str(),
+			separator);
+}
+
+
+} // anonymous namespace
+
+
+bool Timeline::isEnabled_ = false;
+
+
+bool Timeline::initialize(const std::string& name)
+{
+	if(isEnabled_)
+		return true;
+
+	const char* directory = std::getenv(kDirectoryEnv);
+	if(!directory || !directory[0])
+		return false;
+
+	buffers = new ThreadBuffer[kBufferCount];
+	for(int i = 0; i < kBufferCount; ++i)
+		buffers[i].isUsed.store(false, std::memory_order_relaxed);
+
+	outputDirectory = directory;
+	processName = name;
+	isEnabled_ = true;
+	return true;
+}
+
+
+std::string Timeline::directory()
+{
+	return outputDirectory;
+}
+
+
+void Timeline::begin(const char* category, const char* name)
+{
+	record('B', category, name);
+}
+
+
+void Timeline::end()
+{
+	record('E', "", nullptr);
+}
+
+
+void Timeline::setThreadName(const char* name)
+{
+	if(!isEnabled_)
+		return;
+
+	ThreadBuffer* buffer = currentBuffer();
+	if(!buffer)
+		return;
+
+	std::strncpy(buffer->name, name, sizeof(buffer->name) - 1);
+	buffer->name[sizeof(buffer->name) - 1] = '\0';
+}
+
+
+bool Timeline::savePart(const std::string& fileName)
+{
+	FILE* file = std::fopen(fileName.c_str(), "w");
+	if(!file)
+		return false;
+
+	writeEvents(file);
+	writeProcessName(file, ",\n");
+	return std::fclose(file) == 0;
+}
+
+
+bool Timeline::exportTrace(const std::string& fileName, const std::string& partFileName)
+{
+	FILE* file = std::fopen(fileName.c_str(), "w");
+	if(!file)
+		return false;
+
+	std::fputs("[\n", file);
+	writeEvents(file);
+
+	FILE* part = std::fopen(partFileName.c_str(), "r");
+	if(part) {
+		char buffer[4096];
+		size_t count;
+
+		while((count = std::fread(buffer, 1, sizeof(buffer), part)) > 0)
+			std::fwrite(buffer, 1, count, file);
+
+		std::fclose(part);
+		unlink(partFileName.c_str());
+	}
+
+	// The last event has no trailing comma.
+	writeProcessName(file, "\n]\n");
+	return std::fclose(file) == 0;
+}
+
+
+} // namespace Airwave
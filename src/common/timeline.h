@@ -0,0 +1,74 @@
+#ifndef COMMON_TIMELINE_H
+#define COMMON_TIMELINE_H
+
+#include <string>
+#include "common/types.h"
+
+
+namespace Airwave {
+
+
+// Opt-in tracer, which records begin/end events into per-thread ring buffers. The
+// events are exported in the Chrome trace event format (chrome://tracing, Perfetto UI).
+// Tracing is enabled by setting the AIRWAVE_TIMELINE environment variable to the
+// directory, where the traces should be written.
+class Timeline {
+public:
+	static constexpr const char* kDirectoryEnv = "AIRWAVE_TIMELINE";
+	static constexpr const char* kPartEnv = "AIRWAVE_TIMELINE_PART";
+
+	static bool initialize(const std::string& processName);
+
+	static bool isEnabled()
+	{
+		return isEnabled_;
+	}
+
+	static std::string directory();
+
+	// Category and name must be the static strings, only pointers are recorded.
+	static void begin(const char* category, const char* name = nullptr);
+	static void end();
+
+	static void setThreadName(const char* name);
+
+	// Writes the events of the current process as a fragment, which can be merged later.
+	static bool savePart(const std::string& fileName);
+
+	// Writes the complete trace with the events of the current process, recorded since
+	// the previous export, and the fragment from the partFileName, which is removed
+	// afterwards.
+	static bool exportTrace(const std::string& fileName, const std::string& partFileName);
+
+private:
+	static bool isEnabled_;
+};
+
+
+class TimelineScope {
+public:
+	TimelineScope(const char* category, const char* name = nullptr) :
+		isActive_(Timeline::isEnabled())
+	{
+		if(isActive_)
+			Timeline::begin(category, name);
+	}
+
+	~TimelineScope()
+	{
+		if(isActive_)
+			Timeline::end();
+	}
+
+	TimelineScope(const TimelineScope&) = delete;
+	TimelineScope& operator=(const TimelineScope&) = delete;
+
+private:
+	bool isActive_;
+};
+
+
+} // namespace Airwave
+
+
+#endif // COMMON_TIMELINE_H
@@ -1,8 +1,12 @@
 #include "host.h"
 
 #include <cstring>
+#include <unistd.h>
+#include "common/denormals.h"
+#include "common/hostpark.h"
 #include "common/logger.h"
 #include "common/protocol.h"
+#include "common/timeline.h"
 
 
 namespace Airwave {
@@ -13,15 +17,32 @@ Host* Host::self_ = nullptr;
 
 Host::Host() :
 	isInitialized_(false),
+	vstMainProc_(nullptr),
 	hwnd_(0),
+	idleInterval_(0),
+	effect_(nullptr),
 	data_(nullptr),
 	dataLength_(0),
+	stats_(nullptr),
+	flushDenormals_(false),
+	countDenormals_(false),
+	processCount_(0),
 	runAudio_(ATOMIC_FLAG_INIT),
 	isEditorOpen_(false),
+	editorRate_(0),
+	displayRate_(60),
+	isEditorShown_(false),
+	isEditorMapped_(false),
+	isEditorActive_(false),
+	isClassRegistered_(false),
+	parkTimeout_(0),
 	oldWndProc_(nullptr),
 	childHwnd_(0)
 {
 	DEBUG("Main thread id: %p", GetCurrentThreadId());
+
+	std::memset(&timings_, 0, sizeof(HostTimings));
+	timings_.bootTime = monotonicTime();
 }
 
 
@@ -30,11 +51,12 @@ Host::~Host()
 	if(isInitialized_) {
 		TRACE("Waiting for audio thread termination...");
 
-		runAudio_.clear();
-		WaitForSingleObject(audioThread_, INFINITE);
-
+		stopAudioThread();
 		destroyEditorWindow();
 
+		if(isClassRegistered_)
+			UnregisterClass(kWindowClass, GetModuleHandle(nullptr));
+
 		DeleteCriticalSection(&cs_);
 		FreeLibrary(module_);
 	}
@@ -54,19 +76,21 @@ bool Host::initialize(const char* fileName, int portId)
 		return false;
 	}
 
+	timings_.loadTime = monotonicTime();
+
 	if(!InitializeCriticalSectionAndSpinCount(&cs_, 0x00010000))  {
 		FreeLibrary(module_);
 		return false;
 	}
 
-	VstPluginMainProc vstMainProc = reinterpret_cast<VstPluginMainProc>(
+	vstMainProc_ = reinterpret_cast<VstPluginMainProc>(
 			GetProcAddress(module_, "VSTPluginMain"));
 
-	if(!vstMainProc) {
-		vstMainProc = reinterpret_cast<VstPluginMainProc>(
+	if(!vstMainProc_) {
+		vstMainProc_ = reinterpret_cast<VstPluginMainProc>(
 				GetProcAddress(module_, "main"));
 
-		if(!vstMainProc) {
+		if(!vstMainProc_) {
 			ERROR("The %s is not a VST plugin");
 			DeleteCriticalSection(&cs_);
 			FreeLibrary(module_);
@@ -74,34 +98,59 @@ bool Host::initialize(const char* fileName, int portId)
 		}
 	}
 
-	if(!controlPort_.connect(portId)) {
-		ERROR("Unable to connect control port (id = %d)", portId);
+	callbackPort_.setLatencyStats(&latencyStats_);
+
+	if(!attach(portId)) {
 		DeleteCriticalSection(&cs_);
 		FreeLibrary(module_);
 		return false;
 	}
 
+	isInitialized_ = true;
+	return true;
+}
+
+
+bool Host::attach(int portId)
+{
+	if(!controlPort_.connect(portId)) {
+		ERROR("Unable to connect control port (id = %d)", portId);
+		return false;
+	}
+
 	TRACE("Waiting for plugin endpoint request...");
 
 	if(!controlPort_.waitRequest()) {
 		ERROR("Unable to get initial request from plugin endpoint");
 		controlPort_.disconnect();
-		DeleteCriticalSection(&cs_);
-		FreeLibrary(module_);
 		return false;
 	}
 
 	TRACE("Request from plugin endpoint received, sending response");
 
+	timings_.attachTime = monotonicTime();
+
 	DataFrame* frame = controlPort_.frame<DataFrame>();
 	if(!callbackPort_.connect(frame->opcode)) {
 		ERROR("Unable to connect callback port (id = %d)", frame->opcode);
 		controlPort_.disconnect();
-		DeleteCriticalSection(&cs_);
-		FreeLibrary(module_);
 		return false;
 	}
 
+	const HostOptions* options = reinterpret_cast<const HostOptions*>(frame->data);
+	editorRate_ = options->editorRate;
+	flushDenormals_ = options->flushDenormals != 0;
+	countDenormals_ = options->countDenormals != 0;
+	processCount_ = 0;
+
+	// Attach to the live statistics slot, claimed by the plugin endpoint.
+	stats_ = nullptr;
+	if(frame->index >= 0 && StatsRegistry::instance()->open()) {
+		stats_ = StatsRegistry::instance()->slot(frame->index);
+		if(stats_)
+			stats_->hostPid = getpid();
+	}
+
 	// When we call vstMainProc(), the audioMasterProc() can be called from there with
 	// effect argument set to the nullptr. This is because VST plugin object is not yet
 	// initialized at this point. Since we need the pointer to our object inside of
@@ -112,18 +161,19 @@ bool Host::initialize(const char* fileName, int portId)
 
 	TRACE("Initializing VST plugin...");
 
-	effect_ = vstMainProc(audioMasterProc);
+	effect_ = vstMainProc_(audioMasterProc);
 	if(!effect_ || effect_->magic != kEffectMagic) {
 		ERROR("Unable to initialize VST plugin");
 		controlPort_.disconnect();
 		callbackPort_.disconnect();
-		DeleteCriticalSection(&cs_);
-		FreeLibrary(module_);
+		effect_ = nullptr;
 		return false;
 	}
 
 	TRACE("VST plugin is initialized");
 
+	timings_.mainTime = monotonicTime();
+
 	std::memset(&timeInfo_, 0, sizeof(VstTimeInfo));
 
 	frame->command = Command::PluginInfo;
@@ -145,13 +195,82 @@ bool Host::initialize(const char* fileName, int portId)
 			info->flags |= effFlagsHasEditor;
 	}
 
-	controlPort_.sendResponse();
+	std::memcpy(info + 1, &timings_, sizeof(HostTimings));
 
-	isInitialized_ = true;
+	controlPort_.sendResponse();
 	return true;
 }
 
 
+bool Host::park(const std::string& name)
+{
+	int timeout = parkTimeout_;
+	parkTimeout_ = 0;
+
+	if(timeout <= 0 || name.empty())
+		return false;
+
+	// The effect is already closed by effClose, only the library stays loaded. The
+	// next plugin endpoint gets the fresh effect instance from vstMainProc().
+	stopAudioThread();
+	destroyEditorWindow();
+	isEditorOpen_ = false;
+
+	controlPort_.disconnect();
+	callbackPort_.disconnect();
+	audioPort_.disconnect();
+
+	effect_ = nullptr;
+	stats_ = nullptr;
+	data_ = nullptr;
+	dataLength_ = 0;
+	chunk_.clear();
+	latencyStats_.reset();
+
+	HostPark hostPark;
+	if(!hostPark.listen(name)) {
+		TRACE("Another host endpoint is already parked for this plugin");
+		return false;
+	}
+
+	TRACE("Host endpoint is parked for %d seconds", timeout);
+
+	HostPark::Request request;
+	bool isAdopted = false;
+
+	// The messages are still pumped, because the VST library could have its own hidden
+	// windows and timers.
+	for(int i = 0; i < timeout * 10 && !isAdopted; ++i) {
+		isAdopted = hostPark.wait(100, &request);
+
+		MSG message;
+		while(PeekMessage(&message, 0, 0, 0, PM_REMOVE)) {
+			TranslateMessage(&message);
+			DispatchMessage(&message);
+		}
+	}
+
+	hostPark.close();
+
+	if(!isAdopted) {
+		TRACE("Nobody adopted the parked host endpoint");
+		return false;
+	}
+
+	LogLevel level = static_cast<LogLevel>(request.logLevel);
+	if(level >= LogLevel::kQuiet && level <= LogLevel::kFlood)
+		loggerSetLogLevel(level);
+
+	TRACE("Host endpoint is adopted by the new plugin endpoint");
+
+	// Neither WINE nor the VST library is loaded for the adopting plugin endpoint.
+	timings_.bootTime = monotonicTime();
+	timings_.loadTime = timings_.bootTime;
+	timings_.isAdopted = 1;
+	return attach(request.controlPortId);
+}
+
+
 bool Host::processRequest()
 {
 	if(!controlPort_.isConnected()) {
@@ -178,6 +297,20 @@ bool Host::processRequest()
 		handleSetDataBlock(frame);
 		break;
 
+	case Command::DumpStats:
+		latencyStats_.dump("Host endpoint");
+		break;
+
+	case Command::Park:
+		parkTimeout_ = frame->value;
+		result = false;
+		break;
+
+	case Command::EditorState:
+		isEditorMapped_ = frame->index != 0;
+		updateIdleTimer();
+		break;
+
 	case Command::ShowWindow: {
 		if(hwnd_) {
 			ShowWindow(hwnd_, SW_SHOW);
@@ -225,14 +358,84 @@ std::string Host::errorString() const
 void Host::destroyEditorWindow()
 {
 	if(hwnd_) {
-		KillTimer(hwnd_, timerId_);
+		KillTimer(hwnd_, kIdleTimerId);
+		idleInterval_ = 0;
 		DestroyWindow(hwnd_);
-		UnregisterClass(kWindowClass, GetModuleHandle(nullptr));
 		hwnd_ = 0;
 	}
 }
 
 
+void Host::updateIdleTimer()
+{
+	UINT interval = 0;
+
+	if(hwnd_ && isEditorOpen_ && isEditorShown_ && isEditorMapped_) {
+		int rate = editorRate_ > 0 ? editorRate_ : displayRate_;
+		interval = 1000 / rate;
+
+		if(!isEditorActive_ && interval < kInactiveIdleInterval)
+			interval = kInactiveIdleInterval;
+	}
+
+	if(interval == idleInterval_)
+		return;
+
+	if(interval) {
+		SetTimer(hwnd_, kIdleTimerId, interval, nullptr);
+	}
+	else {
+		KillTimer(hwnd_, kIdleTimerId);
+	}
+
+	DEBUG("Editor idle interval: %u ms", interval);
+	idleInterval_ = interval;
+}
+
+
+bool Host::registerWindowClass()
+{
+	// The class is registered once and kept until the process exits, so the editor
+	// could be reopened without the round trip to the wineserver.
+	if(isClassRegistered_)
+		return true;
+
+	WNDCLASSEX wclass;
+	std::memset(&wclass, 0, sizeof(WNDCLASSEX));
+
+	wclass.cbSize        = sizeof(WNDCLASSEX);
+	wclass.style         = CS_HREDRAW | CS_VREDRAW;
+	wclass.lpfnWndProc   = windowProc;
+	wclass.cbClsExtra    = 0;
+	wclass.cbWndExtra    = 0;
+	wclass.hInstance     = GetModuleHandle(nullptr);
+	wclass.hIcon         = LoadIcon(nullptr, kWindowClass);
+	wclass.hCursor       = LoadCursor(nullptr, IDC_ARROW);
+	wclass.lpszClassName = kWindowClass;
+
+	if(!RegisterClassEx(&wclass)) {
+		ERROR("Unable to register window class: %s", errorString().c_str());
+		return false;
+	}
+
+	isClassRegistered_ = true;
+	return true;
+}
+
+
+void Host::stopAudioThread()
+{
+	// The audio thread sets the flag again on exit, so it is cleared after the wait.
+	if(runAudio_.test_and_set()) {
+		runAudio_.clear();
+		WaitForSingleObject(audioThread_, INFINITE);
+		CloseHandle(audioThread_);
+	}
+
+	runAudio_.clear();
+}
+
+
 void Host::audioThread()
 {
 	condition_.post();
@@ -286,13 +489,9 @@ void Host::handleSetDataBlock(DataFrame* frame)
 
 bool Host::handleDispatch(DataFrame* frame)
 {
+	TimelineScope scope("Host::handleDispatch", kDispatchEvents[frame->opcode]);
 	FLOOD("handleDispatch: %s", kDispatchEvents[frame->opcode]);
 
-	if(isEditorOpen_ && frame->opcode != effEditIdle) {
-		// Postpone the effEditIdle event by 100 milliseconds
-		SetTimer(hwnd_, timerId_, 100, nullptr);
-	}
-
 	switch(frame->opcode) {
 	case effClose:
 		// Some stupid hosts doesn't send the effEditClose event before sending
@@ -306,6 +505,8 @@ bool Host::handleDispatch(DataFrame* frame)
 
 		frame->value = effect_->dispatcher(effect_, frame->opcode, frame->index,
 				frame->value, nullptr, frame->opt);
+
+		latencyStats_.dump("Host endpoint");
 		break;
 
 	case effGetVstVersion:
@@ -341,10 +542,7 @@ bool Host::handleDispatch(DataFrame* frame)
 		break;
 
 	case effSetBlockSize:
-		if(runAudio_.test_and_set()) {
-			runAudio_.clear();
-			WaitForSingleObject(audioThread_, INFINITE);
-		}
+		stopAudioThread();
 
 		audioPort_.disconnect();
 		if(!audioPort_.connect(frame->index)) {
@@ -362,30 +560,14 @@ bool Host::handleDispatch(DataFrame* frame)
 		break;
 
 	case effEditOpen: {
-		WNDCLASSEX wclass;
-		std::memset(&wclass, 0, sizeof(WNDCLASSEX));
-
-		wclass.cbSize        = sizeof(WNDCLASSEX);
-		wclass.style         = CS_HREDRAW | CS_VREDRAW;
-		wclass.lpfnWndProc   = windowProc;
-		wclass.cbClsExtra    = 0;
-		wclass.cbWndExtra    = 0;
-		wclass.hInstance     = GetModuleHandle(nullptr);
-		wclass.hIcon         = LoadIcon(nullptr, kWindowClass);
-		wclass.hCursor       = LoadCursor(nullptr, IDC_ARROW);
-		wclass.lpszClassName = kWindowClass;
-
-		if(!RegisterClassEx(&wclass)) {
-			ERROR("Unable to register window class: %s", errorString().c_str());
+		if(!registerWindowClass())
 			return false;
-		}
 
 		hwnd_ = CreateWindowEx(WS_EX_TOOLWINDOW, kWindowClass, "Plugin", WS_POPUP, 0, 0,
 				200, 200, 0, 0, GetModuleHandle(nullptr), 0);
 
 		if(!hwnd_) {
 			ERROR("Unable to create window: %s", errorString().c_str());
-			UnregisterClass(kWindowClass, module_);
 			return false;
 		}
 
@@ -406,12 +588,26 @@ bool Host::handleDispatch(DataFrame* frame)
 
 		std::memcpy(&frame->data, rect, sizeof(ERect));
 
-		timerId_ = SetTimer(hwnd_, 0, 100, nullptr);
-
 		HANDLE handle = GetPropA(hwnd_, "__wine_x11_whole_window");
 		frame->value = reinterpret_cast<intptr_t>(handle);
 
+		if(editorRate_ <= 0) {
+			DEVMODE mode;
+			std::memset(&mode, 0, sizeof(DEVMODE));
+			mode.dmSize = sizeof(DEVMODE);
+
+			// Some drivers report 0 or 1 for the default refresh rate of the hardware.
+			if(EnumDisplaySettings(nullptr, ENUM_CURRENT_SETTINGS, &mode) &&
+					mode.dmDisplayFrequency > 1) {
+				displayRate_ = mode.dmDisplayFrequency;
+			}
+		}
+
+		// The timer is started, when the window is shown.
 		isEditorOpen_ = true;
+		isEditorShown_ = false;
+		isEditorMapped_ = true;
+		isEditorActive_ = true;
 		break; }
 
 	case effEditGetRect: {
@@ -499,6 +695,7 @@ bool Host::handleDispatch(DataFrame* frame)
 
 void Host::handleGetParameter()
 {
+	TimelineScope scope("Host::handleGetParameter");
 //	DataFrame* frame = controlPort_.frame<DataFrame>();
 	DataFrame* frame = audioPort_.frame<DataFrame>();
 	frame->opt = effect_->getParameter(effect_, frame->index);
@@ -507,6 +704,7 @@ void Host::handleGetParameter()
 
 void Host::handleSetParameter()
 {
+	TimelineScope scope("Host::handleSetParameter");
 //	DataFrame* frame = controlPort_.frame<DataFrame>();
 	DataFrame* frame = audioPort_.frame<DataFrame>();
 	effect_->setParameter(effect_, frame->index, frame->opt);
@@ -515,39 +713,98 @@ void Host::handleSetParameter()
 
 void Host::handleProcessSingle()
 {
+	TimelineScope scope("Host::handleProcessSingle");
 	DataFrame* frame = audioPort_.frame<DataFrame>();
 
 	float* inputs[effect_->numInputs];
 	float* outputs[effect_->numOutputs];
 	i32 sampleCount = frame->value;
 	float* data = reinterpret_cast<float*>(frame->data);
+	size_t stride = channelStride<float>(sampleCount);
 
 	for(int i = 0; i < effect_->numInputs; ++i)
-		inputs[i] = data + i * sampleCount;
+		inputs[i] = data + i * stride;
 
 	for(int i = 0; i < effect_->numOutputs; ++i)
-		outputs[i] = data + i * sampleCount;
+		outputs[i] = data + i * stride;
+
+	// The buffers are shared by the inputs and the outputs, so the inputs are counted
+	// before the processing.
+	bool isSampled = isDenormalSample();
+	if(isSampled) {
+		statsAdd(&stats_->denormalInputs,
+				countDenormals(inputs, effect_->numInputs, sampleCount));
+	}
+
+	u64 cpuTime = stats_ ? threadCpuTime() : 0;
+
+	{
+		DenormalGuard guard(flushDenormals_);
+		effect_->processReplacing(effect_, inputs, outputs, sampleCount);
+	}
+
+	if(stats_) {
+		statsAdd(&stats_->hostCpuTime, threadCpuTime() - cpuTime);
+		statsAdd(&stats_->hostBlockCount, 1);
+	}
 
-	effect_->processReplacing(effect_, inputs, outputs, sampleCount);
+	if(isSampled) {
+		statsAdd(&stats_->denormalOutputs,
+				countDenormals(outputs, effect_->numOutputs, sampleCount));
+	}
 }
 
 
 void Host::handleProcessDouble()
 {
+	TimelineScope scope("Host::handleProcessDouble");
 	DataFrame* frame = audioPort_.frame<DataFrame>();
 
 	double* inputs[effect_->numInputs];
 	double* outputs[effect_->numOutputs];
 	i32 sampleCount = frame->value;
 	double* data = reinterpret_cast<double*>(frame->data);
+	size_t stride = channelStride<double>(sampleCount);
 
 	for(int i = 0; i < effect_->numInputs; ++i)
-		inputs[i] = data + i * sampleCount;
+		inputs[i] = data + i * stride;
 
 	for(int i = 0; i < effect_->numOutputs; ++i)
-		outputs[i] = data + i * sampleCount;
+		outputs[i] = data + i * stride;
+
+	// The buffers are shared by the inputs and the outputs, so the inputs are counted
+	// before the processing.
+	bool isSampled = isDenormalSample();
+	if(isSampled) {
+		statsAdd(&stats_->denormalInputs,
+				countDenormals(inputs, effect_->numInputs, sampleCount));
+	}
+
+	u64 cpuTime = stats_ ? threadCpuTime() : 0;
+
+	{
+		DenormalGuard guard(flushDenormals_);
+		effect_->processDoubleReplacing(effect_, inputs, outputs, sampleCount);
+	}
 
-	effect_->processDoubleReplacing(effect_, inputs, outputs, sampleCount);
+	if(stats_) {
+		statsAdd(&stats_->hostCpuTime, threadCpuTime() - cpuTime);
+		statsAdd(&stats_->hostBlockCount, 1);
+	}
+
+	if(isSampled) {
+		statsAdd(&stats_->denormalOutputs,
+				countDenormals(outputs, effect_->numOutputs, sampleCount));
+	}
+}
+
+
+bool Host::isDenormalSample()
+{
+	if(!countDenormals_ || !stats_)
+		return false;
+
+	return processCount_++ % kDenormalSampleInterval == 0;
 }
 
 
@@ -556,6 +813,10 @@ intptr_t Host::audioMaster(i32 opcode, i32 index, intptr_t value, void* ptr, flo
 	if(opcode != audioMasterGetTime && opcode != audioMasterIdle)
 		FLOOD("handleAudioMaster(%s)", kAudioMasterEvents[opcode]);
 
+	// The VST library could call back from its timers, while the host endpoint is parked.
+	if(callbackPort_.isNull())
+		return 0;
+
 	DataFrame* frame = callbackPort_.frame<DataFrame>();
 	frame->command = Command::AudioMaster;
 	frame->opcode  = opcode;
@@ -689,6 +950,8 @@ intptr_t VSTCALLBACK Host::audioMasterProc(AEffect* effect, i32 opcode, i32 inde
 {
 	UNUSED(effect);
 
+	TimelineScope scope("Host::audioMaster", kAudioMasterEvents[opcode]);
+
 	EnterCriticalSection(&self_->cs_);
 	intptr_t result = self_->audioMaster(opcode, index, value, ptr, opt);
 
@@ -700,6 +963,7 @@ intptr_t VSTCALLBACK Host::audioMasterProc(AEffect* effect, i32 opcode, i32 inde
 DWORD CALLBACK Host::audioThreadProc(void* param)
 {
 	TRACE("Audio thread started");
+	Timeline::setThreadName("Host audio thread");
 
 	Host* host = static_cast<Host*>(param);
 	host->audioThread();
@@ -718,6 +982,16 @@ LRESULT CALLBACK Host::windowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM
 			ShowWindow(hwnd, SW_HIDE);
 			return 0;
 
+		case WM_SHOWWINDOW:
+			self_->isEditorShown_ = wParam != FALSE;
+			self_->updateIdleTimer();
+			break;
+
+		case WM_ACTIVATE:
+			self_->isEditorActive_ = LOWORD(wParam) != WA_INACTIVE;
+			self_->updateIdleTimer();
+			break;
+
 		case WM_PARENTNOTIFY:
 			if(wParam == WM_CREATE) {
 				self_->childHwnd_ = reinterpret_cast<HWND>(lParam);
@@ -730,7 +1004,8 @@ LRESULT CALLBACK Host::windowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM
 			break;
 
 		case WM_TIMER:
-			self_->effect_->dispatcher(self_->effect_, effEditIdle, 0, 0, nullptr, 0.0f);
+			if(wParam == kIdleTimerId && self_->isEditorOpen_)
+				self_->effect_->dispatcher(self_->effect_, effEditIdle, 0, 0, nullptr, 0.0f);
 			break;
 		}
 	}
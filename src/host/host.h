@@ -8,6 +8,9 @@
 #include "common/config.h"
 #include "common/dataport.h"
 #include "common/event.h"
+#include "common/latencystats.h"
+#include "common/protocol.h"
+#include "common/statsregistry.h"
 #include "common/vst24.h"
 #include "common/vsteventkeeper.h"
 
@@ -26,12 +29,18 @@ public:
 	bool initialize(const char* fileName, int portId);
 	bool processRequest();
 
+	// Keeps the process with the loaded VST library, if the plugin endpoint asked for
+	// it on close, until the next plugin endpoint of the same link adopts it. Returns
+	// false, if the process should exit.
+	bool park(const std::string& name);
+
 private:
 	bool isInitialized_;
 	HMODULE module_;
+	VstPluginMainProc vstMainProc_;
 	HWND hwnd_;
 	CRITICAL_SECTION cs_;
-	UINT_PTR timerId_;
+	UINT idleInterval_;
 	AEffect* effect_;
 	VstTimeInfo timeInfo_;
 	VstEventKeeper events_;
@@ -46,19 +55,50 @@ private:
 
 	Event condition_;
 
+	LatencyStats latencyStats_;
+	InstanceStats* stats_;
+
+	// Denormal protection and detection options of the link. Only every Nth processed
+	// block is checked for the denormals, so the detection is cheap enough to leave on.
+	bool flushDenormals_;
+	bool countDenormals_;
+	u32 processCount_;
+
+	// Reported to the plugin endpoint for its startup profile.
+	HostTimings timings_;
+
 	HANDLE audioThread_;
 	std::atomic_flag runAudio_;
 
 	bool isEditorOpen_;
 
+	// The effEditIdle timer runs at the editor rate of the link, which could be aligned
+	// to the refresh rate of the display. It is throttled, when the editor is inactive,
+	// and stopped, when the editor is hidden by WINE or unmapped by the VST host.
+	int editorRate_;
+	int displayRate_;
+	bool isEditorShown_;
+	bool isEditorMapped_;
+	bool isEditorActive_;
+	bool isClassRegistered_;
+	int parkTimeout_;
+
 	WNDPROC oldWndProc_;
 	HWND childHwnd_;
 
 	static Host* self_;
 	static constexpr const char* kWindowClass = PROJECT_NAME;
+	static const UINT_PTR kIdleTimerId = 1;
+	static const UINT kInactiveIdleInterval = 250;
+	static const u32 kDenormalSampleInterval = 16;
+
+	bool attach(int portId);
 
 	std::string errorString() const;
+	bool registerWindowClass();
 	void destroyEditorWindow();
+	void updateIdleTimer();
+	void stopAudioThread();
 
 	void audioThread();
 
@@ -70,6 +110,7 @@ private:
 	void handleSetParameter();
 	void handleProcessSingle();
 	void handleProcessDouble();
+	bool isDenormalSample();
 
 	intptr_t audioMaster(i32 opcode, i32 index, intptr_t value, void* ptr, float opt);
 
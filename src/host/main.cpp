@@ -2,7 +2,9 @@
 #include "host.h"
 #include "common/config.h"
 #include "common/filesystem.h"
+#include "common/hostpark.h"
 #include "common/logger.h"
+#include "common/timeline.h"
 
 
 using namespace Airwave;
@@ -34,6 +36,13 @@ int main(int argc, const char* argv[])
 
 	TRACE("Initializing host endpoint %s", VERSION_STRING);
 
+	// The timeline part is merged into the trace by the plugin endpoint.
+	const char* timelinePart = getenv(Timeline::kPartEnv);
+	if(timelinePart && Timeline::initialize(HOST_BASENAME ": " +
+			FileSystem::baseName(argv[1]))) {
+		Timeline::setThreadName("Host main thread");
+	}
+
 	Host* host = new Host;
 	if(!host->initialize(argv[1], atoi(argv[2]))) {
 		ERROR("Unable to initialize host endpoint");
@@ -43,18 +52,26 @@ int main(int argc, const char* argv[])
 
 	TRACE("Host endpoint is initialized");
 
-	while(host->processRequest()) {
-		MSG message;
+	// The plugin endpoint allows to park the process, unless the timeline is recorded.
+	const char* parkName = getenv(HostPark::kNameEnv);
+
+	do {
+		while(host->processRequest()) {
+			MSG message;
 
-		while(PeekMessage(&message, 0, 0, 0, PM_REMOVE)) {
-			TranslateMessage(&message);
-			DispatchMessage(&message);
+			while(PeekMessage(&message, 0, 0, 0, PM_REMOVE)) {
+				TranslateMessage(&message);
+				DispatchMessage(&message);
+			}
 		}
-	}
+	} while(parkName && host->park(parkName));
 
 	TRACE("Terminating the host endpoint...");
 	delete host;
 
+	if(timelinePart && Timeline::isEnabled() && !Timeline::savePart(timelinePart))
+		ERROR("Unable to save the timeline to %s", timelinePart);
+
 	TRACE("Host endpoint terminated");
 	loggerFree();
 	return 0;
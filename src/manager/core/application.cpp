@@ -2,6 +2,8 @@
 #include "application.h"
 #include "common/config.h"
 #include "common/storage.h"
+#include "core/pluginscanner.h"
+#include "core/wineserverkeeper.h"
 #include "models/linksmodel.h"
 #include "models/loadersmodel.h"
 #include "models/prefixesmodel.h"
@@ -12,13 +14,24 @@ Application::Application(int& argc, char** argv) :
 	storage_(new Airwave::Storage),
 	links_(new LinksModel(this)),
 	loaders_(new LoadersModel(this)),
-	prefixes_(new PrefixesModel(this))
+	prefixes_(new PrefixesModel(this)),
+	wineServers_(new WineServerKeeper(this))
 {
+	// The link index could be missing, if the configuration file was written by the
+	// previous version or edited by hand.
+	storage_->saveIndex();
+
+	QObject::connect(wineServers_,
+			SIGNAL(stateChanged(QString)),
+			prefixes_,
+			SLOT(updateServerState(QString)));
 }
 
 
 Application::~Application()
 {
+	qDeleteAll(scanners_);
+	delete wineServers_;
 	delete prefixes_;
 	delete loaders_;
 	delete links_;
@@ -32,6 +45,18 @@ LogSocket* Application::logSocket()
 }
 
 
+LogStore* Application::logStore()
+{
+	return &logStore_;
+}
+
+
+StartupStats* Application::startupStats()
+{
+	return &startupStats_;
+}
+
+
 Storage* Application::storage() const
 {
 	return storage_;
@@ -56,6 +81,26 @@ PrefixesModel* Application::prefixes() const
 }
 
 
+WineServerKeeper* Application::wineServers() const
+{
+	return wineServers_;
+}
+
+
+PluginScanner* Application::pluginScanner(const QString& prefixPath)
+{
+	QString path = QDir(prefixPath).absolutePath();
+
+	PluginScanner* scanner = scanners_.value(path);
+	if(!scanner) {
+		scanner = new PluginScanner(path);
+		scanners_.insert(path, scanner);
+	}
+
+	return scanner;
+}
+
+
 QStringList Application::checkMissingBinaries(const QString& path) const
 {
 	QString binPath = path;
@@ -1,8 +1,11 @@
 #ifndef CORE_APPLICATION_H
 #define CORE_APPLICATION_H
 
+#include <QHash>
 #include "core/logsocket.h"
+#include "core/logstore.h"
 #include "core/singleapplication.h"
+#include "core/startupstats.h"
 
 #ifdef qApp
 #undef qApp
@@ -12,7 +15,9 @@
 
 class LinksModel;
 class LoadersModel;
+class PluginScanner;
 class PrefixesModel;
+class WineServerKeeper;
 
 namespace Airwave {
 class Storage;
@@ -25,19 +30,29 @@ public:
 	~Application();
 
 	LogSocket* logSocket();
+	LogStore* logStore();
+	StartupStats* startupStats();
 	Airwave::Storage* storage() const;
 	LinksModel* links() const;
 	LoadersModel* loaders() const;
 	PrefixesModel* prefixes() const;
+	WineServerKeeper* wineServers() const;
+
+	// The scanners are kept until exit, so their indexes stay up to date between scans.
+	PluginScanner* pluginScanner(const QString& prefixPath);
 
 	QStringList checkMissingBinaries(const QString& path = QString()) const;
 
 private:
 	LogSocket logSocket_;
+	LogStore logStore_;
+	StartupStats startupStats_;
 	Airwave::Storage* storage_;
 	LinksModel* links_;
 	LoadersModel* loaders_;
 	PrefixesModel* prefixes_;
+	WineServerKeeper* wineServers_;
+	QHash<QString, PluginScanner*> scanners_;
 };
 
 
@@ -4,7 +4,6 @@
 #include <cstring>
 #include <unistd.h>
 #include <linux/un.h>
-#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <QByteArray>
 
@@ -12,7 +11,9 @@
 LogSocket::LogSocket(QObject* parent) :
 	QObject(parent),
 	fd_(-1),
-	notifier_(nullptr)
+	notifier_(nullptr),
+	bufferSize_(kDefaultBufferSize),
+	arena_(kBatchSize * kMaxDatagramSize)
 {
 }
 
@@ -31,7 +32,7 @@ QString LogSocket::id() const
 
 bool LogSocket::listen(const QString& id)
 {
-	fd_ = socket(AF_UNIX, SOCK_DGRAM, 0);
+	fd_ = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
 	if(fd_ < 0) {
 		qDebug("Unable to create socket: %s", strerror(errno));
 		return false;
@@ -43,7 +44,7 @@ bool LogSocket::listen(const QString& id)
 	std::memset(&address, 0, sizeof(address));
 
 	address.sun_family = AF_UNIX;
-	std::snprintf(address.sun_path, UNIX_PATH_MAX, id.toUtf8().constData());
+	std::snprintf(address.sun_path, UNIX_PATH_MAX, "%s", id.toUtf8().constData());
 
 	if(bind(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
 		qDebug("Unable to bind socket: %s", strerror(errno));
@@ -52,9 +53,11 @@ bool LogSocket::listen(const QString& id)
 		return false;
 	}
 
+	applyBufferSize();
+
 	id_ = id;
 	notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read);
-	connect(notifier_, SIGNAL(activated(int)), SLOT(handleDatagram()));
+	connect(notifier_, SIGNAL(activated(int)), SLOT(handleDatagrams()));
 	return true;
 }
 
@@ -63,41 +66,107 @@ void LogSocket::close()
 {
 	if(fd_ != -1) {
 		delete notifier_;
+		notifier_ = nullptr;
 		::close(fd_);
+		fd_ = -1;
 		unlink(id_.toUtf8().constData());
 	}
 }
 
 
-void LogSocket::handleDatagram()
+int LogSocket::receiveBufferSize() const
+{
+	return bufferSize_;
+}
+
+
+void LogSocket::setReceiveBufferSize(int size)
+{
+	bufferSize_ = size;
+	applyBufferSize();
+}
+
+
+void LogSocket::applyBufferSize()
 {
-	size_t length = 0;
-	if(ioctl(fd_, FIONREAD, &length) < 0) {
-		qDebug("ioctl() call failed: %s", strerror(errno));
+	if(fd_ == -1)
 		return;
+
+	// SO_RCVBUFFORCE allows to exceed the net.core.rmem_max limit, but it requires the
+	// CAP_NET_ADMIN capability.
+	if(setsockopt(fd_, SOL_SOCKET, SO_RCVBUFFORCE, &bufferSize_, sizeof(bufferSize_)) < 0 &&
+			setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &bufferSize_, sizeof(bufferSize_)) < 0) {
+		qDebug("Unable to set socket receive buffer size: %s", strerror(errno));
 	}
+}
 
-	char* buffer = new char[length];
 
-	if(recvfrom(fd_, buffer, length, 0, nullptr, nullptr) < 0) {
-		qDebug("recvfrom() call failed: %s", strerror(errno));
-		delete [] buffer;
-		return;
+void LogSocket::handleDatagrams()
+{
+	mmsghdr headers[kBatchSize];
+	iovec vectors[kBatchSize];
+
+	std::memset(headers, 0, sizeof(headers));
+
+	for(int i = 0; i < kBatchSize; ++i) {
+		vectors[i].iov_base = arena_.data() + i * kMaxDatagramSize;
+		vectors[i].iov_len = kMaxDatagramSize;
+		headers[i].msg_hdr.msg_iov = &vectors[i];
+		headers[i].msg_hdr.msg_iovlen = 1;
 	}
 
-	quint64* timeStamp = reinterpret_cast<quint64*>(buffer);
-	const char* sender = buffer + sizeof(quint64);
+	QVector<LogMessage> messages;
 
-	const char* message;
-	message = static_cast<const char*>(std::memchr(sender, 0x01, length));
-	if(!message) {
-		qDebug("Discarding invalid datagram.");
-		delete [] buffer;
-		return;
+	// Limit the number of the datagrams, handled at once, to keep the UI responsive.
+	// The rest of them will be handled on the next notifier activation.
+	for(int batch = 0; batch < kMaxBatchCount; ++batch) {
+		int count = recvmmsg(fd_, headers, kBatchSize, MSG_DONTWAIT, nullptr);
+		if(count < 0) {
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				qDebug("recvmmsg() call failed: %s", strerror(errno));
+
+			break;
+		}
+
+		messages.reserve(messages.count() + count);
+
+		for(int i = 0; i < count; ++i) {
+			const char* buffer = arena_.data() + i * kMaxDatagramSize;
+			size_t length = qMin<size_t>(headers[i].msg_len, kMaxDatagramSize);
+
+			if(length <= sizeof(quint64) + 1) {
+				qDebug("Discarding invalid datagram.");
+				continue;
+			}
+
+			const char* sender = buffer + sizeof(quint64) + 1;
+			const char* end = buffer + length;
+
+			const char* text = static_cast<const char*>(
+					std::memchr(sender, 0x01, end - sender));
+
+			if(!text) {
+				qDebug("Discarding invalid datagram.");
+				continue;
+			}
+
+			++text;
+			const char* textEnd = static_cast<const char*>(std::memchr(text, 0, end - text));
+			if(!textEnd)
+				textEnd = end;
+
+			LogMessage message;
+			std::memcpy(&message.time, buffer, sizeof(quint64));
+			message.level = static_cast<quint8>(buffer[sizeof(quint64)]);
+			message.sender = QString::fromUtf8(sender, text - 1 - sender);
+			message.text = QString::fromUtf8(text, textEnd - text);
+			messages.append(message);
+		}
+
+		if(count < kBatchSize)
+			break;
 	}
 
-	QString senderId;
-	senderId = QString::fromUtf8(sender, message - sender);
-	emit newMessage(*timeStamp, senderId, message + 1);
-	delete [] buffer;
+	if(!messages.isEmpty())
+		emit newMessages(messages);
 }
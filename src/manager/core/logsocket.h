@@ -1,13 +1,26 @@
 #ifndef CORE_LOGSOCKET_H
 #define CORE_LOGSOCKET_H
 
+#include <vector>
 #include <QSocketNotifier>
 #include <QString>
+#include <QVector>
+
+
+// The datagram layout: [u64 time][u8 level][sender id]\x01[text]\0
+struct LogMessage {
+	quint64 time;
+	int level;
+	QString sender;
+	QString text;
+};
 
 
 class LogSocket : public QObject {
 	Q_OBJECT
 public:
+	static const int kDefaultBufferSize = 1024 * 1024;
+
 	LogSocket(QObject* parent = nullptr);
 	~LogSocket();
 
@@ -15,16 +28,27 @@ public:
 	bool listen(const QString& id);
 	void close();
 
+	int receiveBufferSize() const;
+	void setReceiveBufferSize(int size);
+
 signals:
-	void newMessage(quint64 time, const QString& sender, const QString& text);
+	void newMessages(const QVector<LogMessage>& messages);
 
 private:
+	static const int kBatchSize = 64;
+	static const int kMaxBatchCount = 16;
+	static const int kMaxDatagramSize = 4096;
+
 	int fd_;
 	QSocketNotifier* notifier_;
 	QString id_;
+	int bufferSize_;
+	std::vector<char> arena_;
+
+	void applyBufferSize();
 
 private slots:
-	void handleDatagram();
+	void handleDatagrams();
 };
 
 
@@ -0,0 +1,608 @@
+#include "logstore.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include "common/config.h"
+
+
+namespace {
+
+
+const quint32 kMagic = 0x474C5741; // "AWLG"
+const quint32 kVersion = 1;
+
+
+size_t alignSize(size_t size)
+{
+	return (size + 7) & ~size_t(7);
+}
+
+
+QString segmentName(int number)
+{
+	return QString("%1.log").arg(number, 8, 10, QChar('0'));
+}
+
+
+} // namespace
+
+
+struct LogStore::Header {
+	quint32 magic;
+	quint32 version;
+	quint64 firstId;
+	quint64 used;
+	quint64 recordCount;
+	quint8 reserved[32];
+};
+
+
+// The record header is followed by the null-terminated sender id and text.
+struct LogStore::RecordHeader {
+	quint64 time;
+	quint8 level;
+	quint8 senderLength;
+	quint16 textLength;
+	quint32 size;
+
+	const char* sender() const
+	{
+		return reinterpret_cast<const char*>(this + 1);
+	}
+
+	const char* text() const
+	{
+		return sender() + senderLength + 1;
+	}
+};
+
+
+struct LogStore::Compiled {
+	QByteArray sender;
+	QByteArray text;
+	int maxLevel;
+	quint64 fromTime;
+	quint64 toTime;
+};
+
+
+LogFilter::LogFilter() :
+	maxLevel(-1),
+	fromId(0),
+	fromTime(0),
+	toTime(std::numeric_limits<quint64>::max())
+{
+}
+
+
+bool LogFilter::isEmpty() const
+{
+	return sender.isEmpty() && text.isEmpty() && maxLevel < 0 && fromId == 0 &&
+			fromTime == 0 && toTime == std::numeric_limits<quint64>::max();
+}
+
+
+LogStore::LogStore(QObject* parent) :
+	QObject(parent),
+	maxSegmentCount_(kDefaultSegmentCount),
+	sessionId_(0)
+{
+	static_assert(sizeof(Header) == 64, "Wrong log segment header size");
+	static_assert(sizeof(RecordHeader) == 16, "Wrong log record header size");
+}
+
+
+LogStore::~LogStore()
+{
+	close();
+}
+
+
+QString LogStore::defaultPath()
+{
+	QString path = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+	return path + "/" PROJECT_NAME "/logs";
+}
+
+
+bool LogStore::open(const QString& path, int maxSegmentCount)
+{
+	close();
+
+	QDir dir(path);
+	if(!dir.mkpath(".")) {
+		qDebug("Unable to create log store directory: %s", qPrintable(path));
+		return false;
+	}
+
+	path_ = dir.absolutePath();
+	maxSegmentCount_ = qMax(maxSegmentCount, 1);
+
+	QStringList fileNames = dir.entryList(QStringList() << "*.log", QDir::Files,
+			QDir::Name);
+
+	foreach(const QString& fileName, fileNames) {
+		bool isNumber;
+		int number = fileName.left(fileName.indexOf('.')).toInt(&isNumber);
+
+		if(!isNumber || !openSegment(number, false)) {
+			qDebug("Removing invalid log segment: %s", qPrintable(fileName));
+			dir.remove(fileName);
+		}
+	}
+
+	while(segments_.count() > maxSegmentCount_) {
+		closeSegment(&segments_.first());
+		dir.remove(segmentName(segments_.first().number));
+		segments_.removeFirst();
+	}
+
+	if(!segments_.isEmpty())
+		dropIndexes(segments_.first().firstId);
+
+	if(segments_.isEmpty() && !openSegment(0, true)) {
+		close();
+		return false;
+	}
+
+	sessionId_ = endId();
+	return true;
+}
+
+
+void LogStore::close()
+{
+	for(Segment& segment : segments_)
+		closeSegment(&segment);
+
+	segments_.clear();
+	senderNumbers_.clear();
+	senderNames_.clear();
+	senderIndex_.clear();
+
+	for(int i = 0; i < kLevelCount; ++i)
+		levelIndex_[i].clear();
+
+	path_.clear();
+	sessionId_ = 0;
+}
+
+
+bool LogStore::isOpen() const
+{
+	return !segments_.isEmpty();
+}
+
+
+QString LogStore::path() const
+{
+	return path_;
+}
+
+
+quint64 LogStore::firstId() const
+{
+	return segments_.isEmpty() ? 0 : segments_.first().firstId;
+}
+
+
+quint64 LogStore::endId() const
+{
+	if(segments_.isEmpty())
+		return 0;
+
+	const Segment& segment = segments_.last();
+	return segment.firstId + segment.offsets.count();
+}
+
+
+quint64 LogStore::sessionId() const
+{
+	return sessionId_;
+}
+
+
+QStringList LogStore::senders() const
+{
+	QStringList result = senderNames_;
+	result.sort();
+	return result;
+}
+
+
+bool LogStore::record(quint64 id, LogRecordInfo* info) const
+{
+	const RecordHeader* record = header(id);
+	if(!record)
+		return false;
+
+	info->time = record->time;
+	info->level = record->level;
+	info->sender = QString::fromUtf8(record->sender(), record->senderLength);
+	info->text = QString::fromUtf8(record->text(), record->textLength);
+	return true;
+}
+
+
+bool LogStore::matches(quint64 id, const LogFilter& filter) const
+{
+	Compiled compiled;
+	compiled.sender = filter.sender.toUtf8();
+	compiled.text = filter.text.toUtf8();
+	compiled.maxLevel = filter.maxLevel;
+	compiled.fromTime = filter.fromTime;
+	compiled.toTime = filter.toTime;
+
+	return matches(id, compiled);
+}
+
+
+QVector<quint64> LogStore::find(const LogFilter& filter, quint64 fromId) const
+{
+	QVector<quint64> result;
+	if(segments_.isEmpty())
+		return result;
+
+	Compiled compiled;
+	compiled.sender = filter.sender.toUtf8();
+	compiled.text = filter.text.toUtf8();
+	compiled.maxLevel = filter.maxLevel;
+	compiled.fromTime = filter.fromTime;
+	compiled.toTime = filter.toTime;
+
+	fromId = qMax(qMax(fromId, filter.fromId), firstId());
+	if(fromId >= endId())
+		return result;
+
+	// The most selective index is used to get the candidates, the rest of the conditions
+	// are checked against the record headers.
+	if(!filter.sender.isEmpty()) {
+		int number = senderNumbers_.value(filter.sender, -1);
+		if(number < 0)
+			return result;
+
+		const QVector<quint64>& index = senderIndex_.at(number);
+		auto it = std::lower_bound(index.constBegin(), index.constEnd(), fromId);
+
+		for(; it != index.constEnd(); ++it) {
+			if(matches(*it, compiled))
+				result.append(*it);
+		}
+
+		return result;
+	}
+
+	if(filter.maxLevel >= 0) {
+		QVector<quint64> candidates;
+		int levels = 0;
+
+		for(int level = 0; level <= filter.maxLevel && level < kLevelCount; ++level) {
+			const QVector<quint64>& index = levelIndex_[level];
+			auto it = std::lower_bound(index.constBegin(), index.constEnd(), fromId);
+
+			if(it != index.constEnd())
+				levels++;
+
+			for(; it != index.constEnd(); ++it)
+				candidates.append(*it);
+		}
+
+		// The level lists are merged only if they are short enough, otherwise it's faster
+		// to scan all of the records.
+		if(candidates.count() < static_cast<int>((endId() - fromId) / 4)) {
+			if(levels > 1)
+				std::sort(candidates.begin(), candidates.end());
+
+			for(quint64 id : candidates) {
+				if(matches(id, compiled))
+					result.append(id);
+			}
+
+			return result;
+		}
+	}
+
+	for(const Segment& segment : segments_) {
+		quint64 endId = segment.firstId + segment.offsets.count();
+		if(endId <= fromId)
+			continue;
+
+		int blockCount = segment.timeBlocks.count();
+		for(int block = 0; block < blockCount; ++block) {
+			const TimeBlock& times = segment.timeBlocks.at(block);
+			if(times.maxTime < compiled.fromTime || times.minTime > compiled.toTime)
+				continue;
+
+			quint64 id = segment.firstId + block * kTimeBlockSize;
+			quint64 blockEnd = qMin<quint64>(id + kTimeBlockSize, endId);
+
+			for(id = qMax(id, fromId); id < blockEnd; ++id) {
+				if(matches(id, compiled))
+					result.append(id);
+			}
+		}
+	}
+
+	return result;
+}
+
+
+void LogStore::append(const QVector<LogMessage>& messages)
+{
+	if(segments_.isEmpty() || messages.isEmpty())
+		return;
+
+	quint64 firstId = endId();
+
+	for(const LogMessage& message : messages) {
+		QByteArray sender = message.sender.toUtf8().left(255);
+		QByteArray text = message.text.toUtf8().left(65535);
+
+		size_t size = alignSize(sizeof(RecordHeader) + sender.size() + text.size() + 2);
+
+		Header* header = reinterpret_cast<Header*>(segments_.last().data);
+		if(header->used + size > static_cast<size_t>(kSegmentSize)) {
+			if(!rotate())
+				break;
+
+			header = reinterpret_cast<Header*>(segments_.last().data);
+		}
+
+		Segment* segment = &segments_.last();
+		char* data = segment->data + header->used;
+
+		RecordHeader* record = reinterpret_cast<RecordHeader*>(data);
+		record->time = message.time;
+		record->level = message.level;
+		record->senderLength = sender.size();
+		record->textLength = text.size();
+		record->size = size;
+
+		char* output = data + sizeof(RecordHeader);
+		std::memcpy(output, sender.constData(), sender.size() + 1);
+		output += sender.size() + 1;
+		std::memcpy(output, text.constData(), text.size() + 1);
+
+		// The record becomes visible for the reader only after it has been written.
+		quint32 offset = header->used;
+		__atomic_store_n(&header->used, header->used + size, __ATOMIC_RELEASE);
+		header->recordCount++;
+
+		indexRecord(segment, offset);
+	}
+
+	if(endId() != firstId)
+		emit appended(firstId, endId());
+}
+
+
+bool LogStore::openSegment(int number, bool create)
+{
+	QString fileName = path_ + '/' + segmentName(number);
+
+	int flags = O_RDWR | O_CLOEXEC;
+	if(create)
+		flags |= O_CREAT | O_TRUNC;
+
+	int fd = ::open(fileName.toUtf8().constData(), flags, 0644);
+	if(fd < 0) {
+		qDebug("Unable to open log segment %s: %s", qPrintable(fileName), strerror(errno));
+		return false;
+	}
+
+	struct stat info;
+	if(fstat(fd, &info) < 0) {
+		::close(fd);
+		return false;
+	}
+
+	// The segment is a sparse file of the fixed size, so the disk space is used only for
+	// the written records.
+	if(create && ftruncate(fd, kSegmentSize) < 0) {
+		qDebug("Unable to allocate log segment %s: %s", qPrintable(fileName),
+				strerror(errno));
+		::close(fd);
+		return false;
+	}
+	else if(!create && info.st_size != kSegmentSize) {
+		::close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, kSegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(data == MAP_FAILED) {
+		qDebug("Unable to map log segment %s: %s", qPrintable(fileName), strerror(errno));
+		::close(fd);
+		return false;
+	}
+
+	Segment segment;
+	segment.number = number;
+	segment.fd = fd;
+	segment.data = static_cast<char*>(data);
+
+	Header* header = reinterpret_cast<Header*>(data);
+
+	if(create) {
+		header->magic = kMagic;
+		header->version = kVersion;
+		header->firstId = endId();
+		header->used = sizeof(Header);
+		header->recordCount = 0;
+	}
+	else if(header->magic != kMagic || header->version != kVersion ||
+			header->firstId < endId() || header->used < sizeof(Header) ||
+			header->used > static_cast<quint64>(kSegmentSize)) {
+		closeSegment(&segment);
+		return false;
+	}
+
+	segment.firstId = header->firstId;
+	segments_.append(segment);
+
+	// Rebuild the indexes of the existing records. The tail of the segment, damaged by
+	// the crash, is cut off.
+	Segment* last = &segments_.last();
+	quint64 offset = sizeof(Header);
+
+	while(offset + sizeof(RecordHeader) <= header->used) {
+		const RecordHeader* record = reinterpret_cast<const RecordHeader*>(
+				last->data + offset);
+
+		size_t size = alignSize(sizeof(RecordHeader) + record->senderLength +
+				record->textLength + 2);
+
+		if(record->size != size || offset + size > header->used)
+			break;
+
+		indexRecord(last, offset);
+		offset += size;
+	}
+
+	header->used = offset;
+	header->recordCount = last->offsets.count();
+	return true;
+}
+
+
+void LogStore::closeSegment(Segment* segment)
+{
+	if(segment->data) {
+		munmap(segment->data, kSegmentSize);
+		segment->data = nullptr;
+	}
+
+	if(segment->fd >= 0) {
+		::close(segment->fd);
+		segment->fd = -1;
+	}
+}
+
+
+bool LogStore::rotate()
+{
+	if(!openSegment(segments_.last().number + 1, true))
+		return false;
+
+	if(segments_.count() > maxSegmentCount_) {
+		closeSegment(&segments_.first());
+		QFile::remove(path_ + '/' + segmentName(segments_.first().number));
+		segments_.removeFirst();
+		dropIndexes(segments_.first().firstId);
+	}
+
+	return true;
+}
+
+
+void LogStore::indexRecord(Segment* segment, quint32 offset)
+{
+	const RecordHeader* record = reinterpret_cast<const RecordHeader*>(
+			segment->data + offset);
+
+	quint64 id = segment->firstId + segment->offsets.count();
+
+	if(segment->offsets.count() % kTimeBlockSize == 0) {
+		TimeBlock block;
+		block.minTime = record->time;
+		block.maxTime = record->time;
+		segment->timeBlocks.append(block);
+	}
+	else {
+		TimeBlock& block = segment->timeBlocks.last();
+		block.minTime = qMin(block.minTime, record->time);
+		block.maxTime = qMax(block.maxTime, record->time);
+	}
+
+	segment->offsets.append(offset);
+
+	QString sender = QString::fromUtf8(record->sender(), record->senderLength);
+	int number = senderNumbers_.value(sender, -1);
+
+	if(number < 0) {
+		number = senderNames_.count();
+		senderNumbers_.insert(sender, number);
+		senderNames_.append(sender);
+		senderIndex_.append(QVector<quint64>());
+	}
+
+	senderIndex_[number].append(id);
+
+	if(record->level < kLevelCount)
+		levelIndex_[record->level].append(id);
+}
+
+
+void LogStore::dropIndexes(quint64 firstId)
+{
+	for(int i = -kLevelCount; i < senderIndex_.count(); ++i) {
+		QVector<quint64>& index = i < 0 ? levelIndex_[i + kLevelCount] : senderIndex_[i];
+
+		auto it = std::lower_bound(index.begin(), index.end(), firstId);
+		index.remove(0, it - index.begin());
+	}
+}
+
+
+const LogStore::Segment* LogStore::segmentOf(quint64 id) const
+{
+	auto it = std::upper_bound(segments_.constBegin(), segments_.constEnd(), id,
+			[](quint64 value, const Segment& segment) {
+				return value < segment.firstId;
+			});
+
+	if(it == segments_.constBegin())
+		return nullptr;
+
+	--it;
+	if(id - it->firstId >= static_cast<quint64>(it->offsets.count()))
+		return nullptr;
+
+	return &*it;
+}
+
+
+const LogStore::RecordHeader* LogStore::header(quint64 id) const
+{
+	const Segment* segment = segmentOf(id);
+	if(!segment)
+		return nullptr;
+
+	quint32 offset = segment->offsets.at(id - segment->firstId);
+	return reinterpret_cast<const RecordHeader*>(segment->data + offset);
+}
+
+
+bool LogStore::matches(quint64 id, const Compiled& compiled) const
+{
+	const RecordHeader* record = header(id);
+	if(!record)
+		return false;
+
+	if(compiled.maxLevel >= 0 && record->level > compiled.maxLevel)
+		return false;
+
+	if(record->time < compiled.fromTime || record->time > compiled.toTime)
+		return false;
+
+	if(!compiled.sender.isEmpty() && (record->senderLength != compiled.sender.size() ||
+			std::memcmp(record->sender(), compiled.sender.constData(),
+			record->senderLength) != 0)) {
+		return false;
+	}
+
+	// The text is null-terminated, so the search is done directly in the mapped memory.
+	if(!compiled.text.isEmpty() && !strcasestr(record->text(), compiled.text.constData()))
+		return false;
+
+	return true;
+}
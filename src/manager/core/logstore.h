@@ -0,0 +1,120 @@
+#ifndef CORE_LOGSTORE_H
+#define CORE_LOGSTORE_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "core/logsocket.h"
+
+
+struct LogFilter {
+	QString sender;
+	QString text;
+	int maxLevel;
+	quint64 fromId;
+	quint64 fromTime;
+	quint64 toTime;
+
+	LogFilter();
+
+	bool isEmpty() const;
+};
+
+
+struct LogRecordInfo {
+	quint64 time;
+	int level;
+	QString sender;
+	QString text;
+};
+
+
+// Persistent storage of the received log messages. The messages are appended to the
+// memory-mapped segment files of the fixed size, the oldest segments are removed when
+// the limit is reached. The in-memory indexes by sender, level and time are built when
+// the store is opened and updated on every append, so the filtering doesn't need to
+// touch the records, that can't match.
+class LogStore : public QObject {
+	Q_OBJECT
+public:
+	static const int kSegmentSize = 32 * 1024 * 1024;
+	static const int kDefaultSegmentCount = 8;
+	static const int kLevelCount = 5;
+
+	LogStore(QObject* parent = nullptr);
+	~LogStore();
+
+	static QString defaultPath();
+
+	bool open(const QString& path, int maxSegmentCount = kDefaultSegmentCount);
+	void close();
+	bool isOpen() const;
+
+	QString path() const;
+
+	quint64 firstId() const;
+	quint64 endId() const;
+	quint64 sessionId() const;
+
+	QStringList senders() const;
+
+	bool record(quint64 id, LogRecordInfo* info) const;
+	bool matches(quint64 id, const LogFilter& filter) const;
+
+	QVector<quint64> find(const LogFilter& filter, quint64 fromId = 0) const;
+
+public slots:
+	void append(const QVector<LogMessage>& messages);
+
+signals:
+	void appended(quint64 firstId, quint64 endId);
+
+private:
+	struct Header;
+	struct RecordHeader;
+
+	struct TimeBlock {
+		quint64 minTime;
+		quint64 maxTime;
+	};
+
+	struct Segment {
+		int number;
+		int fd;
+		char* data;
+		quint64 firstId;
+		QVector<quint32> offsets;
+		QVector<TimeBlock> timeBlocks;
+	};
+
+	struct Compiled;
+
+	static const int kTimeBlockSize = 1024;
+
+	QString path_;
+	int maxSegmentCount_;
+	QList<Segment> segments_;
+	quint64 sessionId_;
+
+	QHash<QString, int> senderNumbers_;
+	QStringList senderNames_;
+	QVector<QVector<quint64>> senderIndex_;
+	QVector<quint64> levelIndex_[kLevelCount];
+
+	bool openSegment(int number, bool create);
+	void closeSegment(Segment* segment);
+	bool rotate();
+	void indexRecord(Segment* segment, quint32 offset);
+	void dropIndexes(quint64 firstId);
+
+	const Segment* segmentOf(quint64 id) const;
+	const RecordHeader* header(quint64 id) const;
+
+	bool matches(quint64 id, const Compiled& compiled) const;
+};
+
+
+#endif // CORE_LOGSTORE_H
@@ -0,0 +1,304 @@
+#include "pluginscanner.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSocketNotifier>
+#include <QThread>
+
+
+namespace {
+
+
+const uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+		IN_CLOSE_WRITE | IN_DELETE_SELF | IN_ONLYDIR;
+
+
+} // namespace
+
+
+class PluginScanner::Task : public QRunnable {
+public:
+	Task(PluginScanner* scanner, const QString& path) :
+		scanner_(scanner),
+		path_(path)
+	{
+	}
+
+	void run()
+	{
+		Result result;
+		result.path = path_;
+		result.exists = QFileInfo(path_).isDir();
+
+		// The watch is added before the directory is listed, so the changes made during
+		// the listing will not be lost.
+		QByteArray path = QFile::encodeName(path_);
+		result.directory.watch = result.exists ?
+				inotify_add_watch(scanner_->inotifyFd_, path.constData(), kWatchMask) : -1;
+
+		QDir dir(path_);
+		QFileInfoList entries = dir.entryInfoList(QDir::Dirs | QDir::Files |
+				QDir::Hidden | QDir::NoDotAndDotDot, QDir::NoSort);
+
+		int prefixLength = scanner_->prefixPath_.length() + 1;
+
+		foreach(const QFileInfo& info, entries) {
+			// The symbolic links in drive_c point to the home directory of the user.
+			if(info.isSymLink())
+				continue;
+
+			if(info.isDir()) {
+				result.directory.subdirs += info.absoluteFilePath();
+			}
+			else if(info.suffix().compare("dll", Qt::CaseInsensitive) == 0) {
+				QString filePath = info.absoluteFilePath();
+				ModuleInfo::Info module = ModuleInfo::instance()->getInfo(
+						QFile::encodeName(filePath).toStdString());
+
+				if(module.arch != ModuleInfo::kArchUnknown && module.isDll &&
+						module.hasVstEntry) {
+					PluginInfo plugin;
+					plugin.path = filePath.mid(prefixLength);
+					plugin.arch = module.arch;
+					result.directory.plugins += plugin;
+				}
+			}
+		}
+
+		scanner_->postResult(result);
+	}
+
+private:
+	PluginScanner* scanner_;
+	QString path_;
+};
+
+
+PluginScanner::PluginScanner(const QString& prefixPath, QObject* parent) :
+	QObject(parent),
+	prefixPath_(QDir(prefixPath).absolutePath()),
+	rootPath_(prefixPath_ + "/drive_c"),
+	pendingCount_(0),
+	notifier_(nullptr)
+{
+	// The scanning is bound by the file system latency rather than by the CPU.
+	pool_.setMaxThreadCount(qMax(QThread::idealThreadCount(), 4));
+
+	inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(inotifyFd_ < 0) {
+		qDebug("Unable to initialize inotify: %s", strerror(errno));
+	}
+	else {
+		notifier_ = new QSocketNotifier(inotifyFd_, QSocketNotifier::Read, this);
+		connect(notifier_, SIGNAL(activated(int)), SLOT(handleEvents()));
+	}
+}
+
+
+PluginScanner::~PluginScanner()
+{
+	pool_.clear();
+	pool_.waitForDone();
+
+	delete notifier_;
+
+	if(inotifyFd_ >= 0)
+		close(inotifyFd_);
+}
+
+
+QString PluginScanner::prefixPath() const
+{
+	return prefixPath_;
+}
+
+
+bool PluginScanner::isScanning() const
+{
+	return pendingCount_ > 0;
+}
+
+
+QList<PluginInfo> PluginScanner::plugins() const
+{
+	QList<PluginInfo> result;
+
+	foreach(const Directory& directory, directories_)
+		result += directory.plugins;
+
+	std::sort(result.begin(), result.end(), [](const PluginInfo& a, const PluginInfo& b) {
+		return a.path < b.path;
+	});
+
+	return result;
+}
+
+
+void PluginScanner::scan()
+{
+	if(isScanning())
+		return;
+
+	if(directories_.isEmpty()) {
+		if(QFileInfo(rootPath_).isDir())
+			scanDirectory(rootPath_);
+	}
+	else {
+		// Only the changed directories and the ones, that can't be watched, are listed.
+		QSet<QString> paths = dirtyPaths_;
+		dirtyPaths_.clear();
+
+		for(auto it = directories_.constBegin(); it != directories_.constEnd(); ++it) {
+			if(it.value().watch < 0)
+				paths.insert(it.key());
+		}
+
+		foreach(const QString& path, paths) {
+			if(directories_.contains(path))
+				scanDirectory(path);
+		}
+	}
+
+	if(!isScanning())
+		emit finished();
+}
+
+
+void PluginScanner::scanDirectory(const QString& path)
+{
+	// Wine's own DLLs are never VST plugins.
+	if(path == rootPath_ + "/windows")
+		return;
+
+	pendingCount_++;
+	pool_.start(new Task(this, path));
+}
+
+
+void PluginScanner::removeDirectory(const QString& path)
+{
+	auto it = directories_.find(path);
+	if(it == directories_.end())
+		return;
+
+	Directory directory = it.value();
+	directories_.erase(it);
+	dirtyPaths_.remove(path);
+
+	if(directory.watch >= 0 && pathByWatch_.value(directory.watch) == path) {
+		inotify_rm_watch(inotifyFd_, directory.watch);
+		pathByWatch_.remove(directory.watch);
+	}
+
+	foreach(const QString& subdir, directory.subdirs)
+		removeDirectory(subdir);
+}
+
+
+void PluginScanner::postResult(const Result& result)
+{
+	QMutexLocker locker(&mutex_);
+
+	if(results_.isEmpty())
+		QMetaObject::invokeMethod(this, "processResults", Qt::QueuedConnection);
+
+	results_.append(result);
+}
+
+
+void PluginScanner::processResults()
+{
+	QVector<Result> results;
+	{
+		QMutexLocker locker(&mutex_);
+		results.swap(results_);
+	}
+
+	foreach(const Result& result, results) {
+		pendingCount_--;
+
+		if(!result.exists) {
+			removeDirectory(result.path);
+			continue;
+		}
+
+		Directory directory = result.directory;
+		Directory previous = directories_.value(result.path);
+
+		foreach(const QString& subdir, previous.subdirs) {
+			if(!directory.subdirs.contains(subdir))
+				removeDirectory(subdir);
+		}
+
+		foreach(const QString& subdir, directory.subdirs) {
+			if(!directories_.contains(subdir))
+				scanDirectory(subdir);
+		}
+
+		if(directory.watch >= 0) {
+			pathByWatch_.insert(directory.watch, result.path);
+
+			// The events could arrive before the watch was registered.
+			if(unknownWatches_.remove(directory.watch))
+				dirtyPaths_.insert(result.path);
+		}
+
+		directories_.insert(result.path, directory);
+	}
+
+	if(!isScanning())
+		emit finished();
+}
+
+
+void PluginScanner::handleEvents()
+{
+	alignas(inotify_event) char buffer[16384];
+
+	for(;;) {
+		ssize_t length = read(inotifyFd_, buffer, sizeof(buffer));
+		if(length <= 0)
+			break;
+
+		for(char* ptr = buffer; ptr < buffer + length; ) {
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+			ptr += sizeof(inotify_event) + event->len;
+
+			// Some events were lost, so nothing in the index can be trusted.
+			if(event->mask & IN_Q_OVERFLOW) {
+				for(auto it = directories_.constBegin(); it != directories_.constEnd(); ++it)
+					dirtyPaths_.insert(it.key());
+
+				continue;
+			}
+
+			QString path = pathByWatch_.value(event->wd);
+			if(path.isEmpty()) {
+				unknownWatches_.insert(event->wd);
+				continue;
+			}
+
+			// The directory is removed, it will be dropped from the index on the next
+			// scan of its parent.
+			if(event->mask & IN_IGNORED) {
+				pathByWatch_.remove(event->wd);
+
+				auto it = directories_.find(path);
+				if(it != directories_.end())
+					it.value().watch = -1;
+
+				continue;
+			}
+
+			dirtyPaths_.insert(path);
+		}
+	}
+}
@@ -0,0 +1,85 @@
+#ifndef CORE_PLUGINSCANNER_H
+#define CORE_PLUGINSCANNER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include "common/moduleinfo.h"
+
+
+class QSocketNotifier;
+
+
+struct PluginInfo {
+	QString path;               // Relative to the WINE prefix
+	ModuleInfo::Arch arch;
+};
+
+
+// Finds the VST plugins in the drive_c directory of the WINE prefix. Every directory is
+// listed by a separate task of the thread pool, and the found DLLs are checked by their
+// PE headers. The result is kept as the index of directories, which is updated by
+// inotify events, so the next scan lists only the changed directories.
+class PluginScanner : public QObject {
+	Q_OBJECT
+public:
+	PluginScanner(const QString& prefixPath, QObject* parent = nullptr);
+	~PluginScanner();
+
+	QString prefixPath() const;
+	bool isScanning() const;
+
+	QList<PluginInfo> plugins() const;
+
+public slots:
+	void scan();
+
+signals:
+	void finished();
+
+private:
+	struct Directory {
+		QStringList subdirs;
+		QList<PluginInfo> plugins;
+		int watch;
+	};
+
+	struct Result {
+		QString path;
+		bool exists;
+		Directory directory;
+	};
+
+	class Task;
+
+	QString prefixPath_;
+	QString rootPath_;
+	QThreadPool pool_;
+	int pendingCount_;
+
+	QHash<QString, Directory> directories_;
+	QSet<QString> dirtyPaths_;
+
+	QMutex mutex_;
+	QVector<Result> results_;
+
+	int inotifyFd_;
+	QSocketNotifier* notifier_;
+	QHash<int, QString> pathByWatch_;
+	QSet<int> unknownWatches_;
+
+	void scanDirectory(const QString& path);
+	void removeDirectory(const QString& path);
+	void postResult(const Result& result);
+
+private slots:
+	void processResults();
+	void handleEvents();
+};
+
+
+#endif // CORE_PLUGINSCANNER_H
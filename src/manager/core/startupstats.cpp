@@ -0,0 +1,277 @@
+#include "startupstats.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include "common/config.h"
+
+
+namespace {
+
+
+const char kRecordPrefix[] = "Startup profile: ";
+
+
+QString formatDuration(double usecs)
+{
+	if(usecs >= 1000000.0)
+		return QString("%1 s").arg(usecs / 1000000.0, 0, 'f', 2);
+
+	return QString("%1 ms").arg(usecs / 1000.0, 0, 'f', 1);
+}
+
+
+// The phases are stored by name, so the phases, added later, don't shift the values.
+QJsonObject toJson(const QVector<quint64>& values)
+{
+	QStringList names = StartupStats::phaseNames();
+
+	QJsonObject object;
+	for(int i = 0; i < names.count(); ++i)
+		object[names[i]] = double(values[i]);
+
+	return object;
+}
+
+
+QVector<quint64> fromJson(const QJsonObject& object)
+{
+	QStringList names = StartupStats::phaseNames();
+
+	QVector<quint64> values(names.count(), 0);
+	for(int i = 0; i < names.count(); ++i)
+		values[i] = quint64(object[names[i]].toDouble());
+
+	return values;
+}
+
+
+} // namespace
+
+
+StartupStats::Entry::Entry() :
+	count(0),
+	adoptedCount(0),
+	lastTime(0),
+	maxTotal(0),
+	last(phaseNames().count(), 0),
+	sum(phaseNames().count(), 0)
+{
+}
+
+
+StartupStats::StartupStats(QObject* parent) :
+	QObject(parent),
+	isChanged_(false)
+{
+	load();
+}
+
+
+StartupStats::~StartupStats()
+{
+	save();
+}
+
+
+QString StartupStats::defaultPath()
+{
+	QString path = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+	return path + "/" PROJECT_NAME "/startup.json";
+}
+
+
+QStringList StartupStats::phaseNames()
+{
+	// The names are the keys of the record, written by the plugin endpoint.
+	static const QStringList names = QStringList() << "total" << "config" << "arch" <<
+			"queue" << "spawn" << "boot" << "load" << "connect" << "main" << "open" <<
+			"block";
+
+	return names;
+}
+
+
+bool StartupStats::contains(const QString& sender) const
+{
+	return entries_.contains(sender);
+}
+
+
+StartupStats::Entry StartupStats::entry(const QString& sender) const
+{
+	return entries_.value(sender);
+}
+
+
+QString StartupStats::summary(const QString& sender) const
+{
+	auto it = entries_.constFind(sender);
+	if(it == entries_.constEnd())
+		return QString();
+
+	const Entry& entry = it.value();
+	QStringList names = phaseNames();
+
+	QString result = QString("Instantiated %1 times, %2 of them by a parked host, "
+			"slowest %3\n").arg(entry.count).arg(entry.adoptedCount)
+			.arg(formatDuration(entry.maxTotal));
+
+	result += "Phase: average / last";
+
+	for(int i = 0; i < names.count(); ++i) {
+		result += QString("\n%1: %2 / %3").arg(names[i])
+				.arg(formatDuration(double(entry.sum[i]) / entry.count))
+				.arg(formatDuration(entry.last[i]));
+	}
+
+	return result;
+}
+
+
+void StartupStats::clear(const QString& sender)
+{
+	if(entries_.remove(sender)) {
+		isChanged_ = true;
+		emit changed(sender);
+	}
+}
+
+
+void StartupStats::addMessages(const QVector<LogMessage>& messages)
+{
+	QStringList senders;
+
+	foreach(const LogMessage& message, messages) {
+		QVector<quint64> values;
+		bool isAdopted;
+
+		if(!parse(message.text, &values, &isAdopted))
+			continue;
+
+		Entry& entry = entries_[message.sender];
+		entry.count++;
+		entry.lastTime = message.time;
+		entry.maxTotal = qMax(entry.maxTotal, values[0]);
+		entry.last = values;
+
+		if(isAdopted)
+			entry.adoptedCount++;
+
+		for(int i = 0; i < values.count(); ++i)
+			entry.sum[i] += values[i];
+
+		if(!senders.contains(message.sender))
+			senders += message.sender;
+	}
+
+	if(senders.isEmpty())
+		return;
+
+	isChanged_ = true;
+
+	foreach(const QString& sender, senders)
+		emit changed(sender);
+}
+
+
+bool StartupStats::parse(const QString& text, QVector<quint64>* values,
+		bool* isAdopted) const
+{
+	if(!text.startsWith(kRecordPrefix))
+		return false;
+
+	QStringList names = phaseNames();
+	values->fill(0, names.count());
+	*isAdopted = false;
+
+	QStringList pairs = text.mid(sizeof(kRecordPrefix) - 1).split(' ',
+			QString::SkipEmptyParts);
+
+	foreach(const QString& pair, pairs) {
+		int pos = pair.indexOf('=');
+		if(pos == -1)
+			return false;
+
+		bool isOk;
+		quint64 value = pair.mid(pos + 1).toULongLong(&isOk);
+		if(!isOk)
+			return false;
+
+		QString key = pair.left(pos);
+		if(key == "adopted") {
+			*isAdopted = value != 0;
+			continue;
+		}
+
+		// The unknown phases of the other versions are ignored.
+		int index = names.indexOf(key);
+		if(index != -1)
+			(*values)[index] = value;
+	}
+
+	return true;
+}
+
+
+void StartupStats::load()
+{
+	QFile file(defaultPath());
+	if(!file.open(QIODevice::ReadOnly))
+		return;
+
+	QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+
+	for(auto it = root.constBegin(); it != root.constEnd(); ++it) {
+		QJsonObject object = it.value().toObject();
+
+		Entry entry;
+		entry.count = object["count"].toInt();
+		entry.adoptedCount = object["adopted"].toInt();
+		entry.lastTime = quint64(object["last_time"].toDouble());
+		entry.maxTotal = quint64(object["max_total"].toDouble());
+		entry.last = fromJson(object["last"].toObject());
+		entry.sum = fromJson(object["sum"].toObject());
+
+		if(entry.count > 0)
+			entries_.insert(it.key(), entry);
+	}
+}
+
+
+void StartupStats::save()
+{
+	if(!isChanged_)
+		return;
+
+	QJsonObject root;
+
+	for(auto it = entries_.constBegin(); it != entries_.constEnd(); ++it) {
+		const Entry& entry = it.value();
+
+		QJsonObject object;
+		object["count"] = entry.count;
+		object["adopted"] = entry.adoptedCount;
+		object["last_time"] = double(entry.lastTime);
+		object["max_total"] = double(entry.maxTotal);
+		object["last"] = toJson(entry.last);
+		object["sum"] = toJson(entry.sum);
+
+		root[it.key()] = object;
+	}
+
+	QString path = defaultPath();
+	QDir().mkpath(QFileInfo(path).absolutePath());
+
+	QFile file(path);
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qDebug("Unable to save the startup statistics.");
+		return;
+	}
+
+	file.write(QJsonDocument(root).toJson());
+	isChanged_ = false;
+}
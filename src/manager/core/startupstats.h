@@ -0,0 +1,62 @@
+#ifndef CORE_STARTUPSTATS_H
+#define CORE_STARTUPSTATS_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "core/logsocket.h"
+
+
+// Aggregates the startup profiles, written to the log by the plugin endpoints, per link.
+// The link is identified by the sender id of the record, which is the file name of the
+// link. The statistics are kept between sessions.
+class StartupStats : public QObject {
+	Q_OBJECT
+public:
+	struct Entry {
+		int count;
+		int adoptedCount;
+		quint64 lastTime;
+		quint64 maxTotal;
+
+		// Durations in microseconds, in the order of phaseNames().
+		QVector<quint64> last;
+		QVector<quint64> sum;
+
+		Entry();
+	};
+
+	StartupStats(QObject* parent = nullptr);
+	~StartupStats();
+
+	static QString defaultPath();
+
+	// The first phase is the total duration of the instantiation.
+	static QStringList phaseNames();
+
+	bool contains(const QString& sender) const;
+	Entry entry(const QString& sender) const;
+	QString summary(const QString& sender) const;
+
+	void clear(const QString& sender);
+
+public slots:
+	void addMessages(const QVector<LogMessage>& messages);
+
+signals:
+	void changed(const QString& sender);
+
+private:
+	QHash<QString, Entry> entries_;
+	bool isChanged_;
+
+	bool parse(const QString& text, QVector<quint64>* values, bool* isAdopted) const;
+
+	void load();
+	void save();
+};
+
+
+#endif // CORE_STARTUPSTATS_H
@@ -0,0 +1,230 @@
+#include "wineserverkeeper.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QSettings>
+#include "common/statsregistry.h"
+#include "common/storage.h"
+#include "core/application.h"
+
+
+using Airwave::StatsRegistry;
+
+
+WineServerKeeper::WineServerKeeper(QObject* parent) :
+	QObject(parent),
+	residency_(kDefaultResidency)
+{
+	QSettings settings;
+	residency_ = settings.value("wineServerResidency", kDefaultResidency).toInt();
+
+	clock_.start();
+
+	connect(&timer_, SIGNAL(timeout()), SLOT(refresh()));
+	timer_.start(kRefreshInterval);
+
+	refresh();
+}
+
+
+int WineServerKeeper::residency() const
+{
+	return residency_;
+}
+
+
+void WineServerKeeper::setResidency(int seconds)
+{
+	if(residency_ == seconds)
+		return;
+
+	residency_ = seconds;
+
+	QSettings settings;
+	settings.setValue("wineServerResidency", seconds);
+
+	refresh();
+}
+
+
+bool WineServerKeeper::isRunning(const QString& prefixPath) const
+{
+	return states_.value(prefixPath).isRunning;
+}
+
+
+bool WineServerKeeper::probe(const QString& prefixPath)
+{
+	// The wineserver holds the lock in the server directory, which is named after the
+	// device and the inode of the prefix directory.
+	struct stat st;
+	if(stat(QFile::encodeName(prefixPath).constData(), &st) != 0)
+		return false;
+
+	QString path = QString("/tmp/.wine-%1/server-%2-%3/lock").arg(getuid())
+			.arg(qulonglong(st.st_dev), 0, 16).arg(qulonglong(st.st_ino), 0, 16);
+
+	int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return false;
+
+	struct flock lock;
+	lock.l_type = F_WRLCK;
+	lock.l_whence = SEEK_SET;
+	lock.l_start = 0;
+	lock.l_len = 1;
+	lock.l_pid = 0;
+
+	bool isLocked = fcntl(fd, F_GETLK, &lock) == 0 && lock.l_type != F_UNLCK;
+	close(fd);
+	return isLocked;
+}
+
+
+void WineServerKeeper::refresh()
+{
+	Airwave::Storage* storage = qApp->storage();
+	qint64 now = clock_.elapsed() / 1000;
+
+	// The loader of the first link is used to find the wineserver of the prefix. The
+	// sender id is only the file name of the link, so the links with the same name in
+	// the different directories mark all their prefixes as used.
+	QHash<QString, QString> loaderByPrefix;
+	QMultiHash<QString, QString> prefixesBySender;
+
+	auto link = storage->link();
+	while(!link.isNull()) {
+		QString prefixPath = QString::fromStdString(storage->prefix(link.prefix()).path());
+		QString loaderPath = QString::fromStdString(storage->loader(link.loader()).path());
+
+		if(!prefixPath.isEmpty()) {
+			if(!loaderByPrefix.contains(prefixPath))
+				loaderByPrefix.insert(prefixPath, loaderPath);
+
+			QString sender = QFileInfo(QString::fromStdString(link.path())).fileName();
+			prefixesBySender.insert(sender, prefixPath);
+		}
+
+		link = link.next();
+	}
+
+	// The prefixes of the running plugins are in use.
+	QSet<QString> usedPrefixes;
+
+	StatsRegistry* registry = StatsRegistry::instance();
+	if(registry->open()) {
+		for(int i = 0; i < StatsRegistry::kSlotCount; ++i) {
+			const Airwave::InstanceStats* slot = registry->slot(i);
+			if(!StatsRegistry::isAlive(slot))
+				continue;
+
+			QString name = QString::fromUtf8(slot->name,
+					qstrnlen(slot->name, sizeof(slot->name)));
+
+			foreach(const QString& prefixPath, prefixesBySender.values(name))
+				usedPrefixes.insert(prefixPath);
+		}
+	}
+
+	QSet<QString> prefixes;
+
+	auto prefix = storage->prefix();
+	while(!prefix.isNull()) {
+		prefixes.insert(QString::fromStdString(prefix.path()));
+		prefix = prefix.next();
+	}
+
+	foreach(const QString& path, states_.keys()) {
+		if(!prefixes.contains(path))
+			states_.remove(path);
+	}
+
+	foreach(const QString& path, prefixes) {
+		auto it = states_.find(path);
+		if(it == states_.end()) {
+			PrefixState state;
+			state.isRunning = false;
+			state.lastUse = now;
+			state.lastStart = now - kRetryInterval;
+			it = states_.insert(path, state);
+		}
+
+		PrefixState& state = it.value();
+		if(usedPrefixes.contains(path))
+			state.lastUse = now;
+
+		bool isRunning = probe(path);
+
+		// The prefixes without links are only watched.
+		if(!isRunning && residency_ > 0 && loaderByPrefix.contains(path) &&
+				now - state.lastUse < residency_ &&
+				now - state.lastStart >= kRetryInterval) {
+			state.lastStart = now;
+			start(path, loaderByPrefix.value(path));
+		}
+
+		if(state.isRunning != isRunning) {
+			state.isRunning = isRunning;
+			emit stateChanged(path);
+		}
+	}
+}
+
+
+void WineServerKeeper::start(const QString& prefixPath, const QString& loaderPath)
+{
+	// The wineserver should be of the same WINE build as the loader.
+	QString program = "wineserver";
+	QFileInfo info(QFileInfo(loaderPath).absolutePath(), "wineserver");
+	if(!loaderPath.isEmpty() && info.isExecutable())
+		program = info.absoluteFilePath();
+
+	QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+	environment.insert("WINEPREFIX", prefixPath);
+
+	// The wineserver detaches itself, the launcher process exits immediately. The
+	// process is started asynchronously, so the GUI thread never waits for it.
+	QProcess* process = new QProcess(this);
+	process->setProcessEnvironment(environment);
+	process->setProcessChannelMode(QProcess::ForwardedChannels);
+	process->setProperty("prefixPath", prefixPath);
+
+	connect(process, SIGNAL(started()), SLOT(onStarted()));
+
+	connect(process,
+			SIGNAL(error(QProcess::ProcessError)),
+			SLOT(onStartError(QProcess::ProcessError)));
+
+	connect(process,
+			SIGNAL(finished(int,QProcess::ExitStatus)),
+			process,
+			SLOT(deleteLater()));
+
+	connect(process,
+			SIGNAL(error(QProcess::ProcessError)),
+			process,
+			SLOT(deleteLater()));
+
+	process->start(program, QStringList() << QString("-p%1").arg(residency_));
+}
+
+
+void WineServerKeeper::onStarted()
+{
+	// The state of the prefix is updated as soon as the wineserver takes its lock.
+	QTimer::singleShot(kStartedRefreshDelay, this, SLOT(refresh()));
+}
+
+
+void WineServerKeeper::onStartError(QProcess::ProcessError error)
+{
+	if(error != QProcess::FailedToStart)
+		return;
+
+	QString prefixPath = sender()->property("prefixPath").toString();
+	qDebug("Unable to start wineserver for the prefix '%s'.", qPrintable(prefixPath));
+}
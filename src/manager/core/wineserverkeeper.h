@@ -0,0 +1,63 @@
+#ifndef CORE_WINESERVERKEEPER_H
+#define CORE_WINESERVERKEEPER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QProcess>
+#include <QString>
+#include <QTimer>
+
+
+// Keeps the wineserver of every WINE prefix with links running for the residency time
+// after the prefix was used the last time, so the host endpoint doesn't pay for the
+// wineserver startup and the registry load. The wineserver is started in the persistent
+// mode (wineserver -p), so it stays alive without the manager. The prefixes are warmed
+// up when the manager is started and when their first link is created.
+class WineServerKeeper : public QObject {
+	Q_OBJECT
+public:
+	static const int kDefaultResidency = 600;
+
+	WineServerKeeper(QObject* parent = nullptr);
+
+	// Seconds, zero disables the warm-up.
+	int residency() const;
+	void setResidency(int seconds);
+
+	// Returns the state of the wineserver, checked by the last refresh.
+	bool isRunning(const QString& prefixPath) const;
+
+	static bool probe(const QString& prefixPath);
+
+public slots:
+	void refresh();
+
+signals:
+	void stateChanged(const QString& prefixPath);
+
+private:
+	struct PrefixState {
+		bool isRunning;
+		qint64 lastUse;
+		qint64 lastStart;
+	};
+
+	static const int kRefreshInterval = 2000;
+	static const int kStartedRefreshDelay = 500;
+	static const int kRetryInterval = 30;
+
+	QTimer timer_;
+	QElapsedTimer clock_;
+	int residency_;
+	QHash<QString, PrefixState> states_;
+
+	void start(const QString& prefixPath, const QString& loaderPath);
+
+private slots:
+	void onStarted();
+	void onStartError(QProcess::ProcessError error);
+};
+
+
+#endif // CORE_WINESERVERKEEPER_H
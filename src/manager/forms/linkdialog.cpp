@@ -1,5 +1,6 @@
 #include "linkdialog.h"
 
+#include <QCheckBox>
 #include <QComboBox>
 #include <QDialogButtonBox>
 #include <QFile>
@@ -7,6 +8,7 @@
 #include <QLabel>
 #include <QMessageBox>
 #include <QSettings>
+#include <QSpinBox>
 #include "common/config.h"
 #include "core/application.h"
 #include "forms/filedialog.h"
@@ -46,6 +48,9 @@ void LinkDialog::setItem(LinkItem* item)
 		index = static_cast<int>(item->logLevel()) + 1;
 		logLevelCombo_->setCurrentIndex(index);
 
+		editorRateSpin_->setValue(item->editorRate());
+		setOptions(item->options());
+
 		nameEdit_->setText(item->name());
 		targetEdit_->setText(item->target());
 	}
@@ -59,6 +64,9 @@ void LinkDialog::setItem(LinkItem* item)
 
 		index = loaderCombo_->findText("default");
 		loaderCombo_->setCurrentIndex(index);
+
+		editorRateSpin_->setValue(Storage::kDefaultEditorRate);
+		setOptions(0);
 	}
 }
 
@@ -69,7 +77,7 @@ void LinkDialog::setupUi()
 	setWindowTitle("Link properties");
 	setMinimumWidth(500);
 	resize(600, 180);
-	setMinimumHeight(260);
+	setMinimumHeight(320);
 
 	loaderCombo_ = new QComboBox;
 	loaderCombo_->setModel(qApp->loaders());
@@ -88,6 +96,35 @@ void LinkDialog::setupUi()
 	logLevelCombo_->addItem(QIcon(":/bug.png"), "debug");
 	logLevelCombo_->addItem(QIcon(":/scull.png"), "flood");
 
+	editorRateSpin_ = new QSpinBox;
+	editorRateSpin_->setToolTip("Rate of the plugin editor updates.\nThe updates are "
+			"slowed down, when the editor is inactive, and stopped, when it is hidden.");
+
+	editorRateSpin_->setRange(0, Storage::kMaxEditorRate);
+	editorRateSpin_->setSuffix(" Hz");
+	editorRateSpin_->setSpecialValueText("display refresh rate");
+	editorRateSpin_->setValue(Storage::kDefaultEditorRate);
+
+	flushDenormalsCheck_ = new QCheckBox("Flush to zero");
+	flushDenormalsCheck_->setToolTip("Process the audio with the FTZ and DAZ modes of the "
+			"CPU.\nHelps the plugins, which slow down on the decaying tails.");
+
+	countDenormalsCheck_ = new QCheckBox("Count");
+	countDenormalsCheck_->setToolTip("Count the denormal samples of every 16th audio "
+			"block.\nThe counters are shown in the instances view.");
+
+	sanitizeOutputCheck_ = new QCheckBox("Sanitize");
+	sanitizeOutputCheck_->setToolTip("Replace NaN and infinite output samples by zero "
+			"and meter the output.\nThe levels are shown in the instances view.");
+
+	clampOutputCheck_ = new QCheckBox("Clamp to +12 dBFS");
+	clampOutputCheck_->setToolTip("Clamp the sanitized output, so the runaway plugin "
+			"can't blow up the bus.");
+
+	clampOutputCheck_->setEnabled(false);
+	connect(sanitizeOutputCheck_, SIGNAL(toggled(bool)),
+			clampOutputCheck_, SLOT(setEnabled(bool)));
+
 	targetEdit_ = new LineEdit;
 	targetEdit_->setButtonEnabled(true);
 	targetEdit_->setButtonStyle(LineEdit::kLightAutoRaise);
@@ -134,11 +171,22 @@ void LinkDialog::setupUi()
 	mainLayout->addWidget(new QLabel("Log level:"), 5, 0, Qt::AlignRight);
 	mainLayout->addWidget(logLevelCombo_, 5, 1, 1, 1);
 
-	mainLayout->addWidget(new QWidget, 6, 0);
+	mainLayout->addWidget(new QLabel("Editor rate:"), 6, 0, Qt::AlignRight);
+	mainLayout->addWidget(editorRateSpin_, 6, 1, 1, 1);
+
+	mainLayout->addWidget(new QLabel("Denormals:"), 7, 0, Qt::AlignRight);
+	mainLayout->addWidget(flushDenormalsCheck_, 7, 1, 1, 1);
+	mainLayout->addWidget(countDenormalsCheck_, 7, 2, 1, 1);
 
-	mainLayout->addWidget(buttons_, 7, 1, 1, 2);
+	mainLayout->addWidget(new QLabel("Output:"), 8, 0, Qt::AlignRight);
+	mainLayout->addWidget(sanitizeOutputCheck_, 8, 1, 1, 1);
+	mainLayout->addWidget(clampOutputCheck_, 8, 2, 1, 1);
 
-	mainLayout->setRowStretch(5, 1);
+	mainLayout->addWidget(new QWidget, 9, 0);
+
+	mainLayout->addWidget(buttons_, 10, 1, 1, 2);
+
+	mainLayout->setRowStretch(9, 1);
 
 	mainLayout->setColumnStretch(0, 0);
 	mainLayout->setColumnStretch(1, 0);
@@ -268,6 +316,8 @@ void LinkDialog::accept()
 
 		int value = logLevelCombo_->currentIndex() - 1;
 		item_->setLogLevel(static_cast<LogLevel>(value));
+		item_->setEditorRate(editorRateSpin_->value());
+		item_->setOptions(options());
 	}
 	else {
 		if(item_->name() != name) {
@@ -297,6 +347,8 @@ void LinkDialog::accept()
 
 		int value = logLevelCombo_->currentIndex() - 1;
 		item_->setLogLevel(static_cast<LogLevel>(value));
+		item_->setEditorRate(editorRateSpin_->value());
+		item_->setOptions(options());
 	}
 
 	qApp->storage()->save();
@@ -332,3 +384,32 @@ QString LinkDialog::getPluginPath() const
 	QString pluginPath = QString::fromStdString(qApp->storage()->binariesPath());
 	return pluginPath + "/" PLUGIN_BASENAME ".so";
 }
+
+
+int LinkDialog::options() const
+{
+	int options = 0;
+
+	if(flushDenormalsCheck_->isChecked())
+		options |= Storage::kFlushDenormals;
+
+	if(countDenormalsCheck_->isChecked())
+		options |= Storage::kCountDenormals;
+
+	if(sanitizeOutputCheck_->isChecked())
+		options |= Storage::kSanitizeOutput;
+
+	if(clampOutputCheck_->isChecked())
+		options |= Storage::kClampOutput;
+
+	return options;
+}
+
+
+void LinkDialog::setOptions(int options)
+{
+	flushDenormalsCheck_->setChecked(options & Storage::kFlushDenormals);
+	countDenormalsCheck_->setChecked(options & Storage::kCountDenormals);
+	sanitizeOutputCheck_->setChecked(options & Storage::kSanitizeOutput);
+	clampOutputCheck_->setChecked(options & Storage::kClampOutput);
+}
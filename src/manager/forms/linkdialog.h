@@ -4,7 +4,9 @@
 #include <QDialog>
 
 
+class QCheckBox;
 class QComboBox;
+class QSpinBox;
 class QDialogButtonBox;
 class LineEdit;
 class LinkItem;
@@ -22,6 +24,11 @@ private:
 	QComboBox* loaderCombo_;
 	QComboBox* prefixCombo_;
 	QComboBox* logLevelCombo_;
+	QSpinBox* editorRateSpin_;
+	QCheckBox* flushDenormalsCheck_;
+	QCheckBox* countDenormalsCheck_;
+	QCheckBox* sanitizeOutputCheck_;
+	QCheckBox* clampOutputCheck_;
 	LineEdit* targetEdit_;
 	LineEdit* locationEdit_;
 	LineEdit* nameEdit_;
@@ -31,6 +38,8 @@ private:
 	void setupUi();
 	QString currentPrefix() const;
 	QString getPluginPath() const;
+	int options() const;
+	void setOptions(int options);
 
 private slots:
 	void browsePlugin();
@@ -9,33 +9,56 @@
 #include <QMessageBox>
 #include <QSettings>
 #include <QSplitter>
+#include <QTabWidget>
 #include <QToolBar>
 #include "common/config.h"
 #include "core/application.h"
 #include "forms/linkdialog.h"
+#include "forms/scandialog.h"
 #include "forms/settingsdialog.h"
+#include "models/instancesmodel.h"
 #include "models/linksmodel.h"
+#include "widgets/instancesview.h"
 #include "widgets/linksview.h"
+#include "widgets/logfilterbar.h"
 #include "widgets/logview.h"
 
 
 MainForm::MainForm(QWidget* parent) :
 	QMainWindow(parent)
 {
+	LogStore* store = qApp->logStore();
+	if(!store->open(LogStore::defaultPath()))
+		qDebug("Unable to open log store.");
+
 	setupUi();
 	loadSettings();
 	updateToolbarButtons();
 
 	QString logSocketPath = QString::fromStdString(qApp->storage()->logSocketPath());
 
+	QSettings settings;
 	LogSocket* socket = qApp->logSocket();
+	socket->setReceiveBufferSize(settings.value("logBufferSize",
+			LogSocket::kDefaultBufferSize).toInt());
+
 	if(!socket->listen(logSocketPath))
 		qDebug("Unable to create logger socket.");
 
 	connect(socket,
-			SIGNAL(newMessage(quint64,QString,QString)),
+			SIGNAL(newMessages(QVector<LogMessage>)),
 			logView_,
-			SLOT(addMessage(quint64,QString,QString)));
+			SLOT(addMessages(QVector<LogMessage>)));
+
+	connect(socket,
+			SIGNAL(newMessages(QVector<LogMessage>)),
+			store,
+			SLOT(append(QVector<LogMessage>)));
+
+	connect(socket,
+			SIGNAL(newMessages(QVector<LogMessage>)),
+			qApp->startupStats(),
+			SLOT(addMessages(QVector<LogMessage>)));
 
 	connect(qApp->links(),
 			SIGNAL(rowsInserted(QModelIndex,int,int)),
@@ -66,8 +89,12 @@ void MainForm::loadSettings()
 	restoreState(settings.value("windowState").toByteArray());
 
 	splitter_->restoreState(settings.value("mainSplitter").toByteArray());
+	tabWidget_->setCurrentIndex(settings.value("currentTab", 0).toInt());
 
-	toggleWordWrap_->setChecked(settings.value("logWordWrap", true).toBool());
+	// The action doesn't emit triggered() on setChecked(), so the view is set directly.
+	bool isWordWrap = settings.value("logWordWrap", false).toBool();
+	toggleWordWrap_->setChecked(isWordWrap);
+	logView_->setWordWrap(isWordWrap);
 	toggleAutoScroll_->setChecked(settings.value("logAutoScroll", true).toBool());
 
 	QHeaderView* header = linksView_->header();
@@ -84,6 +111,9 @@ void MainForm::loadSettings()
 	width = settings.value("loaderNameWidth", 70).toInt();
 	header->resizeSection(3, width);
 
+	width = settings.value("startupWidth", 70).toInt();
+	header->resizeSection(4, width);
+
 	settings.endGroup();
 }
 
@@ -97,6 +127,7 @@ void MainForm::saveSettings()
 	settings.setValue("windowState", saveState());
 
 	settings.setValue("mainSplitter", splitter_->saveState());
+	settings.setValue("currentTab", tabWidget_->currentIndex());
 
 	settings.setValue("logWordWrap", toggleWordWrap_->isChecked());
 	settings.setValue("logAutoScroll", toggleAutoScroll_->isChecked());
@@ -106,6 +137,7 @@ void MainForm::saveSettings()
 	settings.setValue("logLevelWidth", header->sectionSize(1));
 	settings.setValue("prefixNameWidth", header->sectionSize(2));
 	settings.setValue("loaderNameWidth", header->sectionSize(3));
+	settings.setValue("startupWidth", header->sectionSize(4));
 
 	settings.endGroup();
 }
@@ -131,7 +163,8 @@ void MainForm::setupUi()
 	header->setSectionResizeMode(1, QHeaderView::Interactive);
 	header->setSectionResizeMode(2, QHeaderView::Interactive);
 	header->setSectionResizeMode(3, QHeaderView::Interactive);
-	header->setSectionResizeMode(4, QHeaderView::Stretch);
+	header->setSectionResizeMode(4, QHeaderView::Interactive);
+	header->setSectionResizeMode(5, QHeaderView::Stretch);
 
 	connect(linksView_,
 			SIGNAL(itemSelectionChanged(QItemSelection,QItemSelection)),
@@ -142,10 +175,37 @@ void MainForm::setupUi()
 			SLOT(editLink()));
 
 	logView_ = new LogView;
+	logView_->setLogStore(qApp->logStore());
+
+	logFilterBar_ = new LogFilterBar(qApp->logStore());
+
+	connect(logFilterBar_,
+			SIGNAL(filterChanged(LogFilter)),
+			logView_,
+			SLOT(setFilter(LogFilter)));
+
+	QVBoxLayout* logLayout = new QVBoxLayout;
+	logLayout->setSpacing(0);
+	logLayout->setMargin(0);
+	logLayout->addWidget(logFilterBar_);
+	logLayout->addWidget(logView_);
+
+	QWidget* logPage = new QWidget;
+	logPage->setLayout(logLayout);
+
+	instancesModel_ = new InstancesModel(this);
+	instancesView_ = new InstancesView;
+	instancesView_->setModel(instancesModel_);
+
+	tabWidget_ = new QTabWidget;
+	tabWidget_->setDocumentMode(true);
+	tabWidget_->setTabPosition(QTabWidget::South);
+	tabWidget_->addTab(logPage, "Log");
+	tabWidget_->addTab(instancesView_, "Instances");
 
 	splitter_ = new QSplitter(Qt::Vertical);
 	splitter_->addWidget(linksView_);
-	splitter_->addWidget(logView_);
+	splitter_->addWidget(tabWidget_);
 
 	int size = splitter_->height();
 	splitter_->setSizes(QList<int>() << size * 0.618 << size * 0.382);
@@ -169,6 +229,13 @@ void MainForm::setupUi()
 	toolBar_->addAction(createLink_);
 	connect(createLink_, SIGNAL(triggered()), SLOT(createLink()));
 
+	// Find plugins action
+	findPlugins_ = new QAction(QIcon(":/open.png"), "Find VST plugins in WINE prefix",
+			this);
+
+	toolBar_->addAction(findPlugins_);
+	connect(findPlugins_, SIGNAL(triggered()), SLOT(findPlugins()));
+
 	// Edit link action
 	editLink_ = new QAction(QIcon(":/edit.png"), "Edit link", this);
 	editLink_->setEnabled(false);
@@ -280,6 +347,19 @@ void MainForm::createLink()
 }
 
 
+void MainForm::findPlugins()
+{
+	if(checkBinaries()) {
+		ScanDialog dialog;
+		dialog.exec();
+	}
+	else {
+		SettingsDialog dialog;
+		dialog.exec();
+	}
+}
+
+
 void MainForm::editLink()
 {
 	if(checkBinaries()) {
@@ -6,8 +6,12 @@
 
 class QAction;
 class QSplitter;
+class QTabWidget;
+class InstancesModel;
+class InstancesView;
 class LinksModel;
 class LinksView;
+class LogFilterBar;
 class LogView;
 
 
@@ -25,6 +29,7 @@ private:
 	QToolBar* toolBar_;
 
 	QAction* createLink_;
+	QAction* findPlugins_;
 	QAction* editLink_;
 	QAction* showInBrowser_;
 	QAction* removeLink_;
@@ -41,12 +46,17 @@ private:
 	QSplitter* splitter_;
 	LinksView* linksView_;
 	LogView* logView_;
+	LogFilterBar* logFilterBar_;
+	QTabWidget* tabWidget_;
+	InstancesModel* instancesModel_;
+	InstancesView* instancesView_;
 
 	void setupUi();
 	bool checkBinaries();
 
 private slots:
 	void createLink();
+	void findPlugins();
 	void editLink();
 	void removeLink();
 	void updateLinks();
@@ -0,0 +1,292 @@
+#include "scandialog.h"
+
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QDir>
+#include <QFile>
+#include <QGridLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QSet>
+#include <QSettings>
+#include <QTreeWidget>
+#include "common/config.h"
+#include "core/application.h"
+#include "core/pluginscanner.h"
+#include "forms/filedialog.h"
+#include "models/linksmodel.h"
+#include "models/loadersmodel.h"
+#include "models/prefixesmodel.h"
+#include "widgets/lineedit.h"
+
+
+ScanDialog::ScanDialog(QWidget* parent) :
+	QDialog(parent),
+	scanner_(nullptr)
+{
+	setupUi();
+	onPrefixChanged();
+}
+
+
+void ScanDialog::setupUi()
+{
+	setWindowIcon(QIcon(":/open.png"));
+	setWindowTitle("Find VST plugins");
+	setMinimumWidth(500);
+	resize(700, 500);
+
+	loaderCombo_ = new QComboBox;
+	loaderCombo_->setModel(qApp->loaders());
+	loaderCombo_->setCurrentIndex(loaderCombo_->findText("default"));
+
+	prefixCombo_ = new QComboBox;
+	prefixCombo_->setModel(qApp->prefixes());
+	prefixCombo_->setCurrentIndex(prefixCombo_->findText("default"));
+	connect(prefixCombo_, SIGNAL(currentIndexChanged(int)), SLOT(onPrefixChanged()));
+
+	locationEdit_ = new LineEdit;
+	locationEdit_->setButtonEnabled(true);
+	locationEdit_->setButtonStyle(LineEdit::kLightAutoRaise);
+	locationEdit_->setButtonIcon(QIcon(":/open.png"));
+	locationEdit_->setButtonToolTip("Browse");
+
+	QSettings settings;
+	QString vstPath = settings.value("vstPath", qgetenv("VST_PATH")).toString();
+	locationEdit_->setText(vstPath.split(':').first());
+	connect(locationEdit_, SIGNAL(buttonClicked()), SLOT(browseLocation()));
+
+	pluginsTree_ = new QTreeWidget;
+	pluginsTree_->setRootIsDecorated(false);
+	pluginsTree_->setHeaderLabels(QStringList() << "Name"
+			<< "VST plugin path (relative to prefix)");
+	pluginsTree_->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+
+	statusLabel_ = new QLabel;
+
+	rescanButton_ = new QPushButton(QIcon(":/update.png"), "Rescan");
+	connect(rescanButton_, SIGNAL(clicked()), SLOT(rescan()));
+
+	buttons_ = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+	connect(buttons_, SIGNAL(accepted()), SLOT(accept()));
+	connect(buttons_, SIGNAL(rejected()), SLOT(reject()));
+
+	QGridLayout* mainLayout = new QGridLayout;
+
+	mainLayout->addWidget(new QLabel("WINE loader:"), 0, 0, Qt::AlignRight);
+	mainLayout->addWidget(loaderCombo_, 0, 1, 1, 1);
+
+	mainLayout->addWidget(new QLabel("WINE prefix:"), 1, 0, Qt::AlignRight);
+	mainLayout->addWidget(prefixCombo_, 1, 1, 1, 1);
+
+	mainLayout->addWidget(new QLabel("Link location:"), 2, 0, Qt::AlignRight);
+	mainLayout->addWidget(locationEdit_, 2, 1, 1, 3);
+
+	mainLayout->addWidget(pluginsTree_, 3, 0, 1, 4);
+
+	mainLayout->addWidget(statusLabel_, 4, 0, 1, 2);
+	mainLayout->addWidget(rescanButton_, 4, 3, 1, 1);
+
+	mainLayout->addWidget(buttons_, 5, 1, 1, 3);
+
+	mainLayout->setRowStretch(3, 1);
+
+	mainLayout->setColumnStretch(0, 0);
+	mainLayout->setColumnStretch(1, 0);
+	mainLayout->setColumnStretch(2, 1);
+
+	setLayout(mainLayout);
+}
+
+
+void ScanDialog::browseLocation()
+{
+	FileDialog dialog(FileDialog::kOpenDialog);
+	dialog.setAcceptMode(FileDialog::kAcceptExistingDirectory);
+	dialog.setFilter(QDir::AllDirs | QDir::NoDotAndDotDot);
+	dialog.setWindowTitle("Select directory where the links will be placed");
+
+	QString text = locationEdit_->text();
+	if(text.isEmpty()) {
+		dialog.setDirectory(QDir::homePath());
+	}
+	else {
+		dialog.setDirectory(text);
+	}
+
+	if(dialog.exec()) {
+		locationEdit_->setText(dialog.selectedPath());
+	}
+}
+
+
+void ScanDialog::onPrefixChanged()
+{
+	if(scanner_)
+		scanner_->disconnect(this);
+
+	pluginsTree_->clear();
+
+	QString prefix = currentPrefix();
+	if(prefix.isEmpty() || !QFileInfo(prefix).isDir()) {
+		scanner_ = nullptr;
+		rescanButton_->setEnabled(false);
+		statusLabel_->setText("Selected prefix directory doesn't exists.");
+		return;
+	}
+
+	scanner_ = qApp->pluginScanner(prefix);
+	connect(scanner_, SIGNAL(finished()), SLOT(updatePlugins()));
+
+	rescan();
+}
+
+
+void ScanDialog::rescan()
+{
+	if(!scanner_)
+		return;
+
+	if(!scanner_->isScanning())
+		scanner_->scan();
+
+	if(scanner_->isScanning()) {
+		rescanButton_->setEnabled(false);
+		statusLabel_->setText("Scanning the prefix...");
+	}
+}
+
+
+void ScanDialog::updatePlugins()
+{
+	// The plugins, that are already linked from this prefix, can't be selected.
+	QSet<QString> linkedTargets;
+	QString prefixName = prefixCombo_->currentText();
+
+	LinkItem* link = qApp->links()->root()->firstChild();
+	while(link) {
+		if(link->prefix() == prefixName)
+			linkedTargets.insert(link->target());
+
+		link = link->nextSibling();
+	}
+
+	QSet<QString> uncheckedTargets;
+	for(int i = 0; i < pluginsTree_->topLevelItemCount(); ++i) {
+		QTreeWidgetItem* item = pluginsTree_->topLevelItem(i);
+		if(item->checkState(0) == Qt::Unchecked)
+			uncheckedTargets.insert(item->text(1));
+	}
+
+	pluginsTree_->clear();
+
+	QList<PluginInfo> plugins = scanner_->plugins();
+	int count = 0;
+
+	foreach(const PluginInfo& plugin, plugins) {
+		QTreeWidgetItem* item = new QTreeWidgetItem;
+		item->setText(0, QFileInfo(plugin.path).completeBaseName());
+		item->setText(1, plugin.path);
+		item->setToolTip(1, plugin.path);
+
+		if(plugin.arch == ModuleInfo::kArch32) {
+			item->setIcon(0, QIcon(":/32bit.png"));
+		}
+		else {
+			item->setIcon(0, QIcon(":/64bit.png"));
+		}
+
+		if(linkedTargets.contains(plugin.path)) {
+			item->setCheckState(0, Qt::Unchecked);
+			item->setFlags(item->flags() & ~Qt::ItemIsEnabled);
+			item->setToolTip(0, "The link to this plugin already exists");
+		}
+		else {
+			bool checked = !uncheckedTargets.contains(plugin.path);
+			item->setCheckState(0, checked ? Qt::Checked : Qt::Unchecked);
+			count++;
+		}
+
+		pluginsTree_->addTopLevelItem(item);
+	}
+
+	rescanButton_->setEnabled(true);
+	statusLabel_->setText(QString("Found %1 VST plugins, %2 of them are not linked.")
+			.arg(plugins.count()).arg(count));
+}
+
+
+void ScanDialog::accept()
+{
+	QStringList targets;
+
+	for(int i = 0; i < pluginsTree_->topLevelItemCount(); ++i) {
+		QTreeWidgetItem* item = pluginsTree_->topLevelItem(i);
+		if(!item->isDisabled() && item->checkState(0) == Qt::Checked)
+			targets += item->text(1);
+	}
+
+	if(targets.isEmpty()) {
+		QMessageBox::critical(this, "Error", "No VST plugins are selected.");
+		return;
+	}
+
+	QFileInfo locationInfo(locationEdit_->text());
+
+	if(!locationInfo.isDir()) {
+		QMessageBox::critical(this, "Error", "Location directory doesn't exists.");
+		return;
+	}
+
+	QString pluginPath = QString::fromStdString(qApp->storage()->binariesPath());
+	pluginPath += "/" PLUGIN_BASENAME ".so";
+
+	QList<LinkItem*> items = qApp->links()->createLinks(targets,
+			locationInfo.absoluteFilePath(), prefixCombo_->currentText(),
+			loaderCombo_->currentText());
+
+	if(items.isEmpty()) {
+		QMessageBox::critical(this, "Error", "Unable to create links.");
+		return;
+	}
+
+	// The link without its plugin endpoint is useless, so it isn't kept.
+	QStringList failedPaths;
+
+	foreach(LinkItem* item, items) {
+		QString path = item->path();
+
+		if(!QFile::copy(pluginPath, path)) {
+			failedPaths += path;
+			qApp->links()->removeLink(item);
+		}
+	}
+
+	// All links are written by the single save of the configuration.
+	qApp->storage()->save();
+
+	if(!failedPaths.isEmpty()) {
+		QMessageBox::warning(this, "Warning", QString("Unable to copy the plugin endpoint "
+				"for %1 of %2 links, they are not created:\n\n%3")
+				.arg(failedPaths.count()).arg(items.count())
+				.arg(failedPaths.join("\n")));
+	}
+
+	QDialog::accept();
+}
+
+
+QString ScanDialog::currentPrefix() const
+{
+	int index = prefixCombo_->currentIndex();
+
+	if(index != -1) {
+		PrefixItem* item = qApp->prefixes()->root()->childAt(index);
+		if(item)
+			return item->path();
+	}
+
+	return QString();
+}
@@ -0,0 +1,43 @@
+#ifndef FORMS_SCANDIALOG_H
+#define FORMS_SCANDIALOG_H
+
+#include <QDialog>
+
+
+class QComboBox;
+class QDialogButtonBox;
+class QLabel;
+class QPushButton;
+class QTreeWidget;
+class LineEdit;
+class PluginScanner;
+
+
+class ScanDialog : public QDialog {
+	Q_OBJECT
+public:
+	ScanDialog(QWidget* parent = nullptr);
+
+private:
+	QComboBox* loaderCombo_;
+	QComboBox* prefixCombo_;
+	LineEdit* locationEdit_;
+	QTreeWidget* pluginsTree_;
+	QLabel* statusLabel_;
+	QPushButton* rescanButton_;
+	QDialogButtonBox* buttons_;
+	PluginScanner* scanner_;
+
+	void setupUi();
+	QString currentPrefix() const;
+
+private slots:
+	void browseLocation();
+	void onPrefixChanged();
+	void rescan();
+	void updatePlugins();
+	void accept();
+};
+
+
+#endif // FORMS_SCANDIALOG_H
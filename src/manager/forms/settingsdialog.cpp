@@ -8,11 +8,13 @@
 #include <QMessageBox>
 #include <QPushButton>
 #include <QSettings>
+#include <QSpinBox>
 #include <QTreeWidget>
 #include <QDir>
 #include "common/config.h"
 #include "core/application.h"
 #include "core/logsocket.h"
+#include "core/wineserverkeeper.h"
 #include "forms/filedialog.h"
 #include "forms/loaderdialog.h"
 #include "forms/prefixdialog.h"
@@ -40,6 +42,12 @@ SettingsDialog::SettingsDialog(QWidget* parent) :
 
 	int index = static_cast<int>(storage->defaultLogLevel());
 	logLevelCombo_->setCurrentIndex(index);
+
+	processDeadlineSpin_->setValue(storage->processDeadline());
+	hostKeepAliveSpin_->setValue(storage->hostKeepAlive());
+	bootLimitSpin_->setValue(storage->bootLimit());
+	serverResidencySpin_->setValue(qApp->wineServers()->residency() / 60);
+	logBufferSpin_->setValue(qApp->logSocket()->receiveBufferSize() / 1024);
 }
 
 
@@ -90,6 +98,49 @@ void SettingsDialog::setupUi()
 	logLevelCombo_->addItem(QIcon(":/bug.png"), "debug");
 	logLevelCombo_->addItem(QIcon(":/scull.png"), "flood");
 
+	processDeadlineSpin_ = new QSpinBox;
+	processDeadlineSpin_->setToolTip("Maximum time the audio thread waits for the "
+			"bridged plugin, in percents of the block duration.\nIf the deadline is "
+			"missed, the block is filled with silence and counted as xrun.");
+
+	processDeadlineSpin_->setRange(0, 1000);
+	processDeadlineSpin_->setSuffix(" %");
+	processDeadlineSpin_->setSpecialValueText("disabled");
+
+	hostKeepAliveSpin_ = new QSpinBox;
+	hostKeepAliveSpin_->setToolTip("Time the host process of the closed plugin is kept "
+			"running.\nIf the same link is opened again during this time, the process is "
+			"reused instead of starting WINE from scratch.");
+
+	hostKeepAliveSpin_->setRange(0, 3600);
+	hostKeepAliveSpin_->setSuffix(" s");
+	hostKeepAliveSpin_->setSpecialValueText("disabled");
+
+	bootLimitSpin_ = new QSpinBox;
+	bootLimitSpin_->setToolTip("Maximum number of the host processes, starting in the "
+			"same WINE prefix at once.\nThe rest of the plugins wait for their turn, when "
+			"the project with many plugins is loaded.");
+
+	bootLimitSpin_->setRange(0, 64);
+	bootLimitSpin_->setSpecialValueText("unlimited");
+
+	serverResidencySpin_ = new QSpinBox;
+	serverResidencySpin_->setToolTip("Time the wineserver of the prefix is kept running "
+			"after its plugins were used.\nThe wineservers are started by the manager, so "
+			"the first plugin doesn't wait for WINE to load the registry.");
+
+	serverResidencySpin_->setRange(0, 1440);
+	serverResidencySpin_->setSuffix(" min");
+	serverResidencySpin_->setSpecialValueText("disabled");
+
+	logBufferSpin_ = new QSpinBox;
+	logBufferSpin_->setToolTip("Receive buffer size of the log socket.\nIncrease it, "
+			"if the log messages are lost at the high log levels.");
+
+	logBufferSpin_->setRange(64, 65536);
+	logBufferSpin_->setSingleStep(256);
+	logBufferSpin_->setSuffix(" KiB");
+
 	QGridLayout* generalLayout = new QGridLayout;
 	generalLayout->addWidget(new QLabel("VST location:"), 0, 0, Qt::AlignRight);
 	generalLayout->addWidget(vstPathEdit_, 0, 1, 1, 4);
@@ -99,6 +150,16 @@ void SettingsDialog::setupUi()
 	generalLayout->addWidget(logSocketEdit_, 2, 1, 1, 4);
 	generalLayout->addWidget(new QLabel("Default log level:"), 3, 0, Qt::AlignRight);
 	generalLayout->addWidget(logLevelCombo_, 3, 1);
+	generalLayout->addWidget(new QLabel("Process deadline:"), 4, 0, Qt::AlignRight);
+	generalLayout->addWidget(processDeadlineSpin_, 4, 1);
+	generalLayout->addWidget(new QLabel("Host keep-alive:"), 5, 0, Qt::AlignRight);
+	generalLayout->addWidget(hostKeepAliveSpin_, 5, 1);
+	generalLayout->addWidget(new QLabel("Parallel boots:"), 6, 0, Qt::AlignRight);
+	generalLayout->addWidget(bootLimitSpin_, 6, 1);
+	generalLayout->addWidget(new QLabel("Server residency:"), 7, 0, Qt::AlignRight);
+	generalLayout->addWidget(serverResidencySpin_, 7, 1);
+	generalLayout->addWidget(new QLabel("Log buffer size:"), 8, 0, Qt::AlignRight);
+	generalLayout->addWidget(logBufferSpin_, 8, 1);
 
 	prefixesView_ = new PrefixesView;
 	prefixesView_->setModel(qApp->prefixes());
@@ -382,12 +443,22 @@ void SettingsDialog::accept()
 	}
 
 	LogSocket* socket = qApp->logSocket();
+	socket->setReceiveBufferSize(logBufferSpin_->value() * 1024);
+
+	QSettings settings;
+	settings.setValue("logBufferSize", socket->receiveBufferSize());
+
+	qApp->wineServers()->setResidency(serverResidencySpin_->value() * 60);
+
 	if(logSocketEdit_->text() != socket->id()) {
 		socket->close();
 		socket->listen(logSocketEdit_->text());
 	}
 
 	storage->setDefaultLogLevel(level);
+	storage->setProcessDeadline(processDeadlineSpin_->value());
+	storage->setHostKeepAlive(hostKeepAliveSpin_->value());
+	storage->setBootLimit(bootLimitSpin_->value());
 	storage->setBinariesPath(binariesPathEdit_->text().toStdString());
 
 	storage->save();
@@ -1,13 +1,20 @@
 #include "directorymodel.h"
 
+#include <algorithm>
 #include <QApplication>
+#include <QDirIterator>
 #include <QIcon>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
 #include <QStyle>
+#include <QThreadPool>
 
 
-DirectoryItem::DirectoryItem(const QFileInfo& info) :
+DirectoryItem::DirectoryItem(const QFileInfo& info, const QString& sortKey) :
 	info_(info),
-	type_(getType())
+	type_(getType()),
+	sortKey_(sortKey.isNull() ? info.fileName().toCaseFolded() : sortKey)
 {
 }
 
@@ -63,6 +70,12 @@ QString DirectoryItem::type() const
 }
 
 
+QString DirectoryItem::sortKey() const
+{
+	return sortKey_;
+}
+
+
 QString DirectoryItem::getType() const
 {
 	if(info_.isRoot())
@@ -85,17 +98,122 @@ QString DirectoryItem::getType() const
 }
 
 
+// The state shared by the model and its loaders. The loader can outlive the model, so
+// the model detaches itself from the channel on destruction.
+struct DirectoryModel::Channel {
+	QMutex mutex;
+	DirectoryModel* model;
+	int generation;
+	QVector<Batch> batches;
+};
+
+
+class DirectoryModel::Loader : public QRunnable {
+public:
+	Loader(const QSharedPointer<Channel>& channel, int generation, const QString& path,
+			const QStringList& nameFilters, QDir::Filters filters) :
+		channel_(channel),
+		generation_(generation),
+		path_(path),
+		nameFilters_(nameFilters),
+		filters_(filters)
+	{
+	}
+
+	void run()
+	{
+		bool isRoot = QDir(path_).isRoot();
+
+		QVector<Entry> entries;
+		entries.reserve(kBatchSize);
+
+		QDirIterator it(path_, nameFilters_, filters_);
+		while(it.hasNext()) {
+			it.next();
+
+			Entry entry;
+			entry.info = it.fileInfo();
+
+			QString name = entry.info.fileName();
+			if(isRoot && name == "..")
+				continue;
+
+			// Fill the stat cache of QFileInfo here, so the GUI thread will not touch the
+			// disk while displaying the item.
+			entry.info.isDir();
+			entry.info.size();
+			entry.info.lastModified();
+
+			entry.sortKey = name.toCaseFolded();
+			entries.append(entry);
+
+			if(entries.count() >= kBatchSize) {
+				if(!post(entries, false))
+					return;
+
+				entries.clear();
+			}
+		}
+
+		post(entries, true);
+	}
+
+private:
+	QSharedPointer<Channel> channel_;
+	int generation_;
+	QString path_;
+	QStringList nameFilters_;
+	QDir::Filters filters_;
+
+	// Returns false if the result is not needed anymore.
+	bool post(const QVector<Entry>& entries, bool isLast)
+	{
+		QMutexLocker locker(&channel_->mutex);
+
+		if(!channel_->model || channel_->generation != generation_)
+			return false;
+
+		if(channel_->batches.isEmpty()) {
+			QMetaObject::invokeMethod(channel_->model, "processBatches",
+					Qt::QueuedConnection);
+		}
+
+		Batch batch;
+		batch.generation = generation_;
+		batch.isLast = isLast;
+		batch.entries = entries;
+		channel_->batches.append(batch);
+		return true;
+	}
+};
+
+
 DirectoryModel::DirectoryModel(QObject* parent) :
 	GenericTreeModel<DirectoryItem>(new DirectoryItem(), parent),
 	filters_(QDir::AllEntries),
-	isFilesEnabled_(true)
+	isFilesEnabled_(true),
+	order_(Qt::AscendingOrder),
+	channel_(new Channel),
+	generation_(0),
+	isLoading_(false)
 {
+	channel_->model = this;
+	channel_->generation = 0;
+
 	connect(&watcher_,
 			SIGNAL(directoryChanged(QString)),
 			SLOT(update(QString)));
 }
 
 
+DirectoryModel::~DirectoryModel()
+{
+	QMutexLocker locker(&channel_->mutex);
+	channel_->model = nullptr;
+	channel_->batches.clear();
+}
+
+
 int DirectoryModel::columnCount(const QModelIndex& parent) const
 {
 	Q_UNUSED(parent);
@@ -176,25 +294,172 @@ Qt::ItemFlags DirectoryModel::flags(const QModelIndex& index) const
 
 void DirectoryModel::update(const QString& path)
 {
-	QDir dir(path);
-	if(!dir.exists())
+	if(path != directory() || !QDir(path).exists())
 		return;
 
-	clear();
+	load(true);
+}
+
 
-	dir_ = dir.canonicalPath();
-	dir_.setFilter(filters_);
-	dir_.setNameFilters(nameFilters_);
+void DirectoryModel::load(bool isReload)
+{
+	generation_++;
+
+	{
+		QMutexLocker locker(&channel_->mutex);
+		channel_->generation = generation_;
+		channel_->batches.clear();
+	}
 
-	for(const QFileInfo& info : dir_.entryInfoList()) {
-		if(dir.isRoot() && info.fileName() == "..")
+	// On reload the existing items are kept, so the selection and the scroll position of
+	// the view are not lost.
+	if(!isReload) {
+		clear();
+		itemByName_.clear();
+	}
+
+	listedNames_.clear();
+	isLoading_ = true;
+
+	Loader* loader = new Loader(channel_, generation_, directory(), nameFilters_,
+			filters_);
+
+	QThreadPool::globalInstance()->start(loader);
+}
+
+
+void DirectoryModel::processBatches()
+{
+	QVector<Batch> batches;
+	{
+		QMutexLocker locker(&channel_->mutex);
+		batches.swap(channel_->batches);
+	}
+
+	foreach(const Batch& batch, batches) {
+		if(batch.generation != generation_)
 			continue;
 
-		DirectoryItem* item = new DirectoryItem(info);
-		root()->insertChild(item);
+		applyBatch(batch.entries);
+
+		if(batch.isLast) {
+			removeUnlisted();
+			isLoading_ = false;
+			emit loaded();
+		}
 	}
+}
+
+
+void DirectoryModel::applyBatch(const QVector<Entry>& entries)
+{
+	QList<DirectoryItem*> newItems;
+
+	foreach(const Entry& entry, entries) {
+		QString name = entry.info.fileName();
+		listedNames_.insert(name);
+
+		DirectoryItem* item = itemByName_.value(name);
+		if(item) {
+			const QFileInfo& info = item->info_;
+
+			// The directories are sorted before the files, so the item, which has changed
+			// its type, is moved to its new position along with the new items.
+			if(info.isDir() != entry.info.isDir()) {
+				item->takeFromParent();
+				item->info_ = entry.info;
+				item->type_ = item->getType();
+				newItems += item;
+				continue;
+			}
+
+			if(info.size() != entry.info.size() ||
+					info.lastModified() != entry.info.lastModified()) {
+				item->info_ = entry.info;
+				item->type_ = item->getType();
+				updateData(item);
+			}
+
+			continue;
+		}
+
+		item = new DirectoryItem(entry.info, entry.sortKey);
+		itemByName_.insert(name, item);
+		newItems += item;
+	}
+
+	if(newItems.isEmpty())
+		return;
+
+	DirectoryItem::LessThanProc compare =
+			(order_ == Qt::AscendingOrder) ? lessThan : greaterThan;
+
+	std::sort(newItems.begin(), newItems.end(), compare);
+
+	// The sorted items, that fall between the same pair of existing items, are inserted
+	// by a single call. The first batch of the empty model is inserted at once.
+	int first = 0;
+	while(first < newItems.count()) {
+		int row = insertPosition(newItems[first]);
+		int last = first + 1;
+
+		while(last < newItems.count() && (row == root()->childCount() ||
+				!compare(root()->childAt(row), newItems[last]))) {
+			last++;
+		}
+
+		root()->insertChildren(newItems.mid(first, last - first), row);
+		first = last;
+	}
+}
+
+
+void DirectoryModel::removeUnlisted()
+{
+	int row = root()->childCount() - 1;
 
-	sort(0, Qt::AscendingOrder);
+	while(row >= 0) {
+		int last = row;
+
+		while(row >= 0) {
+			QString name = root()->childAt(row)->name();
+			if(listedNames_.contains(name))
+				break;
+
+			itemByName_.remove(name);
+			row--;
+		}
+
+		if(row < last)
+			root()->removeChildren(row + 1, last - row);
+
+		row--;
+	}
+
+	listedNames_.clear();
+}
+
+
+int DirectoryModel::insertPosition(DirectoryItem* item) const
+{
+	DirectoryItem::LessThanProc compare =
+			(order_ == Qt::AscendingOrder) ? lessThan : greaterThan;
+
+	int low = 0;
+	int high = root()->childCount();
+
+	while(low < high) {
+		int middle = (low + high) / 2;
+
+		if(compare(root()->childAt(middle), item)) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	return low;
 }
 
 
@@ -204,11 +469,21 @@ QString DirectoryModel::directory() const
 }
 
 
+bool DirectoryModel::isLoading() const
+{
+	return isLoading_;
+}
+
+
 void DirectoryModel::setDirectory(const QString& path)
 {
 	watcher_.removePath(dir_.canonicalPath());
 
-	update(path);
+	QDir dir(path);
+	if(dir.exists()) {
+		dir_.setPath(dir.canonicalPath());
+		load(false);
+	}
 
 	watcher_.addPath(dir_.canonicalPath());
 	emit directoryChanged(dir_.canonicalPath());
@@ -224,7 +499,7 @@ QStringList DirectoryModel::nameFilters() const
 void DirectoryModel::setNameFilters(const QStringList& filters)
 {
 	nameFilters_ = filters;
-	update(directory());
+	load(true);
 }
 
 
@@ -237,13 +512,14 @@ QDir::Filters DirectoryModel::filters() const
 void DirectoryModel::setFilters(QDir::Filters filters)
 {
 	filters_ = filters;
-	update(directory());
+	load(true);
 }
 
 
 void DirectoryModel::sort(int column, Qt::SortOrder order)
 {
 	Q_UNUSED(column);
+	order_ = order;
 	emit layoutAboutToBeChanged();
 
 	if(order == Qt::AscendingOrder) {
@@ -259,15 +535,15 @@ void DirectoryModel::sort(int column, Qt::SortOrder order)
 
 bool DirectoryModel::lessThan(DirectoryItem* item1, DirectoryItem* item2)
 {
-	if(item1->name() == "..") {
+	if(item1->sortKey_ == "..") {
 		return true;
 	}
-	else if(item2->name() == "..") {
+	else if(item2->sortKey_ == "..") {
 		return false;
 	}
 
 	if(item1->isDirectory() == item2->isDirectory())
-		return item1->name().compare(item2->name(), Qt::CaseInsensitive) < 0;
+		return item1->sortKey_ < item2->sortKey_;
 
 	return item1->isDirectory();
 }
@@ -275,15 +551,15 @@ bool DirectoryModel::lessThan(DirectoryItem* item1, DirectoryItem* item2)
 
 bool DirectoryModel::greaterThan(DirectoryItem* item1, DirectoryItem* item2)
 {
-	if(item1->name() == "..") {
+	if(item1->sortKey_ == "..") {
 		return false;
 	}
-	else if(item2->name() == "..") {
+	else if(item2->sortKey_ == "..") {
 		return true;
 	}
 
 	if(item1->isDirectory() == item2->isDirectory())
-		return item1->name().compare(item2->name(), Qt::CaseInsensitive) > 0;
+		return item1->sortKey_ > item2->sortKey_;
 
 	return item2->isDirectory();
 }
@@ -301,5 +577,9 @@ void DirectoryModel::setFilesEnabled(bool enabled)
 		return;
 
 	isFilesEnabled_ = enabled;
-	update(directory());
+
+	// Only the flags of the items are changed, there is no need to list the directory.
+	int count = root()->childCount();
+	if(count)
+		emit dataChanged(index(0, 0), index(count - 1, columnCount() - 1));
 }
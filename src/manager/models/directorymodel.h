@@ -3,13 +3,17 @@
 
 #include <QDir>
 #include <QFileSystemWatcher>
+#include <QHash>
+#include <QSet>
+#include <QSharedPointer>
+#include <QVector>
 #include "common/types.h"
 #include "models/generictreemodel.h"
 
 
 class DirectoryItem : public GenericTreeItem<DirectoryItem> {
 public:
-	DirectoryItem(const QFileInfo& info = QFileInfo());
+	DirectoryItem(const QFileInfo& info = QFileInfo(), const QString& sortKey = QString());
 
 	bool isDirectory() const;
 
@@ -21,18 +25,28 @@ public:
 	QString humanReadableSize() const;
 	QString type() const;
 
+	// Case folded name, compared instead of the name itself during the sorting.
+	QString sortKey() const;
+
 private:
+	friend class DirectoryModel;
+
 	QFileInfo info_;
 	QString type_;
+	QString sortKey_;
 
 	QString getType() const;
 };
 
 
+// Lists the directory in the thread pool and inserts its entries by batches, so the huge
+// or slow directories don't block the GUI. When the directory is changed on disk, it is
+// listed again and only the difference is applied to the model.
 class DirectoryModel : public GenericTreeModel<DirectoryItem> {
 	Q_OBJECT
 public:
 	DirectoryModel(QObject* parent = nullptr);
+	~DirectoryModel();
 
 	int columnCount(const QModelIndex& parent = QModelIndex()) const;
 
@@ -47,6 +61,7 @@ public:
 	QStringList nameFilters() const;
 	QDir::Filters filters() const;
 	bool isFilesEnabled() const;
+	bool isLoading() const;
 
 public slots:
 	void setDirectory(const QString& path);
@@ -56,13 +71,42 @@ public slots:
 
 signals:
 	void directoryChanged(const QString& path);
+	void loaded();
 
 private:
+	struct Entry {
+		QFileInfo info;
+		QString sortKey;
+	};
+
+	struct Batch {
+		int generation;
+		bool isLast;
+		QVector<Entry> entries;
+	};
+
+	struct Channel;
+	class Loader;
+
+	static const int kBatchSize = 256;
+
 	QDir dir_;
 	QFileSystemWatcher watcher_;
 	QStringList nameFilters_;
 	QDir::Filters filters_;
 	bool isFilesEnabled_;
+	Qt::SortOrder order_;
+
+	QSharedPointer<Channel> channel_;
+	int generation_;
+	bool isLoading_;
+	QHash<QString, DirectoryItem*> itemByName_;
+	QSet<QString> listedNames_;
+
+	void load(bool isReload);
+	void applyBatch(const QVector<Entry>& entries);
+	void removeUnlisted();
+	int insertPosition(DirectoryItem* item) const;
 
 	void sort(int column, Qt::SortOrder order);
 
@@ -70,8 +114,8 @@ private:
 	static bool greaterThan(DirectoryItem* item1, DirectoryItem* item2);
 
 private slots:
-
 	void update(const QString& path);
+	void processBatches();
 };
 
 
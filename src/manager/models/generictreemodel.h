@@ -77,6 +77,18 @@ public:
 	 */
 	void insertChild(Derived* item, int row = -1);
 
+	/**
+	 * Производит вставку элементов @p items в дочерние элементы, начиная с позиции @p
+	 * row. Позиции последующих элементов пересчитываются один раз, а модель получает
+	 * единственное уведомление о вставке всего диапазона. Если @p row меньше нуля или
+	 * больше количества дочерних элементов, то элементы помещаются в конец. Право
+	 * владения элементами передается текущему элементу.
+	 *
+	 * @param items вставляемые элементы.
+	 * @param row позиция вставки первого элемента.
+	 */
+	void insertChildren(const QList<Derived*>& items, int row = -1);
+
 	/**
 	 * Производит перемещение элемента @p item в дочерние элементы на позицию @p row.
 	 * Если @c row меньше нуля или больше количества дочерних элементов, то элемент @p
@@ -108,6 +120,28 @@ public:
 	 */
 	void removeChild(int row);
 
+	/**
+	 * Производит извлечение @p count дочерних элементов, начиная с позиции @p row, и
+	 * возвращает эти элементы. Модель получает единственное уведомление об удалении
+	 * всего диапазона. Если диапазон выходит за пределы списка дочерних элементов, то
+	 * возвращается пустой список. Право владения элементами передается вызывающему
+	 * коду.
+	 *
+	 * @param row позиция первого извлекаемого элемента.
+	 * @param count количество извлекаемых элементов.
+	 * @return извлеченные элементы.
+	 */
+	QList<Derived*> takeChildren(int row, int count);
+
+	/**
+	 * Производит извлечение @p count дочерних элементов, начиная с позиции @p row, с
+	 * последующим их уничтожением.
+	 *
+	 * @param row позиция первого удаляемого элемента.
+	 * @param count количество удаляемых элементов.
+	 */
+	void removeChildren(int row, int count);
+
 	/**
 	 * Рекурсивно уничтожает все дочерние элементы.
 	 */
@@ -236,6 +270,16 @@ public:
 	 */
 	void clear();
 
+	/**
+	 * Уничтожает все элементы модели и помещает @p items в дочерние элементы корневого
+	 * элемента. Представления получают единственное уведомление о сбросе модели вместо
+	 * уведомлений об удалении и вставке каждого элемента. Элементы @p items не должны
+	 * принадлежать другим элементам, право владения ими передается модели.
+	 *
+	 * @param items новые элементы верхнего уровня.
+	 */
+	void resetChildren(const QList<T*>& items);
+
 	/**
 	 * Преобразует модельный индекс @p index в элемент. В случае невалидного индекса
 	 * возвращает @c rootItem().
@@ -465,6 +509,50 @@ void GenericTreeItem<Derived>::insertChild(Derived* item, int row)
 }
 
 
+template<typename Derived>
+void GenericTreeItem<Derived>::insertChildren(const QList<Derived*>& items, int row)
+{
+	if(items.isEmpty())
+		return;
+
+	foreach(Derived* item, items) {
+		Q_ASSERT(item);
+
+		if(item->parent_)
+			item->parent_->takeChild(item->row());
+	}
+
+	if((row < 0) || (row > children_.count()))
+		row = children_.count();
+
+	if(model_)
+		model_->beginInsert(static_cast<Derived*>(this), row, items.count());
+
+	QList<Derived*> children;
+	children.reserve(children_.count() + items.count());
+	children += children_.mid(0, row);
+	children += items;
+	children += children_.mid(row);
+	children_.swap(children);
+
+	for(int i = row; i < children_.count(); ++i)
+		children_[i]->row_ = i;
+
+	foreach(Derived* item, items)
+		item->parent_ = static_cast<Derived*>(this);
+
+	if(model_) {
+		foreach(Derived* item, items)
+			item->attach();
+
+		model_->endInsert();
+	}
+
+	foreach(Derived* item, items)
+		childInserted(item);
+}
+
+
 template<typename Derived>
 bool GenericTreeItem<Derived>::moveChild(Derived* item, int row)
 {
@@ -582,14 +670,49 @@ void GenericTreeItem<Derived>::removeChild(int row)
 
 
 template<typename Derived>
-void GenericTreeItem<Derived>::removeChildren()
+QList<Derived*> GenericTreeItem<Derived>::takeChildren(int row, int count)
 {
-	int count = children_.count();
+	if((row < 0) || (count <= 0) || (row + count > children_.count()))
+		return QList<Derived*>();
 
-	// Удаляем дочерние элементы от последнего к первому, чтобы избежать лишних
-	// копирований элементов внутри children_.
-	while(count--)
-		removeChild(count);
+	if(model_)
+		model_->beginRemove(static_cast<Derived*>(this), row, count);
+
+	QList<Derived*> items = children_.mid(row, count);
+	children_.erase(children_.begin() + row, children_.begin() + row + count);
+
+	for(int i = row; i < children_.count(); ++i)
+		children_[i]->row_ = i;
+
+	foreach(Derived* item, items) {
+		item->parent_ = nullptr;
+		item->row_ = 0;
+		item->model_ = nullptr;
+
+		item->detach();
+	}
+
+	if(model_)
+		model_->endRemove();
+
+	foreach(Derived* item, items)
+		childRemoved(item);
+
+	return items;
+}
+
+
+template<typename Derived>
+void GenericTreeItem<Derived>::removeChildren(int row, int count)
+{
+	qDeleteAll(takeChildren(row, count));
+}
+
+
+template<typename Derived>
+void GenericTreeItem<Derived>::removeChildren()
+{
+	removeChildren(0, children_.count());
 }
 
 
@@ -703,9 +826,43 @@ GenericTreeModel<T>::~GenericTreeModel()
 
 template<typename T>
 void GenericTreeModel<T>::clear()
+{
+	resetChildren(QList<T*>());
+}
+
+
+template<typename T>
+void GenericTreeModel<T>::resetChildren(const QList<T*>& items)
 {
 	beginResetModel();
-	rootItem_->removeChildren();
+
+	// Внутри сброса модели уведомления об удалении и вставке строк не нужны, поэтому
+	// список дочерних элементов заменяется напрямую.
+	QList<T*> oldItems;
+	oldItems.swap(rootItem_->children_);
+
+	foreach(T* item, oldItems) {
+		item->parent_ = nullptr;
+		item->row_ = 0;
+		item->detach();
+		rootItem_->childRemoved(item);
+	}
+
+	qDeleteAll(oldItems);
+
+	rootItem_->children_.reserve(items.count());
+
+	foreach(T* item, items) {
+		Q_ASSERT(item && !item->parent_);
+
+		item->parent_ = rootItem_;
+		item->row_ = rootItem_->children_.count();
+		rootItem_->children_.append(item);
+
+		item->attach();
+		rootItem_->childInserted(item);
+	}
+
 	endResetModel();
 }
 
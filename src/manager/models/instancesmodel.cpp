@@ -0,0 +1,368 @@
+#include "instancesmodel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <QFile>
+#include <QStringList>
+#include <unistd.h>
+
+
+InstanceItem::InstanceItem(int slot, int pid) :
+	slot_(slot),
+	pid_(pid),
+	dspLoad_(0.0),
+	residentSize_(0)
+{
+	std::memset(&stats_, 0, sizeof(stats_));
+}
+
+
+int InstanceItem::slot() const
+{
+	return slot_;
+}
+
+
+int InstanceItem::pluginPid() const
+{
+	return pid_;
+}
+
+
+int InstanceItem::hostPid() const
+{
+	return stats_.hostPid;
+}
+
+
+QString InstanceItem::name() const
+{
+	QString name = QString::fromUtf8(stats_.name);
+	if(name.endsWith(".so"))
+		name.chop(3);
+
+	return name;
+}
+
+
+quint64 InstanceItem::blockCount() const
+{
+	return stats_.blockCount;
+}
+
+
+quint64 InstanceItem::xrunCount() const
+{
+	return stats_.xrunCount;
+}
+
+
+double InstanceItem::meanRoundTrip() const
+{
+	// Round trip time is not measured for the blocks, which have missed the deadline.
+	quint64 count = stats_.blockCount - stats_.xrunCount;
+	return count ? stats_.roundTripSum / 1000.0 / count : 0.0;
+}
+
+
+double InstanceItem::maxRoundTrip() const
+{
+	return stats_.roundTripMax / 1000.0;
+}
+
+
+double InstanceItem::dspLoad() const
+{
+	return dspLoad_;
+}
+
+
+quint64 InstanceItem::residentSize() const
+{
+	return residentSize_;
+}
+
+
+quint64 InstanceItem::chunkBytes() const
+{
+	return stats_.chunkBytes;
+}
+
+
+quint64 InstanceItem::denormalInputs() const
+{
+	return stats_.denormalInputs;
+}
+
+
+quint64 InstanceItem::denormalOutputs() const
+{
+	return stats_.denormalOutputs;
+}
+
+
+quint64 InstanceItem::nonFiniteOutputs() const
+{
+	return stats_.nonFiniteOutputs;
+}
+
+
+quint64 InstanceItem::clippedOutputs() const
+{
+	return stats_.clippedOutputs;
+}
+
+
+static double toDecibels(float value)
+{
+	return value > 0.0f ? 20.0 * std::log10(value) : -INFINITY;
+}
+
+
+QVector<double> InstanceItem::outputPeaks() const
+{
+	QVector<double> result;
+	for(uint i = 0; i < stats_.meterChannelCount; ++i)
+		result += toDecibels(stats_.outputPeak[i]);
+
+	return result;
+}
+
+
+QVector<double> InstanceItem::outputRmsLevels() const
+{
+	QVector<double> result;
+	for(uint i = 0; i < stats_.meterChannelCount; ++i)
+		result += toDecibels(stats_.outputRms[i]);
+
+	return result;
+}
+
+
+bool InstanceItem::update(const InstanceStats* stats)
+{
+	InstanceStats current;
+	std::memset(&current, 0, sizeof(current));
+	current.pluginPid = stats->pluginPid;
+	current.hostPid = stats->hostPid;
+	current.sampleRate = stats->sampleRate;
+	current.blockSize = stats->blockSize;
+	std::memcpy(current.name, stats->name, sizeof(current.name));
+	current.name[sizeof(current.name) - 1] = '\0';
+
+	current.blockCount = Airwave::statsLoad(&stats->blockCount);
+	current.xrunCount = Airwave::statsLoad(&stats->xrunCount);
+	current.roundTripSum = Airwave::statsLoad(&stats->roundTripSum);
+	current.roundTripMax = Airwave::statsLoad(&stats->roundTripMax);
+	current.hostCpuTime = Airwave::statsLoad(&stats->hostCpuTime);
+	current.hostBlockCount = Airwave::statsLoad(&stats->hostBlockCount);
+	current.chunkBytes = Airwave::statsLoad(&stats->chunkBytes);
+	current.denormalInputs = Airwave::statsLoad(&stats->denormalInputs);
+	current.denormalOutputs = Airwave::statsLoad(&stats->denormalOutputs);
+	current.nonFiniteOutputs = Airwave::statsLoad(&stats->nonFiniteOutputs);
+	current.clippedOutputs = Airwave::statsLoad(&stats->clippedOutputs);
+
+	current.meterChannelCount = std::min<quint32>(stats->meterChannelCount,
+			Airwave::kStatsMeterChannels);
+
+	for(uint i = 0; i < current.meterChannelCount; ++i) {
+		current.outputPeak[i] = stats->outputPeak[i];
+		current.outputRms[i] = stats->outputRms[i];
+	}
+
+	// The DSP load is the ratio of the host audio thread CPU time to the duration of
+	// the audio processed since the previous update.
+	quint64 blocks = current.hostBlockCount - stats_.hostBlockCount;
+	if(blocks > 0 && current.sampleRate > 0 && current.blockSize > 0) {
+		double cpuTime = (current.hostCpuTime - stats_.hostCpuTime) / 1e9;
+		double duration = blocks * current.blockSize / double(current.sampleRate);
+		dspLoad_ = 100.0 * cpuTime / duration;
+	}
+	else if(current.blockCount == stats_.blockCount) {
+		dspLoad_ = 0.0;
+	}
+
+	quint64 residentSize = 0;
+	if(current.hostPid > 0) {
+		QFile file(QString("/proc/%1/statm").arg(current.hostPid));
+		if(file.open(QIODevice::ReadOnly)) {
+			QList<QByteArray> fields = file.readAll().split(' ');
+			if(fields.count() > 1)
+				residentSize = fields.at(1).toULongLong() * sysconf(_SC_PAGESIZE);
+		}
+	}
+
+	bool changed = std::memcmp(&current, &stats_, sizeof(InstanceStats)) != 0 ||
+			residentSize != residentSize_;
+
+	stats_ = current;
+	residentSize_ = residentSize;
+	return changed;
+}
+
+
+InstancesModel::InstancesModel(QObject* parent) :
+	GenericTreeModel<InstanceItem>(new InstanceItem(), parent)
+{
+	connect(&timer_, SIGNAL(timeout()), SLOT(refresh()));
+	timer_.start(1000);
+	refresh();
+}
+
+
+int InstancesModel::columnCount(const QModelIndex& parent) const
+{
+	Q_UNUSED(parent);
+	return 11;
+}
+
+
+QVariant InstancesModel::data(const QModelIndex& index, int role) const
+{
+	if(index.isValid()) {
+		InstanceItem* item = indexToItem(index);
+
+		if(role == Qt::DisplayRole) {
+			switch(index.column()) {
+			case 0:
+				return item->name();
+			case 1:
+				return item->hostPid() ? QString::number(item->hostPid()) : QString();
+			case 2:
+				return item->blockCount();
+			case 3:
+				return item->xrunCount();
+			case 4:
+				return QString("%1 / %2").arg(item->meanRoundTrip(), 0, 'f', 1)
+						.arg(item->maxRoundTrip(), 0, 'f', 1);
+			case 5:
+				return QString("%1 %").arg(item->dspLoad(), 0, 'f', 1);
+			case 6:
+				return QString("%1 MiB").arg(item->residentSize() / 1048576.0, 0, 'f', 1);
+			case 7:
+				return QString("%1 KiB").arg(item->chunkBytes() / 1024.0, 0, 'f', 1);
+			case 8:
+				return QString("%1 / %2").arg(item->denormalInputs())
+						.arg(item->denormalOutputs());
+			case 9:
+				return levelsText(item->outputPeaks(), item->outputRmsLevels(), false);
+			case 10:
+				return QString("%1 / %2").arg(item->nonFiniteOutputs())
+						.arg(item->clippedOutputs());
+			}
+		}
+		else if(role == Qt::ToolTipRole && index.column() == 9) {
+			return levelsText(item->outputPeaks(), item->outputRmsLevels(), true);
+		}
+		else if(role == Qt::TextAlignmentRole && index.column() > 0) {
+			return int(Qt::AlignRight | Qt::AlignVCenter);
+		}
+	}
+
+	return QVariant();
+}
+
+
+QVariant InstancesModel::headerData(int section, Qt::Orientation orientation,
+		int role) const
+{
+	Q_UNUSED(orientation);
+
+	if(role == Qt::DisplayRole) {
+		switch(section) {
+		case 0:
+			return "Name";
+		case 1:
+			return "Host PID";
+		case 2:
+			return "Blocks";
+		case 3:
+			return "Xruns";
+		case 4:
+			return "Round trip, usec";
+		case 5:
+			return "DSP load";
+		case 6:
+			return "Memory";
+		case 7:
+			return "Chunks";
+		case 8:
+			return "Denormals, in / out";
+		case 9:
+			return "Output, dBFS";
+		case 10:
+			return "NaN / Inf, clipped";
+		}
+	}
+
+	return QVariant();
+}
+
+
+QString InstancesModel::levelsText(const QVector<double>& peaks,
+		const QVector<double>& rmsLevels, bool isPerChannel)
+{
+	if(peaks.isEmpty())
+		return QString();
+
+	// The column shows the loudest channel, the tooltip shows all of them.
+	if(!isPerChannel) {
+		double peak = *std::max_element(peaks.begin(), peaks.end());
+		double rms = *std::max_element(rmsLevels.begin(), rmsLevels.end());
+		return QString("%1 / %2").arg(peak, 0, 'f', 1).arg(rms, 0, 'f', 1);
+	}
+
+	QStringList lines;
+	for(int i = 0; i < peaks.count(); ++i) {
+		lines += QString("Channel %1: peak %2, RMS %3").arg(i + 1)
+				.arg(peaks.at(i), 0, 'f', 1).arg(rmsLevels.at(i), 0, 'f', 1);
+	}
+
+	return lines.join('\n');
+}
+
+
+void InstancesModel::refresh()
+{
+	StatsRegistry* registry = StatsRegistry::instance();
+	if(!registry->open())
+		return;
+
+	InstanceItem* item = root()->firstChild();
+	int slot = 0;
+
+	// Both the items and the slots are ordered by the slot index, so they are merged
+	// in a single pass.
+	while(slot < StatsRegistry::kSlotCount) {
+		const InstanceStats* stats = registry->slot(slot);
+		int pid = StatsRegistry::isAlive(stats) ? stats->pluginPid : 0;
+
+		if(item && item->slot() == slot) {
+			if(item->pluginPid() == pid) {
+				if(item->update(stats))
+					item->updateData();
+
+				item = item->nextSibling();
+			}
+			else {
+				// The slot is released or reused by another plugin endpoint.
+				InstanceItem* next = item->nextSibling();
+				delete item->takeFromParent();
+				item = next;
+				continue;
+			}
+
+			slot++;
+		}
+		else {
+			if(pid) {
+				InstanceItem* created = new InstanceItem(slot, pid);
+				created->update(stats);
+				root()->insertChild(created, item ? item->row() : -1);
+			}
+
+			slot++;
+		}
+	}
+}
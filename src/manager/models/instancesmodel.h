@@ -0,0 +1,75 @@
+#ifndef MODELS_INSTANCESMODEL_H
+#define MODELS_INSTANCESMODEL_H
+
+#include <QTimer>
+#include <QVector>
+#include "generictreemodel.h"
+#include "common/statsregistry.h"
+
+
+using Airwave::InstanceStats;
+using Airwave::StatsRegistry;
+
+
+class InstanceItem : public GenericTreeItem<InstanceItem> {
+public:
+	InstanceItem(int slot = -1, int pid = 0);
+
+	int slot() const;
+	int pluginPid() const;
+	int hostPid() const;
+
+	QString name() const;
+	quint64 blockCount() const;
+	quint64 xrunCount() const;
+	double meanRoundTrip() const;
+	double maxRoundTrip() const;
+	double dspLoad() const;
+	quint64 residentSize() const;
+	quint64 chunkBytes() const;
+	quint64 denormalInputs() const;
+	quint64 denormalOutputs() const;
+	quint64 nonFiniteOutputs() const;
+	quint64 clippedOutputs() const;
+
+	// Levels of the output channels in dBFS, empty if the output isn't sanitized.
+	QVector<double> outputPeaks() const;
+	QVector<double> outputRmsLevels() const;
+
+private:
+	friend class InstancesModel;
+
+	int slot_;
+	int pid_;
+	InstanceStats stats_;
+	double dspLoad_;
+	quint64 residentSize_;
+
+	bool update(const InstanceStats* stats);
+};
+
+
+class InstancesModel : public GenericTreeModel<InstanceItem> {
+	Q_OBJECT
+public:
+	InstancesModel(QObject* parent = nullptr);
+
+	int columnCount(const QModelIndex& parent = QModelIndex()) const;
+
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
+	QVariant headerData(int section, Qt::Orientation orientation,
+			int role = Qt::DisplayRole) const;
+
+public slots:
+	void refresh();
+
+private:
+	QTimer timer_;
+
+	static QString levelsText(const QVector<double>& peaks,
+			const QVector<double>& rmsLevels, bool isPerChannel);
+};
+
+
+#endif // MODELS_INSTANCESMODEL_H
@@ -1,19 +1,29 @@
 #include "linksmodel.h"
 
 #include <QDir>
+#include <QFile>
+#include <QHash>
 #include <QIcon>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include "common/config.h"
 #include "core/application.h"
 
 
 LinkItem::LinkItem(Storage::Link link) :
-	link_(link)
+	link_(link),
+	arch_(ModuleInfo::kArchUnknown),
+	isValid_(true)
 {
-	if(!link_.isNull()) {
-		Storage* storage = qApp->storage();
-		QString prefix = QString::fromStdString(storage->prefix(link_.prefix()).path());
-
-		QFileInfo info(QDir(prefix), QString::fromStdString(link_.target()));
-		arch_ = ModuleInfo::instance()->getArch(info.absoluteFilePath().toStdString());
+	// The result of the previous check is shown until the new one is finished.
+	ModuleInfo::Info info;
+	if(!link_.isNull() && ModuleInfo::instance()->findCached(
+			QFile::encodeName(targetPath()).toStdString(), &info)) {
+		arch_ = info.arch;
 	}
 }
 
@@ -68,6 +78,22 @@ ModuleInfo::Arch LinkItem::arch() const
 }
 
 
+bool LinkItem::isValid() const
+{
+	return isValid_;
+}
+
+
+QString LinkItem::targetPath() const
+{
+	Storage* storage = qApp->storage();
+	QString prefix = QString::fromStdString(storage->prefix(link_.prefix()).path());
+
+	QFileInfo info(QDir(prefix), QString::fromStdString(link_.target()));
+	return info.absoluteFilePath();
+}
+
+
 QString LinkItem::prefix() const
 {
 	return QString::fromStdString(link_.prefix());
@@ -78,6 +104,7 @@ void LinkItem::setPrefix(const QString& prefix)
 {
 	link_.setPrefix(prefix.toStdString());
 	updateData();
+	probe();
 }
 
 
@@ -104,6 +131,7 @@ void LinkItem::setTarget(const QString& source)
 {
 	link_.setTarget(source.toStdString());
 	updateData();
+	probe();
 }
 
 
@@ -133,17 +161,139 @@ void LinkItem::setLogLevel(LogLevel level)
 }
 
 
+QString LinkItem::senderId() const
+{
+	return QFileInfo(path()).fileName();
+}
+
+
+int LinkItem::editorRate() const
+{
+	return link_.editorRate();
+}
+
+
+void LinkItem::setEditorRate(int rate)
+{
+	link_.setEditorRate(rate);
+}
+
+
+int LinkItem::options() const
+{
+	return link_.options();
+}
+
+
+void LinkItem::setOptions(int options)
+{
+	link_.setOptions(options);
+}
+
+
+void LinkItem::setModuleInfo(const ModuleInfo::Info& info)
+{
+	bool isValid = info.arch != ModuleInfo::kArchUnknown && info.hasVstEntry;
+	if(arch_ == info.arch && isValid_ == isValid)
+		return;
+
+	arch_ = info.arch;
+	isValid_ = isValid;
+	updateData();
+}
+
+
+void LinkItem::probe()
+{
+	LinksModel* linksModel = static_cast<LinksModel*>(model());
+	if(linksModel)
+		linksModel->probeLinks(QList<LinkItem*>() << this);
+}
+
+
+// The state shared by the model and its probers. The prober can outlive the model, so
+// the model detaches itself from the channel on destruction.
+struct LinksModel::Channel {
+	QMutex mutex;
+	LinksModel* model;
+	QVector<ProbeResult> results;
+};
+
+
+class LinksModel::Prober : public QRunnable {
+public:
+	Prober(const QSharedPointer<Channel>& channel, const QStringList& paths) :
+		channel_(channel),
+		paths_(paths)
+	{
+	}
+
+	void run()
+	{
+		QVector<ProbeResult> results;
+		results.reserve(paths_.count());
+
+		foreach(const QString& path, paths_) {
+			ProbeResult result;
+			result.path = path;
+			result.info = ModuleInfo::instance()->getInfo(
+					QFile::encodeName(path).toStdString());
+
+			results.append(result);
+		}
+
+		QMutexLocker locker(&channel_->mutex);
+
+		if(!channel_->model)
+			return;
+
+		if(channel_->results.isEmpty()) {
+			QMetaObject::invokeMethod(channel_->model, "processResults",
+					Qt::QueuedConnection);
+		}
+
+		channel_->results += results;
+	}
+
+private:
+	QSharedPointer<Channel> channel_;
+	QStringList paths_;
+};
+
+
 LinksModel::LinksModel(QObject* parent) :
-	GenericTreeModel<LinkItem>(new LinkItem(), parent)
+	GenericTreeModel<LinkItem>(new LinkItem(), parent),
+	channel_(new Channel)
 {
+	channel_->model = this;
+
+	connect(qApp->startupStats(),
+			SIGNAL(changed(QString)),
+			SLOT(updateStartupStats(QString)));
+
+	ModuleInfo::instance()->loadCache(QFile::encodeName(moduleCachePath()).toStdString());
 	update();
 }
 
 
+LinksModel::~LinksModel()
+{
+	{
+		QMutexLocker locker(&channel_->mutex);
+		channel_->model = nullptr;
+		channel_->results.clear();
+	}
+
+	QString path = moduleCachePath();
+	QDir().mkpath(QFileInfo(path).absolutePath());
+	ModuleInfo::instance()->saveCache(QFile::encodeName(path).toStdString());
+}
+
+
 int LinksModel::columnCount(const QModelIndex& parent) const
 {
 	Q_UNUSED(parent);
-	return 5;
+	return 6;
 }
 
 
@@ -167,6 +317,9 @@ QVariant LinksModel::data(const QModelIndex& index, int role) const
 				return item->prefix();
 			}
 			else if(column == 4) {
+				return startupString(item);
+			}
+			else if(column == 5) {
 				return item->target();
 			}
 		}
@@ -187,13 +340,22 @@ QVariant LinksModel::data(const QModelIndex& index, int role) const
 				return QString::fromStdString(prefix.path());
 			}
 			if(column == 4) {
+				return qApp->startupStats()->summary(item->senderId());
+			}
+			if(column == 5) {
+				if(!item->isValid())
+					return item->target() + "\nThe file is missing or isn't a VST plugin";
+
 				return item->target();
 			}
 		}
 		else if(role == Qt::DecorationRole) {
 			int column = index.column();
 			if(column == 0) {
-				if(item->arch() == ModuleInfo::kArch32) {
+				if(!item->isValid()) {
+					return QIcon(":/warning.png");
+				}
+				else if(item->arch() == ModuleInfo::kArch32) {
 					return QIcon(":/32bit.png");
 				}
 				else if(item->arch() == ModuleInfo::kArch64) {
@@ -253,6 +415,9 @@ QVariant LinksModel::headerData(int section, Qt::Orientation orientation,
 			return "Prefix";
 		}
 		else if(section == 4) {
+			return "Startup";
+		}
+		else if(section == 5) {
 			return "VST plugin path (relative to prefix)";
 		}
 	}
@@ -277,17 +442,89 @@ LinkItem* LinksModel::createLink(const QString& name, const QString& location,
 
 	LinkItem* item = new LinkItem(link);
 	root()->insertChild(item);
+	probeLinks(QList<LinkItem*>() << item);
 	return item;
 }
 
 
+QString LinksModel::uniqueLinkPath(const QString& target, const QDir& location,
+		QSet<QString>* reservedPaths) const
+{
+	// Prefixes often contain the plugins with the same name, such as the 32-bit and the
+	// 64-bit builds in the separate directories. The path is taken, if it's used by
+	// another link, by the file, which isn't tracked by the storage, or by the link of
+	// the same batch.
+	Storage* s = qApp->storage();
+	QFileInfo targetInfo(target);
+	QString name = targetInfo.completeBaseName();
+	QString directory = QFileInfo(targetInfo.path()).fileName();
+
+	QStringList candidates;
+	candidates += name;
+
+	if(!directory.isEmpty())
+		candidates += QString("%1 (%2)").arg(name, directory);
+
+	for(int i = 0; ; ++i) {
+		QString candidate = i < candidates.count() ? candidates.at(i) :
+				QString("%1 %2").arg(candidates.last()).arg(i - candidates.count() + 2);
+
+		QString path = location.absoluteFilePath(candidate + ".so");
+
+		if(!reservedPaths->contains(path) && !s->link(path.toStdString()) &&
+				!QFileInfo(path).exists()) {
+			reservedPaths->insert(path);
+			return path;
+		}
+	}
+}
+
+
+QList<LinkItem*> LinksModel::createLinks(const QStringList& targets,
+		const QString& location, const QString& prefix, const QString& loader)
+{
+	Storage* s = qApp->storage();
+	QList<Storage::Link> links;
+	QSet<QString> reservedPaths;
+
+	foreach(const QString& target, targets) {
+		QString path = uniqueLinkPath(target, QDir(location), &reservedPaths);
+
+		Storage::Link link = s->createLink(path.toStdString(), target.toStdString(),
+				prefix.toStdString(), loader.toStdString());
+
+		if(!link) {
+			foreach(const Storage::Link& created, links)
+				s->removeLink(created);
+
+			return QList<LinkItem*>();
+		}
+
+		links += link;
+	}
+
+	QList<LinkItem*> items;
+
+	foreach(const Storage::Link& link, links)
+		items += new LinkItem(link);
+
+	root()->insertChildren(items);
+	probeLinks(items);
+	return items;
+}
+
+
 bool LinksModel::removeLink(LinkItem* item)
 {
 	if(!item || item->model() != this)
 		return false;
 
+	QString senderId = item->senderId();
+
 	if(qApp->storage()->removeLink(item->link_)) {
+		unregisterItem(item);
 		delete item->takeFromParent();
+		qApp->startupStats()->clear(senderId);
 		return true;
 	}
 
@@ -297,16 +534,104 @@ bool LinksModel::removeLink(LinkItem* item)
 
 void LinksModel::update()
 {
-	clear();
-
 	Storage* s = qApp->storage();
+	QList<LinkItem*> items;
 
 	auto link = s->link();
 	while(!link.isNull()) {
-		LinkItem* item = new LinkItem(link);
-		root()->insertChild(item);
+		items += new LinkItem(link);
 		link = link.next();
 	}
+
+	itemsByTarget_.clear();
+	resetChildren(items);
+	probeLinks(items);
+}
+
+
+void LinksModel::probeLinks(const QList<LinkItem*>& items)
+{
+	// The items are found by the target path, when the results come, so the target
+	// path is built only once per check.
+	QSet<QString> uniquePaths;
+	foreach(LinkItem* item, items) {
+		unregisterItem(item);
+
+		QString path = item->targetPath();
+		item->probedPath_ = path;
+		itemsByTarget_[path] += item;
+		uniquePaths.insert(path);
+	}
+
+	QStringList paths = uniquePaths.toList();
+
+	for(int i = 0; i < paths.count(); i += kProbeBatchSize) {
+		Prober* prober = new Prober(channel_, paths.mid(i, kProbeBatchSize));
+		QThreadPool::globalInstance()->start(prober);
+	}
+}
+
+
+void LinksModel::processResults()
+{
+	QVector<ProbeResult> results;
+	{
+		QMutexLocker locker(&channel_->mutex);
+		results.swap(channel_->results);
+	}
+
+	foreach(const ProbeResult& result, results) {
+		foreach(LinkItem* item, itemsByTarget_.value(result.path))
+			item->setModuleInfo(result.info);
+	}
+}
+
+
+void LinksModel::unregisterItem(LinkItem* item)
+{
+	if(item->probedPath_.isEmpty())
+		return;
+
+	auto it = itemsByTarget_.find(item->probedPath_);
+	if(it != itemsByTarget_.end()) {
+		it.value().removeOne(item);
+		if(it.value().isEmpty())
+			itemsByTarget_.erase(it);
+	}
+
+	item->probedPath_.clear();
+}
+
+
+void LinksModel::updateStartupStats(const QString& sender)
+{
+	LinkItem* item = root()->firstChild();
+	while(item) {
+		if(item->senderId() == sender)
+			item->updateData();
+
+		item = item->nextSibling();
+	}
+}
+
+
+QString LinksModel::moduleCachePath()
+{
+	QString path = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+	return path + "/" PROJECT_NAME "/modules.cache";
+}
+
+
+QString LinksModel::startupString(LinkItem* item) const
+{
+	StartupStats* stats = qApp->startupStats();
+	if(!stats->contains(item->senderId()))
+		return QString();
+
+	// The average total duration of the instantiation.
+	StartupStats::Entry entry = stats->entry(item->senderId());
+	double seconds = double(entry.sum[0]) / entry.count / 1000000.0;
+	return QString("%1 s").arg(seconds, 0, 'f', 2);
 }
 
 
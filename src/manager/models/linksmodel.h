@@ -1,6 +1,10 @@
 #ifndef MODELS_LINKSMODEL_H
 #define MODELS_LINKSMODEL_H
 
+#include <QHash>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
 #include "common/logger.h"
 #include "common/moduleinfo.h"
 #include "common/storage.h"
@@ -23,6 +27,13 @@ public:
 
 	ModuleInfo::Arch arch() const;
 
+	// Returns false if the VST plugin is missing or doesn't export the VST entry point.
+	// The item is considered valid until its target is checked.
+	bool isValid() const;
+
+	// Absolute path to the VST plugin.
+	QString targetPath() const;
+
 	QString prefix() const;
 	void setPrefix(const QString& prefix);
 
@@ -38,19 +49,39 @@ public:
 	LogLevel logLevel() const;
 	void setLogLevel(LogLevel level);
 
+	// The sender id of the log messages from the plugin endpoint.
+	QString senderId() const;
+
+	int editorRate() const;
+	void setEditorRate(int rate);
+
+	int options() const;
+	void setOptions(int options);
+
 private:
 	friend class LinksModel;
 
 	Storage::Link link_;
 	ModuleInfo::Arch arch_;
+	bool isValid_;
 	LogLevel level_;
+
+	// The target path, the item is registered with in the model for the check results.
+	QString probedPath_;
+
+	void setModuleInfo(const ModuleInfo::Info& info);
+	void probe();
 };
 
 
+// The links are shown right after reading the configuration. Their VST plugins are
+// checked by the thread pool, and the results are kept between sessions in the module
+// cache, so the architecture of the plugins is known before the check is finished.
 class LinksModel : public GenericTreeModel<LinkItem> {
 	Q_OBJECT
 public:
 	LinksModel(QObject* parent = nullptr);
+	~LinksModel();
 
 	int columnCount(const QModelIndex& parent = QModelIndex()) const;
 	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
@@ -61,12 +92,45 @@ public:
 	LinkItem* createLink(const QString& name, const QString& location,
 			const QString& target, const QString& prefix, const QString& loader);
 
+	// Creates the links for all targets at once, the names are taken from the targets.
+	// The colliding names are made unique with the directory of the target and then with
+	// a number. Either all links are created, or none of them.
+	QList<LinkItem*> createLinks(const QStringList& targets, const QString& location,
+			const QString& prefix, const QString& loader);
+
 	bool removeLink(LinkItem* item);
 
 	void update();
 
+	// Checks the VST plugins of the links in the background.
+	void probeLinks(const QList<LinkItem*>& items);
+
 private:
+	struct ProbeResult {
+		QString path;
+		ModuleInfo::Info info;
+	};
+
+	struct Channel;
+	class Prober;
+
+	static const int kProbeBatchSize = 16;
+
+	QSharedPointer<Channel> channel_;
+	QHash<QString, QList<LinkItem*>> itemsByTarget_;
+
+	void unregisterItem(LinkItem* item);
+
+	QString uniqueLinkPath(const QString& target, const QDir& location,
+			QSet<QString>* reservedPaths) const;
+
+	QString startupString(LinkItem* item) const;
 	QString logLevelString(LogLevel level) const;
+	static QString moduleCachePath();
+
+private slots:
+	void processResults();
+	void updateStartupStats(const QString& sender);
 };
 
 
@@ -0,0 +1,196 @@
+#include "logmodel.h"
+
+
+LogModel::LogModel(QObject* parent) :
+	QAbstractListModel(parent),
+	head_(0),
+	count_(0),
+	capacity_(kDefaultCapacity)
+{
+	flushTimer_.setSingleShot(true);
+	flushTimer_.setInterval(kFlushInterval);
+	connect(&flushTimer_, SIGNAL(timeout()), SLOT(flush()));
+}
+
+
+int LogModel::capacity() const
+{
+	return capacity_;
+}
+
+
+void LogModel::setCapacity(int capacity)
+{
+	if(capacity <= 0 || capacity == capacity_)
+		return;
+
+	flush();
+
+	// Keep the most recent messages.
+	beginResetModel();
+
+	QVector<LogEntry> entries;
+	int count = qMin(count_, capacity);
+	entries.reserve(count);
+
+	for(int i = count_ - count; i < count_; ++i)
+		entries.append(entry(i));
+
+	entries_ = entries;
+	head_ = 0;
+	count_ = count;
+	capacity_ = capacity;
+
+	endResetModel();
+}
+
+
+int LogModel::rowCount(const QModelIndex& parent) const
+{
+	return parent.isValid() ? 0 : count_;
+}
+
+
+QVariant LogModel::data(const QModelIndex& index, int role) const
+{
+	if(!index.isValid() || index.row() >= count_)
+		return QVariant();
+
+	const LogEntry& item = entry(index.row());
+
+	switch(role) {
+	case Qt::DisplayRole:
+		if(item.isSeparator)
+			return QString();
+
+		return QString("%1.%2 %3 : %4").arg(item.time >> 32)
+				.arg(item.time & 0xFFFFFFFF, 9, 10, QChar('0'))
+				.arg(item.sender.rightJustified(20, ' ', true)).arg(item.text);
+
+	case kTimeRole:
+		return item.time;
+
+	case kLevelRole:
+		return item.level;
+
+	case kSenderRole:
+		return item.sender;
+
+	case kTextRole:
+		return item.text;
+
+	case kSeparatorRole:
+		return item.isSeparator;
+	}
+
+	return QVariant();
+}
+
+
+const LogEntry& LogModel::entry(int row) const
+{
+	return entries_.at((head_ + row) % entries_.size());
+}
+
+
+void LogModel::addMessage(quint64 time, const QString& sender, const QString& text)
+{
+	LogEntry entry;
+	entry.time = time;
+	entry.level = -1;
+	entry.sender = sender;
+	entry.text = text;
+	entry.isSeparator = false;
+
+	appendPending(entry);
+}
+
+
+void LogModel::addMessages(const QVector<LogMessage>& messages)
+{
+	LogEntry entry;
+	entry.isSeparator = false;
+
+	foreach(const LogMessage& message, messages) {
+		entry.time = message.time;
+		entry.level = message.level;
+		entry.sender = message.sender;
+		entry.text = message.text;
+		appendPending(entry);
+	}
+}
+
+
+void LogModel::addSeparator()
+{
+	LogEntry entry;
+	entry.time = 0;
+	entry.level = -1;
+	entry.isSeparator = true;
+
+	appendPending(entry);
+}
+
+
+void LogModel::clear()
+{
+	flushTimer_.stop();
+	pending_.clear();
+
+	beginResetModel();
+	entries_.clear();
+	head_ = 0;
+	count_ = 0;
+	endResetModel();
+}
+
+
+void LogModel::appendPending(const LogEntry& entry)
+{
+	// The flood of messages can't be shown anyway, so only the last ones are kept.
+	if(pending_.count() >= capacity_ * 2)
+		pending_.remove(0, pending_.count() - capacity_);
+
+	pending_.append(entry);
+
+	if(!flushTimer_.isActive())
+		flushTimer_.start();
+}
+
+
+void LogModel::flush()
+{
+	flushTimer_.stop();
+
+	if(pending_.isEmpty())
+		return;
+
+	int count = qMin(pending_.count(), capacity_);
+
+	// Drop the oldest messages to make room for the new ones.
+	int overflow = count_ + count - capacity_;
+	if(overflow > 0) {
+		beginRemoveRows(QModelIndex(), 0, overflow - 1);
+		head_ = (head_ + overflow) % entries_.size();
+		count_ -= overflow;
+		endRemoveRows();
+	}
+
+	beginInsertRows(QModelIndex(), count_, count_ + count - 1);
+
+	for(int i = pending_.count() - count; i < pending_.count(); ++i) {
+		if(entries_.size() < capacity_) {
+			entries_.append(pending_.at(i));
+		}
+		else {
+			entries_[(head_ + count_) % entries_.size()] = pending_.at(i);
+		}
+
+		count_++;
+	}
+
+	endInsertRows();
+
+	pending_.clear();
+	emit flushed();
+}
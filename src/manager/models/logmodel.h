@@ -0,0 +1,69 @@
+#ifndef MODELS_LOGMODEL_H
+#define MODELS_LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QTimer>
+#include <QVector>
+#include "core/logsocket.h"
+
+
+struct LogEntry {
+	quint64 time;
+	int level;
+	QString sender;
+	QString text;
+	bool isSeparator;
+};
+
+
+// Log messages, stored in the ring buffer of the limited capacity. The messages are
+// accumulated and inserted into the model by batches on the timer, so the attached view
+// is updated at most once per flush interval.
+class LogModel : public QAbstractListModel {
+	Q_OBJECT
+public:
+	enum Role {
+		kTimeRole = Qt::UserRole,
+		kLevelRole,
+		kSenderRole,
+		kTextRole,
+		kSeparatorRole
+	};
+
+	static const int kDefaultCapacity = 100000;
+	static const int kFlushInterval = 40;
+
+	LogModel(QObject* parent = nullptr);
+
+	int capacity() const;
+	void setCapacity(int capacity);
+
+	int rowCount(const QModelIndex& parent = QModelIndex()) const;
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
+	const LogEntry& entry(int row) const;
+
+public slots:
+	void addMessage(quint64 time, const QString& sender, const QString& text);
+	void addMessages(const QVector<LogMessage>& messages);
+	void addSeparator();
+	void clear();
+	void flush();
+
+signals:
+	void flushed();
+
+private:
+	QVector<LogEntry> entries_;
+	int head_;
+	int count_;
+	int capacity_;
+
+	QVector<LogEntry> pending_;
+	QTimer flushTimer_;
+
+	void appendPending(const LogEntry& entry);
+};
+
+
+#endif // MODELS_LOGMODEL_H
@@ -0,0 +1,115 @@
+#include "logstoremodel.h"
+
+#include <algorithm>
+#include "models/logmodel.h"
+
+
+LogStoreModel::LogStoreModel(LogStore* store, QObject* parent) :
+	QAbstractListModel(parent),
+	store_(store),
+	isActive_(false),
+	cache_(kCacheSize)
+{
+	connect(store_, SIGNAL(appended(quint64,quint64)), SLOT(onAppended(quint64,quint64)));
+}
+
+
+LogFilter LogStoreModel::filter() const
+{
+	return filter_;
+}
+
+
+void LogStoreModel::setFilter(const LogFilter& filter)
+{
+	beginResetModel();
+
+	filter_ = filter;
+	isActive_ = !filter.isEmpty();
+	ids_.clear();
+	cache_.clear();
+
+	if(isActive_)
+		ids_ = store_->find(filter_);
+
+	endResetModel();
+}
+
+
+int LogStoreModel::rowCount(const QModelIndex& parent) const
+{
+	return parent.isValid() ? 0 : ids_.count();
+}
+
+
+QVariant LogStoreModel::data(const QModelIndex& index, int role) const
+{
+	if(!index.isValid() || index.row() >= ids_.count())
+		return QVariant();
+
+	quint64 id = ids_.at(index.row());
+	LogRecordInfo* item = cache_.object(id);
+
+	if(!item) {
+		item = new LogRecordInfo;
+
+		// The record could be removed with the rotated segment.
+		if(!store_->record(id, item)) {
+			item->time = 0;
+			item->level = -1;
+		}
+
+		cache_.insert(id, item);
+	}
+
+	switch(role) {
+	case Qt::DisplayRole:
+		return QString("%1.%2 %3 : %4").arg(item->time >> 32)
+				.arg(item->time & 0xFFFFFFFF, 9, 10, QChar('0'))
+				.arg(item->sender.rightJustified(20, ' ', true)).arg(item->text);
+
+	case LogModel::kTimeRole:
+		return item->time;
+
+	case LogModel::kLevelRole:
+		return item->level;
+
+	case LogModel::kSenderRole:
+		return item->sender;
+
+	case LogModel::kTextRole:
+		return item->text;
+
+	case LogModel::kSeparatorRole:
+		return false;
+	}
+
+	return QVariant();
+}
+
+
+void LogStoreModel::onAppended(quint64 firstId, quint64 endId)
+{
+	Q_UNUSED(endId);
+
+	if(!isActive_)
+		return;
+
+	// Forget the records of the removed segments.
+	auto it = std::lower_bound(ids_.begin(), ids_.end(), store_->firstId());
+	int removed = it - ids_.begin();
+
+	if(removed > 0) {
+		beginRemoveRows(QModelIndex(), 0, removed - 1);
+		ids_.remove(0, removed);
+		endRemoveRows();
+	}
+
+	QVector<quint64> ids = store_->find(filter_, firstId);
+	if(ids.isEmpty())
+		return;
+
+	beginInsertRows(QModelIndex(), ids_.count(), ids_.count() + ids.count() - 1);
+	ids_ += ids;
+	endInsertRows();
+}
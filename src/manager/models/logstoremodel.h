@@ -0,0 +1,38 @@
+#ifndef MODELS_LOGSTOREMODEL_H
+#define MODELS_LOGSTOREMODEL_H
+
+#include <QAbstractListModel>
+#include <QCache>
+#include <QVector>
+#include "core/logstore.h"
+
+
+// Records of the log store, that match the filter. Provides the same roles as LogModel,
+// so both models can be shown by the same view. The records are read from the store
+// on demand, only the identifiers of the matched ones are kept.
+class LogStoreModel : public QAbstractListModel {
+	Q_OBJECT
+public:
+	LogStoreModel(LogStore* store, QObject* parent = nullptr);
+
+	LogFilter filter() const;
+	void setFilter(const LogFilter& filter);
+
+	int rowCount(const QModelIndex& parent = QModelIndex()) const;
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
+private:
+	static const int kCacheSize = 2000;
+
+	LogStore* store_;
+	LogFilter filter_;
+	bool isActive_;
+	QVector<quint64> ids_;
+	mutable QCache<quint64, LogRecordInfo> cache_;
+
+private slots:
+	void onAppended(quint64 firstId, quint64 endId);
+};
+
+
+#endif // MODELS_LOGSTOREMODEL_H
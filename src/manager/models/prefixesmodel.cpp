@@ -2,6 +2,7 @@
 
 #include <QIcon>
 #include "core/application.h"
+#include "core/wineserverkeeper.h"
 #include "models/linksmodel.h"
 
 
@@ -56,7 +57,7 @@ PrefixesModel::PrefixesModel(QObject* parent) :
 int PrefixesModel::columnCount(const QModelIndex& parent) const
 {
 	Q_UNUSED(parent);
-	return 2;
+	return 3;
 }
 
 
@@ -70,9 +71,19 @@ QVariant PrefixesModel::data(const QModelIndex& index, int role) const
 				return item->name();
 			}
 			else if(index.column() == 1) {
+				return isServerRunning(item) ? "warm" : "cold";
+			}
+			else if(index.column() == 2) {
 				return item->path();
 			}
 		}
+		else if(role == Qt::ToolTipRole && index.column() == 1) {
+			if(isServerRunning(item))
+				return "The wineserver of the prefix is running";
+
+			return "The wineserver of the prefix isn't running, the next plugin will "
+					"start it";
+		}
 	}
 
 	return QVariant();
@@ -89,6 +100,9 @@ QVariant PrefixesModel::headerData(int section, Qt::Orientation orientation,
 			return "Name";
 		}
 		else if(section == 1) {
+			return "Server";
+		}
+		else if(section == 2) {
 			return "Path";
 		}
 	}
@@ -121,3 +135,22 @@ bool PrefixesModel::removePrefix(PrefixItem* item)
 	delete item->takeFromParent();
 	return true;
 }
+
+
+void PrefixesModel::updateServerState(const QString& path)
+{
+	PrefixItem* item = root()->firstChild();
+	while(item) {
+		if(item->path() == path)
+			item->updateData();
+
+		item = item->nextSibling();
+	}
+}
+
+
+bool PrefixesModel::isServerRunning(PrefixItem* item) const
+{
+	WineServerKeeper* keeper = qApp->wineServers();
+	return keeper && keeper->isRunning(item->path());
+}
@@ -39,6 +39,12 @@ public:
 
 	PrefixItem* createPrefix(const QString& name, const QString& path);
 	bool removePrefix(PrefixItem* item);
+
+private:
+	bool isServerRunning(PrefixItem* item) const;
+
+private slots:
+	void updateServerState(const QString& path);
 };
 
 
@@ -0,0 +1,39 @@
+#include "instancesview.h"
+
+#include <signal.h>
+#include <QAction>
+#include "widgets/nofocusdelegate.h"
+
+
+InstancesView::InstancesView(QWidget* parent) :
+	GenericTreeView<InstancesModel>(parent)
+{
+	setAutoClearSelection(true);
+	setRootIsDecorated(false);
+	setDragEnabled(false);
+	setItemDelegate(new NoFocusDelegate(this));
+
+	dumpStats_ = new QAction(QIcon(":/trace.png"), "Dump latency statistics", this);
+	dumpStats_->setEnabled(false);
+	connect(dumpStats_, SIGNAL(triggered()), SLOT(dumpStats()));
+
+	addAction(dumpStats_);
+	setContextMenuPolicy(Qt::ActionsContextMenu);
+}
+
+
+void InstancesView::currentChangeEvent(InstanceItem* current, InstanceItem* previous)
+{
+	Q_UNUSED(previous);
+	dumpStats_->setEnabled(current);
+}
+
+
+void InstancesView::dumpStats()
+{
+	// All plugin endpoints of the process write their latency histograms to the log
+	// on SIGUSR2.
+	InstanceItem* item = currentItem();
+	if(item)
+		kill(item->pluginPid(), SIGUSR2);
+}
@@ -0,0 +1,27 @@
+#ifndef WIDGETS_INSTANCESVIEW_H
+#define WIDGETS_INSTANCESVIEW_H
+
+#include "models/instancesmodel.h"
+#include "widgets/generictreeview.h"
+
+
+class QAction;
+
+
+class InstancesView : public GenericTreeView<InstancesModel> {
+	Q_OBJECT
+public:
+	InstancesView(QWidget* parent = nullptr);
+
+protected:
+	void currentChangeEvent(InstanceItem* current, InstanceItem* previous);
+
+private:
+	QAction* dumpStats_;
+
+private slots:
+	void dumpStats();
+};
+
+
+#endif // WIDGETS_INSTANCESVIEW_H
@@ -0,0 +1,119 @@
+#include "logdelegate.h"
+
+#include <QAbstractItemView>
+#include <QPainter>
+#include "common/config.h"
+#include "models/logmodel.h"
+
+
+LogDelegate::LogDelegate(QObject* parent) :
+	QStyledItemDelegate(parent),
+	isWordWrap_(true)
+{
+}
+
+
+bool LogDelegate::isWordWrap() const
+{
+	return isWordWrap_;
+}
+
+
+void LogDelegate::setWordWrap(bool enabled)
+{
+	isWordWrap_ = enabled;
+}
+
+
+void LogDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option,
+		const QModelIndex& index) const
+{
+	painter->save();
+
+	if(option.state & QStyle::State_Selected)
+		painter->fillRect(option.rect, option.palette.highlight().color().lighter(170));
+
+	if(index.data(LogModel::kSeparatorRole).toBool()) {
+		int y = option.rect.center().y();
+		painter->setPen(QColor(0x909090));
+		painter->drawLine(option.rect.left() + 2, y, option.rect.right() - 2, y);
+		painter->restore();
+		return;
+	}
+
+	painter->setFont(option.font);
+	QFontMetrics metrics(option.font);
+	QRect rect = option.rect.adjusted(2, 0, -2, 0);
+
+	quint64 time = index.data(LogModel::kTimeRole).toULongLong();
+	QString timeString = QString("%1.%2 ").arg(time >> 32)
+			.arg(time & 0xFFFFFFFF, 9, 10, QChar('0'));
+
+	painter->setPen(QColor(0x909090));
+	painter->drawText(rect, Qt::AlignLeft | Qt::AlignTop, timeString);
+	rect.setLeft(rect.left() + metrics.width(timeString));
+
+	QString sender = index.data(LogModel::kSenderRole).toString();
+
+	if(sender == HOST_BASENAME || sender.endsWith(".dll")) {
+		painter->setPen(QColor(0x804000));
+	}
+	else {
+		painter->setPen(QColor(0x004080));
+	}
+
+	QString senderString = sender.rightJustified(20, ' ', true) + " : ";
+	painter->drawText(rect, Qt::AlignLeft | Qt::AlignTop, senderString);
+	rect.setLeft(rect.left() + metrics.width(senderString));
+
+	int flags = Qt::AlignLeft | Qt::AlignTop;
+	if(isWordWrap_)
+		flags |= Qt::TextWrapAnywhere;
+
+	// The log level is 'error'.
+	if(index.data(LogModel::kLevelRole).toInt() == 1) {
+		painter->setPen(QColor(0xA00000));
+	}
+	else {
+		painter->setPen(QColor(0x222222));
+	}
+
+	painter->drawText(rect, flags, index.data(LogModel::kTextRole).toString());
+
+	painter->restore();
+}
+
+
+QSize LogDelegate::sizeHint(const QStyleOptionViewItem& option,
+		const QModelIndex& index) const
+{
+	QFontMetrics metrics(option.font);
+	int prefix = prefixWidth(metrics);
+
+	if(index.data(LogModel::kSeparatorRole).toBool())
+		return QSize(prefix, metrics.height());
+
+	QString text = index.data(LogModel::kTextRole).toString();
+
+	if(!isWordWrap_)
+		return QSize(prefix + metrics.width(text), metrics.height());
+
+	// The text is wrapped by the width of the view.
+	int width = option.rect.width();
+
+	const QAbstractItemView* view = qobject_cast<const QAbstractItemView*>(option.widget);
+	if(view)
+		width = view->viewport()->width();
+
+	width = qMax(width - prefix - 4, metrics.averageCharWidth() * 20);
+
+	QRect rect = metrics.boundingRect(0, 0, width, 0, Qt::TextWrapAnywhere, text);
+	return QSize(prefix + rect.width(), qMax(rect.height(), metrics.height()));
+}
+
+
+int LogDelegate::prefixWidth(const QFontMetrics& metrics) const
+{
+	// The time stamp and the sender have the fixed width with a monospace font.
+	return metrics.width(QString(20, '0') + ' ' + QString(20, ' ') + " : ") + 4;
+}
@@ -0,0 +1,30 @@
+#ifndef WIDGETS_LOGDELEGATE_H
+#define WIDGETS_LOGDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+
+// Paints the log message as the colored time, sender and text columns. The colors are
+// applied at paint time, so the model stores just plain strings.
+class LogDelegate : public QStyledItemDelegate {
+	Q_OBJECT
+public:
+	explicit LogDelegate(QObject* parent = nullptr);
+
+	bool isWordWrap() const;
+	void setWordWrap(bool enabled);
+
+	void paint(QPainter* painter, const QStyleOptionViewItem& option,
+			   const QModelIndex& index) const;
+
+	QSize sizeHint(const QStyleOptionViewItem& option,
+				   const QModelIndex& index) const;
+
+private:
+	bool isWordWrap_;
+
+	int prefixWidth(const QFontMetrics& metrics) const;
+};
+
+
+#endif // WIDGETS_LOGDELEGATE_H
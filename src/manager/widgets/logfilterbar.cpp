@@ -0,0 +1,123 @@
+#include "logfilterbar.h"
+
+#include <QComboBox>
+#include <QDateTime>
+#include <QHBoxLayout>
+#include "widgets/lineedit.h"
+
+
+LogFilterBar::LogFilterBar(LogStore* store, QWidget* parent) :
+	QWidget(parent),
+	store_(store)
+{
+	textEdit_ = new LineEdit;
+	textEdit_->setToolTip("Search the stored messages (case insensitive)");
+	textEdit_->setPlaceholderText("Search in the stored log");
+	textEdit_->setButtonEnabled(true);
+	textEdit_->setButtonStyle(LineEdit::kTransparent);
+	textEdit_->setButtonIcon(QIcon(":/erase.png"));
+	textEdit_->setButtonToolTip("Clear");
+	textEdit_->setAutoClearMode(true);
+	textEdit_->setEditTimeout(300);
+	connect(textEdit_, SIGNAL(textEditTimeout(QString)), SLOT(emitFilterChanged()));
+
+	levelCombo_ = new QComboBox;
+	levelCombo_->setToolTip("Show the stored messages up to the log level");
+	levelCombo_->addItem("any level", -1);
+	levelCombo_->addItem(QIcon(":/warning.png"), "error", 1);
+	levelCombo_->addItem(QIcon(":/trace.png"), "trace", 2);
+	levelCombo_->addItem(QIcon(":/bug.png"), "debug", 3);
+	levelCombo_->addItem(QIcon(":/scull.png"), "flood", 4);
+	connect(levelCombo_, SIGNAL(activated(int)), SLOT(emitFilterChanged()));
+
+	senderCombo_ = new QComboBox;
+	senderCombo_->setToolTip("Show the stored messages of the sender");
+	senderCombo_->setSizeAdjustPolicy(QComboBox::AdjustToContents);
+	senderCombo_->addItem("any sender");
+	connect(senderCombo_, SIGNAL(activated(int)), SLOT(emitFilterChanged()));
+
+	periodCombo_ = new QComboBox;
+	periodCombo_->setToolTip("Show the stored messages of the period");
+	periodCombo_->addItem("all time", kAllTime);
+	periodCombo_->addItem("current session", kCurrentSession);
+	periodCombo_->addItem("last hour", kLastHour);
+	periodCombo_->addItem("last 24 hours", kLastDay);
+	connect(periodCombo_, SIGNAL(activated(int)), SLOT(emitFilterChanged()));
+
+	QHBoxLayout* layout = new QHBoxLayout;
+	layout->setMargin(2);
+	layout->addWidget(textEdit_, 1);
+	layout->addWidget(levelCombo_);
+	layout->addWidget(senderCombo_);
+	layout->addWidget(periodCombo_);
+	setLayout(layout);
+
+	connect(store_, SIGNAL(appended(quint64,quint64)), SLOT(updateSenders()));
+	updateSenders();
+}
+
+
+LogFilter LogFilterBar::filter() const
+{
+	LogFilter filter;
+	filter.text = textEdit_->text();
+	filter.maxLevel = levelCombo_->currentData().toInt();
+
+	if(senderCombo_->currentIndex() > 0)
+		filter.sender = senderCombo_->currentText();
+
+	quint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+
+	switch(periodCombo_->currentData().toInt()) {
+	case kCurrentSession:
+		filter.fromId = store_->sessionId();
+
+		// The empty filter means the live log.
+		if(filter.fromId == 0)
+			filter.fromTime = 1;
+		break;
+
+	case kLastHour:
+		filter.fromTime = (now - 3600) << 32;
+		break;
+
+	case kLastDay:
+		filter.fromTime = (now - 24 * 3600) << 32;
+		break;
+	}
+
+	return filter;
+}
+
+
+void LogFilterBar::reset()
+{
+	textEdit_->clear();
+	levelCombo_->setCurrentIndex(0);
+	senderCombo_->setCurrentIndex(0);
+	periodCombo_->setCurrentIndex(0);
+	emitFilterChanged();
+}
+
+
+void LogFilterBar::updateSenders()
+{
+	QStringList senders = store_->senders();
+	if(senders.count() == senderCombo_->count() - 1)
+		return;
+
+	QString current = senderCombo_->currentText();
+
+	senderCombo_->clear();
+	senderCombo_->addItem("any sender");
+	senderCombo_->addItems(senders);
+
+	int index = senderCombo_->findText(current);
+	senderCombo_->setCurrentIndex(qMax(index, 0));
+}
+
+
+void LogFilterBar::emitFilterChanged()
+{
+	emit filterChanged(filter());
+}
@@ -0,0 +1,45 @@
+#ifndef WIDGETS_LOGFILTERBAR_H
+#define WIDGETS_LOGFILTERBAR_H
+
+#include <QWidget>
+#include "core/logstore.h"
+
+
+class QComboBox;
+class LineEdit;
+
+
+class LogFilterBar : public QWidget {
+	Q_OBJECT
+public:
+	enum Period {
+		kAllTime,
+		kCurrentSession,
+		kLastHour,
+		kLastDay
+	};
+
+	LogFilterBar(LogStore* store, QWidget* parent = nullptr);
+
+	LogFilter filter() const;
+
+public slots:
+	void reset();
+
+signals:
+	void filterChanged(const LogFilter& filter);
+
+private:
+	LogStore* store_;
+	LineEdit* textEdit_;
+	QComboBox* levelCombo_;
+	QComboBox* senderCombo_;
+	QComboBox* periodCombo_;
+
+private slots:
+	void updateSenders();
+	void emitFilterChanged();
+};
+
+
+#endif // WIDGETS_LOGFILTERBAR_H
@@ -1,22 +1,67 @@
+#include <QApplication>
+#include <QClipboard>
+#include <QKeyEvent>
 #include <QScrollBar>
-#include <QStringBuilder>
-#include <QTime>
 #include "logview.h"
-#include "common/config.h"
+#include "models/logmodel.h"
+#include "models/logstoremodel.h"
+#include "widgets/logdelegate.h"
 
 
 LogView::LogView(QWidget* parent) :
-	QTextEdit(parent),
-	isAutoScroll_(true),
-	isWordWrap_(true)
+	QListView(parent),
+	model_(new LogModel(this)),
+	storeModel_(nullptr),
+	delegate_(new LogDelegate(this)),
+	isAutoScroll_(true)
 {
-	setReadOnly(true);
-
 	QFont font("Monospace");
 	font.setStyleHint(QFont::TypeWriter);
 	setFont(font);
 
-	setWordWrap(isWordWrap_);
+	setModel(model_);
+	setItemDelegate(delegate_);
+	setSelectionMode(ExtendedSelection);
+	setEditTriggers(NoEditTriggers);
+	setResizeMode(Adjust);
+
+	// Only the visible rows are laid out and painted, so the view stays responsive
+	// with the large number of messages.
+	setLayoutMode(Batched);
+	setBatchSize(1000);
+
+	// The wrapped rows are measured one by one on every flush, so the wrapping is off
+	// by default to keep the uniform row heights.
+	setWordWrap(false);
+
+	connect(model_, SIGNAL(flushed()), SLOT(onFlushed()));
+}
+
+
+LogModel* LogView::logModel() const
+{
+	return model_;
+}
+
+
+void LogView::setLogStore(LogStore* store)
+{
+	if(storeModel_) {
+		setModel(model_);
+		delete storeModel_;
+	}
+
+	storeModel_ = new LogStoreModel(store, this);
+
+	connect(storeModel_,
+			SIGNAL(rowsInserted(QModelIndex,int,int)),
+			SLOT(onFlushed()));
+}
+
+
+bool LogView::isFiltered() const
+{
+	return storeModel_ && model() == storeModel_;
 }
 
 
@@ -28,7 +73,7 @@ bool LogView::isAutoScroll() const
 
 bool LogView::isWordWrap() const
 {
-	return isWordWrap_;
+	return delegate_->isWordWrap();
 }
 
 
@@ -40,52 +85,73 @@ void LogView::setAutoScroll(bool enabled)
 
 void LogView::setWordWrap(bool enabled)
 {
-	isWordWrap_ = enabled;
+	delegate_->setWordWrap(enabled);
 
-	if(isWordWrap_) {
-		setWordWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
-	}
-	else {
-		setWordWrapMode(QTextOption::NoWrap);
-	}
+	// Unwrapped rows have the same height, which allows to skip their measuring.
+	setUniformItemSizes(!enabled);
+	QListView::setWordWrap(enabled);
+	doItemsLayout();
 }
 
 
 void LogView::addMessage(quint64 time, const QString& sender, const QString& text)
 {
-	setTextColor(QColor(0x909090));
-	insertPlainText(QString::number(time >> 32));
-	insertPlainText(".");
-	insertPlainText(QString::number(time & 0xFFFFFFFF).rightJustified(9, '0'));
-	insertPlainText(" ");
-
-	if(sender == HOST_BASENAME || sender.endsWith(".dll")) {
-		setTextColor(QColor(0x804000));
-	}
-	else {
-		setTextColor(QColor(0x004080));
-	}
+	model_->addMessage(time, sender, text);
+}
 
-	insertPlainText(sender.rightJustified(20, ' ', true));
 
-	insertPlainText(" : ");
+void LogView::addMessages(const QVector<LogMessage>& messages)
+{
+	model_->addMessages(messages);
+}
 
-	setTextColor(0x222222);
-	insertPlainText(text);
-	insertPlainText("\n");
 
-	if(isAutoScroll_) {
-		int maximum = verticalScrollBar()->maximum();
-		verticalScrollBar()->setValue(maximum);
-	}
+void LogView::addSeparator()
+{
+	model_->addSeparator();
 }
 
 
-void LogView::addSeparator()
+void LogView::clear()
 {
-	insertHtml("<hr><br>");
-	if(isAutoScroll_) {
-		int maximum = verticalScrollBar()->maximum();
-		verticalScrollBar()->setValue(maximum);
+	model_->clear();
+}
+
+
+void LogView::setFilter(const LogFilter& filter)
+{
+	if(!storeModel_)
+		return;
+
+	// The live log is shown without the filter, the stored one otherwise.
+	storeModel_->setFilter(filter);
+	setModel(filter.isEmpty() ? static_cast<QAbstractItemModel*>(model_) : storeModel_);
+
+	if(isAutoScroll_)
+		scrollToBottom();
+}
+
+
+void LogView::keyPressEvent(QKeyEvent* event)
+{
+	if(event->matches(QKeySequence::Copy)) {
+		QModelIndexList indexes = selectionModel()->selectedRows();
+		qSort(indexes);
+
+		QStringList lines;
+		foreach(const QModelIndex& index, indexes)
+			lines += index.data().toString();
+
+		QApplication::clipboard()->setText(lines.join('\n'));
+		return;
 	}
+
+	QListView::keyPressEvent(event);
+}
+
+
+void LogView::onFlushed()
+{
+	if(isAutoScroll_)
+		scrollToBottom();
 }
@@ -1,14 +1,26 @@
 #ifndef WIDGETS_LOGVIEW_H
 #define WIDGETS_LOGVIEW_H
 
-#include <QTextEdit>
+#include <QListView>
+#include "core/logsocket.h"
+#include "core/logstore.h"
 
 
-class LogView : public QTextEdit {
+class LogDelegate;
+class LogModel;
+class LogStoreModel;
+
+
+class LogView : public QListView {
 	Q_OBJECT
 public:
 	LogView(QWidget* parent = nullptr);
 
+	LogModel* logModel() const;
+
+	void setLogStore(LogStore* store);
+	bool isFiltered() const;
+
 	bool isAutoScroll() const;
 	bool isWordWrap() const;
 
@@ -16,11 +28,22 @@ public slots:
 	void setAutoScroll(bool enabled);
 	void setWordWrap(bool enabled);
 	void addMessage(quint64 time, const QString& sender, const QString& text);
+	void addMessages(const QVector<LogMessage>& messages);
 	void addSeparator();
+	void clear();
+	void setFilter(const LogFilter& filter);
+
+protected:
+	void keyPressEvent(QKeyEvent* event);
 
 private:
+	LogModel* model_;
+	LogStoreModel* storeModel_;
+	LogDelegate* delegate_;
 	bool isAutoScroll_;
-	bool isWordWrap_;
+
+private slots:
+	void onFlushed();
 };
 
 
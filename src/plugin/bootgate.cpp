@@ -0,0 +1,202 @@
+#include "bootgate.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "common/config.h"
+
+
+namespace Airwave {
+
+
+static i64 monotonicMsecs()
+{
+	timespec tm;
+	clock_gettime(CLOCK_MONOTONIC, &tm);
+	return static_cast<i64>(tm.tv_sec) * 1000 + tm.tv_nsec / 1000000;
+}
+
+
+static std::string prefixKey(const std::string& prefixPath)
+{
+	// FNV-1a hash
+	u64 hash = 0xcbf29ce484222325ULL;
+	for(char c : prefixPath) {
+		hash ^= static_cast<u8>(c);
+		hash *= 0x100000001b3ULL;
+	}
+
+	char buffer[32];
+	std::snprintf(buffer, sizeof(buffer), "%016llx",
+			static_cast<unsigned long long>(hash));
+
+	return buffer;
+}
+
+
+BootGate::BootGate() :
+	slotFd_(-1)
+{
+}
+
+
+BootGate::~BootGate()
+{
+	release();
+}
+
+
+std::string BootGate::directory()
+{
+	const char* string = getenv("TMPDIR");
+	std::string path = string ? string : "/tmp";
+	path += "/" PROJECT_NAME "-boot-" + std::to_string(getuid());
+
+	if(mkdir(path.c_str(), 0700) != 0 && errno != EEXIST)
+		return std::string();
+
+	// Don't use the directory, that was created by someone else.
+	struct stat st;
+	if(lstat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid())
+		return std::string();
+
+	return path;
+}
+
+
+bool BootGate::acquire(const std::string& prefixPath, int limit, int msecs)
+{
+	release();
+
+	if(limit <= 0)
+		return true;
+
+	std::string path = directory();
+	if(path.empty())
+		return false;
+
+	path += '/' + prefixKey(prefixPath);
+
+	int queueFd = open((path + ".queue").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if(queueFd < 0)
+		return false;
+
+	i64 deadline = monotonicMsecs() + msecs;
+	bool isAcquired = false;
+
+	if(enqueue(queueFd, true)) {
+		for(;;) {
+			// Only the first waiter competes for the slots, so the boots are started in
+			// the order of arrival.
+			if(isFirst(queueFd)) {
+				for(int i = 0; i < limit && !isAcquired; ++i) {
+					std::string slotPath = path + '.' + std::to_string(i);
+					int fd = open(slotPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+					if(fd < 0)
+						continue;
+
+					if(flock(fd, LOCK_EX | LOCK_NB) == 0) {
+						slotFd_ = fd;
+						isAcquired = true;
+					}
+					else {
+						close(fd);
+					}
+				}
+			}
+
+			if(isAcquired || monotonicMsecs() >= deadline)
+				break;
+
+			usleep(kPollInterval * 1000);
+		}
+
+		enqueue(queueFd, false);
+	}
+
+	close(queueFd);
+	return isAcquired;
+}
+
+
+void BootGate::release()
+{
+	if(slotFd_ >= 0) {
+		close(slotFd_);
+		slotFd_ = -1;
+	}
+}
+
+
+// Adds or removes the calling thread, the waiters of the dead processes are removed too.
+bool BootGate::enqueue(int fd, bool isAdded)
+{
+	if(flock(fd, LOCK_EX) != 0)
+		return false;
+
+	std::vector<Waiter> waiters;
+
+	struct stat st;
+	if(fstat(fd, &st) == 0 && st.st_size > 0) {
+		waiters.resize(st.st_size / sizeof(Waiter));
+		ssize_t size = pread(fd, waiters.data(), waiters.size() * sizeof(Waiter), 0);
+		waiters.resize(size > 0 ? size / sizeof(Waiter) : 0);
+	}
+
+	Waiter self;
+	self.pid = getpid();
+	self.tid = syscall(SYS_gettid);
+
+	auto it = std::remove_if(waiters.begin(), waiters.end(), [&self](const Waiter& w) {
+		return (w.pid == self.pid && w.tid == self.tid) ||
+				(kill(w.pid, 0) != 0 && errno == ESRCH);
+	});
+
+	waiters.erase(it, waiters.end());
+
+	if(isAdded)
+		waiters.push_back(self);
+
+	size_t size = waiters.size() * sizeof(Waiter);
+	bool result = ftruncate(fd, 0) == 0 && (size == 0 ||
+			pwrite(fd, waiters.data(), size, 0) == static_cast<ssize_t>(size));
+
+	flock(fd, LOCK_UN);
+	return result;
+}
+
+
+bool BootGate::isFirst(int fd)
+{
+	if(flock(fd, LOCK_SH) != 0)
+		return false;
+
+	Waiter first;
+	bool result = false;
+
+	for(off_t offset = 0; pread(fd, &first, sizeof(first), offset) == sizeof(first);
+			offset += sizeof(first)) {
+		// The waiter of the crashed process would block the queue until the next
+		// enqueue(), so it is skipped here.
+		if(kill(first.pid, 0) != 0 && errno == ESRCH)
+			continue;
+
+		result = first.pid == getpid() && first.tid == syscall(SYS_gettid);
+		break;
+	}
+
+	flock(fd, LOCK_UN);
+	return result;
+}
+
+
+} // namespace Airwave
@@ -0,0 +1,52 @@
+#ifndef PLUGIN_BOOTGATE_H
+#define PLUGIN_BOOTGATE_H
+
+#include <string>
+#include "common/types.h"
+
+
+namespace Airwave {
+
+
+// Limits the number of the host processes, booting in the same WINE prefix at once, for
+// all plugin endpoints of the user. When a project with many bridged plugins is loaded,
+// the parallel boots contend for the wineserver, the disk and the CPU, so the controlled
+// ramp finishes earlier.
+//
+// Every boot slot is a file lock, so the slot of the crashed process is released by the
+// kernel. The waiters are admitted in the order of arrival, which is kept in the queue
+// file as the list of their process and thread ids.
+class BootGate {
+public:
+	BootGate();
+	~BootGate();
+
+	BootGate(const BootGate&) = delete;
+	BootGate& operator=(const BootGate&) = delete;
+
+	// Waits for a free boot slot of the prefix. Returns false, if the slot wasn't
+	// acquired in time, the boot shouldn't be delayed any further then.
+	bool acquire(const std::string& prefixPath, int limit, int msecs);
+	void release();
+
+private:
+	struct Waiter {
+		i32 pid;
+		i32 tid;
+	};
+
+	static const int kPollInterval = 5;
+
+	int slotFd_;
+
+	static std::string directory();
+
+	bool enqueue(int fd, bool isAdded);
+	bool isFirst(int fd);
+};
+
+
+} // namespace Airwave
+
+
+#endif // PLUGIN_BOOTGATE_H
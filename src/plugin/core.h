@@ -0,0 +1,24 @@
+#ifndef PLUGIN_CORE_H
+#define PLUGIN_CORE_H
+
+#include "common/vst24.h"
+
+
+namespace Airwave {
+
+
+// Entry point of the bridge core library, called by the per-link plugin stub. The stub
+// passes the path of its own binary, which identifies the link. The version is increased
+// on every incompatible change of the entry point, so the outdated stubs are rejected
+// instead of crashing the VST host.
+static const int kCoreInterfaceVersion = 1;
+static const char* const kCoreEntryName = "airwaveCreateEndpoint";
+
+typedef AEffect* (*CoreEntryProc)(int version, const char* linkPath,
+		AudioMasterProc audioMasterProc);
+
+
+} // namespace Airwave
+
+
+#endif // PLUGIN_CORE_H
@@ -1,12 +1,15 @@
 #include <string>
-#include <dlfcn.h>
 #include <signal.h>
+#include "core.h"
 #include "plugin.h"
+#include "startupprofile.h"
 #include "common/config.h"
 #include "common/filesystem.h"
+#include "common/linkindex.h"
 #include "common/logger.h"
 #include "common/moduleinfo.h"
 #include "common/storage.h"
+#include "common/timeline.h"
 
 
 using namespace Airwave;
@@ -14,8 +17,9 @@ using namespace Airwave;
 
 extern "C" {
 
-AEffect* VSTPluginMain(AudioMasterProc audioMasterProc);
-AEffect* mainStub(AudioMasterProc audioMasterProc) asm ("main");
+__attribute__((visibility("default")))
+AEffect* airwaveCreateEndpoint(int version, const char* linkPath,
+		AudioMasterProc audioMasterProc);
 
 }
 
@@ -25,59 +29,128 @@ void signalHandler(int signum)
 	if(signum == SIGCHLD) {
 		TRACE("Child process terminated");
 	}
+	else if(signum == SIGUSR2) {
+		Plugin::requestStatsDump();
+	}
 	else {
 		TRACE("Received signal %d", signum);
 	}
 }
 
 
-AEffect* VSTPluginMain(AudioMasterProc audioMasterProc)
+// Reads the link from the configuration file. It's used only if the link index is
+// missing or outdated, because the whole configuration file is parsed.
+static LinkIndex::Result readStorage(const std::string& path, LinkIndex::Config* config,
+		LinkIndex::Link* link)
+{
+	Storage storage;
+	config->logSocketPath = storage.logSocketPath();
+	config->binariesPath = storage.binariesPath();
+	config->defaultLogLevel = storage.defaultLogLevel();
+	config->processDeadline = storage.processDeadline();
+	config->hostKeepAlive = storage.hostKeepAlive();
+	config->bootLimit = storage.bootLimit();
+
+	if(path.empty())
+		return LinkIndex::kNotFound;
+
+	Storage::Link storageLink = storage.link(path);
+	if(!storageLink)
+		return LinkIndex::kNotFound;
+
+	link->target = storageLink.target();
+	link->prefix = storageLink.prefix();
+	link->loader = storageLink.loader();
+	link->level = storageLink.logLevel();
+	link->editorRate = storageLink.editorRate();
+	link->options = storageLink.options();
+
+	Storage::Prefix prefix = storage.prefix(link->prefix);
+	if(!prefix.isNull())
+		link->prefixPath = prefix.path();
+
+	Storage::Loader loader = storage.loader(link->loader);
+	if(!loader.isNull())
+		link->loaderPath = loader.path();
+
+	return LinkIndex::kFound;
+}
+
+
+static AEffect* createPluginEndpoint(int version, const char* linkPath,
+		AudioMasterProc audioMasterProc)
 {
+	StartupProfile profile;
+
 	// FIXME Without this signal handler the Renoise tracker is unable to start the child
 	// winelib application.
 	signal(SIGCHLD, signalHandler);
 
-	Storage storage;
-	loggerInit(storage.logSocketPath(), PLUGIN_BASENAME);
+	// SIGUSR2 requests the round trip latency statistics dump from all plugin endpoints
+	// of the process. Don't override the handler, if the VST host uses this signal.
+	struct sigaction action;
+	if(sigaction(SIGUSR2, nullptr, &action) == 0 && action.sa_handler == SIG_DFL)
+		signal(SIGUSR2, signalHandler);
+
+	// The path to the stub binary is the key of the link
+	bool hasFileName = linkPath != nullptr;
+	std::string selfPath = hasFileName ? FileSystem::realPath(linkPath) : "";
+
+	// Get the linked VST plugin binary and the settings, the logger should be
+	// initialized with.
+	LinkIndex::Config config;
+	LinkIndex::Link link;
+
+	LinkIndex::Result result = LinkIndex::instance()->lookup(selfPath, &config, &link);
+	bool isIndexed = result != LinkIndex::kUnavailable;
+
+	if(!isIndexed)
+		result = readStorage(selfPath, &config, &link);
 
-	// Get path to own binary
-	Dl_info info;
-	if(dladdr(reinterpret_cast<void*>(VSTPluginMain), &info) == 0) {
+	loggerInit(config.logSocketPath, PLUGIN_BASENAME);
+	Timeline::initialize(PLUGIN_BASENAME);
+
+	if(version != kCoreInterfaceVersion) {
+		ERROR("Plugin stub interface version %d is not supported, update the links",
+				version);
+		return nullptr;
+	}
+
+	if(!hasFileName) {
 		ERROR("Unable to get library filename");
 		return nullptr;
 	}
 
-	std::string selfPath = FileSystem::realPath(info.dli_fname);
 	if(selfPath.empty()) {
-		ERROR("Unable to get an absolute path of the plugin binary", selfPath.c_str());
+		ERROR("Unable to get an absolute path of the plugin binary");
 		return nullptr;
 	}
 
-	// Get path of the linked VST plugin binary
-	Storage::Link link = storage.link(selfPath);
-	if(!link) {
+	if(result != LinkIndex::kFound) {
 		ERROR("Link '%s' is corrupted", selfPath.c_str());
 		return nullptr;
 	}
 
-	LogLevel level = link.logLevel();
+	LogLevel level = link.level;
 	if(level == LogLevel::kDefault)
-		level = storage.defaultLogLevel();
+		level = config.defaultLogLevel;
 
-	loggerSetSenderId(FileSystem::baseName(info.dli_fname));
-	loggerSetLogLevel(level);
+	// The logger is shared by all links, so the sender id and the log level belong to
+	// the endpoint, not to the process.
+	std::string senderId = FileSystem::baseName(linkPath);
+	LogContext logContext(senderId, level);
+	LogScope logScope(&logContext);
 
 	TRACE("Initializing plugin endpoint %s", VERSION_STRING);
-	TRACE("Plugin binary: %s", selfPath.c_str());
+	TRACE("Plugin stub:   %s", selfPath.c_str());
+	DEBUG("Link is read from the %s", isIndexed ? "index" : "configuration file");
 
-	std::string winePrefix = link.prefix();
-	Storage::Prefix prefix = storage.prefix(winePrefix);
-	if(!prefix) {
-		ERROR("Invalid WINE prefix '%s'", winePrefix.c_str());
+	if(link.prefixPath.empty()) {
+		ERROR("Invalid WINE prefix '%s'", link.prefix.c_str());
 		return nullptr;
 	}
 
-	std::string prefixPath = FileSystem::realPath(prefix.path());
+	std::string prefixPath = FileSystem::realPath(link.prefixPath);
 	if(!FileSystem::isDirExists(prefixPath)) {
 		ERROR("WINE prefix directory '%s' doesn't exists", prefixPath.c_str());
 		return nullptr;
@@ -85,14 +158,12 @@ AEffect* VSTPluginMain(AudioMasterProc audioMasterProc)
 
 	TRACE("WINE prefix:   %s", prefixPath.c_str());
 
-	std::string wineLoader = link.loader();
-	Storage::Loader loader = storage.loader(wineLoader);
-	if(!loader) {
-		ERROR("Invalid WINE loader '%s'", wineLoader.c_str());
+	if(link.loaderPath.empty()) {
+		ERROR("Invalid WINE loader '%s'", link.loader.c_str());
 		return nullptr;
 	}
 
-	std::string loaderPath = FileSystem::realPath(loader.path());
+	std::string loaderPath = FileSystem::realPath(link.loaderPath);
 	if(!FileSystem::isFileExists(loaderPath)) {
 		ERROR("WINE loader binary '%s' doesn't exists", loaderPath.c_str());
 		return nullptr;
@@ -100,7 +171,7 @@ AEffect* VSTPluginMain(AudioMasterProc audioMasterProc)
 
 	TRACE("WINE loader:   %s", loaderPath.c_str());
 
-	std::string vstPath = prefixPath + '/' + link.target();
+	std::string vstPath = prefixPath + '/' + link.target;
 	if(!FileSystem::isFileExists(vstPath)) {
 		ERROR("VST binary '%s' doesn't exists", vstPath.c_str());
 		return nullptr;
@@ -108,14 +179,16 @@ AEffect* VSTPluginMain(AudioMasterProc audioMasterProc)
 
 	TRACE("VST binary:    %s", vstPath.c_str());
 
+	profile.end(StartupProfile::kConfig);
+
 	// Find host binary path
-	ModuleInfo::Arch arch = ModuleInfo::instance()->getArch(vstPath);
+	ModuleInfo::Info moduleInfo = ModuleInfo::instance()->getInfo(vstPath);
 
 	std::string hostName;
-	if(arch == ModuleInfo::kArch64) {
+	if(moduleInfo.arch == ModuleInfo::kArch64) {
 		hostName = HOST_BASENAME "-64.exe";
 	}
-	else if(arch == ModuleInfo::kArch32) {
+	else if(moduleInfo.arch == ModuleInfo::kArch32) {
 		hostName = HOST_BASENAME "-32.exe";
 	}
 	else {
@@ -123,7 +196,12 @@ AEffect* VSTPluginMain(AudioMasterProc audioMasterProc)
 		return nullptr;
 	}
 
-	std::string hostPath = FileSystem::realPath(storage.binariesPath() + '/' + hostName);
+	profile.end(StartupProfile::kArch);
+
+	if(!moduleInfo.hasVstEntry)
+		TRACE("VST binary doesn't export VSTPluginMain or main, loading it anyway");
+
+	std::string hostPath = FileSystem::realPath(config.binariesPath + '/' + hostName);
 	if(!FileSystem::isFileExists(hostPath)) {
 		ERROR("Host binary '%s' doesn't exists", hostPath.c_str());
 		return nullptr;
@@ -140,22 +218,41 @@ AEffect* VSTPluginMain(AudioMasterProc audioMasterProc)
 		TRACE("Log level:     debug");
 	}
 
+	HostOptions hostOptions;
+	hostOptions.editorRate = link.editorRate;
+	hostOptions.flushDenormals = (link.options & Storage::kFlushDenormals) != 0;
+	hostOptions.countDenormals = (link.options & Storage::kCountDenormals) != 0;
+
 	// Initialize plugin endpoint
 	Plugin* plugin;
-	plugin = new Plugin(vstPath, hostPath, prefixPath, loaderPath,
-			storage.logSocketPath(), audioMasterProc);
+	plugin = new Plugin(vstPath, hostPath, prefixPath, loaderPath, config.logSocketPath,
+			senderId, level, hostOptions, config.bootLimit, profile, audioMasterProc);
 	if(!plugin->effect()) {
 		ERROR("Unable to initialize plugin endpoint");
+		delete plugin;
 		return nullptr;
 	}
 
+	plugin->setProcessDeadline(config.processDeadline);
+	plugin->setHostKeepAlive(config.hostKeepAlive);
+	plugin->setOutputFilter((link.options & Storage::kSanitizeOutput) != 0,
+			(link.options & Storage::kClampOutput) != 0);
+
 	TRACE("Plugin endpoint is initialized");
 	return plugin->effect();
 }
 
 
-// Deprecated main() stub which is still used by some hosts
-AEffect* mainStub(AudioMasterProc audioMasterProc)
+AEffect* airwaveCreateEndpoint(int version, const char* linkPath,
+		AudioMasterProc audioMasterProc)
 {
-	return VSTPluginMain(audioMasterProc);
+	AEffect* effect = createPluginEndpoint(version, linkPath, audioMasterProc);
+
+	// The plugin endpoint releases the logger on effClose. If the endpoint wasn't
+	// created, its reference is released here, so the drain thread is stopped, when no
+	// endpoint is left. The core itself is never unloaded.
+	if(!effect)
+		loggerFree();
+
+	return effect;
 }
@@ -0,0 +1,173 @@
+#include "outputfilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace Airwave {
+
+
+// Handles the tail of the block and the builds without SSE2.
+template<typename T>
+static void copyOutputScalar(T* dest, const T* source, int count, T limit, T* peak,
+		T* squareSum, u64* nonFiniteCount, u64* clippedCount)
+{
+	for(int i = 0; i < count; ++i) {
+		T value = source[i];
+
+		if(!std::isfinite(value)) {
+			value = 0;
+			(*nonFiniteCount)++;
+		}
+		else if(std::fabs(value) > limit) {
+			value = value > 0 ? limit : -limit;
+			(*clippedCount)++;
+		}
+
+		*peak = std::max(*peak, std::fabs(value));
+		*squareSum += value * value;
+		dest[i] = value;
+	}
+}
+
+
+void copyOutput(float* dest, const float* source, int count, float limit,
+		OutputLevel* level)
+{
+	float peak = 0.0f;
+	float squareSum = 0.0f;
+	u64 nonFiniteCount = 0;
+	u64 clippedCount = 0;
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 maxValue = _mm_set1_ps(std::numeric_limits<float>::max());
+	const __m128 upper = _mm_set1_ps(limit);
+	const __m128 lower = _mm_set1_ps(-limit);
+
+	__m128 peaks = _mm_setzero_ps();
+	__m128 squares = _mm_setzero_ps();
+	__m128i nonFinites = _mm_setzero_si128();
+	__m128i clips = _mm_setzero_si128();
+
+	for(; i + 4 <= count; i += 4) {
+		__m128 value = _mm_loadu_ps(source + i);
+
+		// The comparison is false for NaN, so both NaN and infinity are caught here.
+		__m128 isNonFinite = _mm_cmpnle_ps(_mm_and_ps(value, absMask), maxValue);
+		value = _mm_andnot_ps(isNonFinite, value);
+
+		__m128 magnitude = _mm_and_ps(value, absMask);
+		__m128 isClipped = _mm_cmpgt_ps(magnitude, upper);
+		value = _mm_min_ps(_mm_max_ps(value, lower), upper);
+		magnitude = _mm_min_ps(magnitude, upper);
+
+		peaks = _mm_max_ps(peaks, magnitude);
+		squares = _mm_add_ps(squares, _mm_mul_ps(value, value));
+
+		// The true lanes of the masks are -1.
+		nonFinites = _mm_sub_epi32(nonFinites, _mm_castps_si128(isNonFinite));
+		clips = _mm_sub_epi32(clips, _mm_castps_si128(isClipped));
+
+		_mm_storeu_ps(dest + i, value);
+	}
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, peaks);
+	peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+
+	_mm_storeu_ps(lanes, squares);
+	squareSum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+	i32 counters[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(counters), nonFinites);
+	nonFiniteCount = u32(counters[0]) + u32(counters[1]) + u32(counters[2]) +
+			u32(counters[3]);
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(counters), clips);
+	clippedCount = u32(counters[0]) + u32(counters[1]) + u32(counters[2]) +
+			u32(counters[3]);
+#endif
+
+	copyOutputScalar(dest + i, source + i, count - i, limit, &peak, &squareSum,
+			&nonFiniteCount, &clippedCount);
+
+	level->peak = std::max(level->peak, double(peak));
+	level->squareSum += squareSum;
+	level->nonFiniteCount += nonFiniteCount;
+	level->clippedCount += clippedCount;
+}
+
+
+void copyOutput(double* dest, const double* source, int count, double limit,
+		OutputLevel* level)
+{
+	double peak = 0.0;
+	double squareSum = 0.0;
+	u64 nonFiniteCount = 0;
+	u64 clippedCount = 0;
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+	const __m128d maxValue = _mm_set1_pd(std::numeric_limits<double>::max());
+	const __m128d upper = _mm_set1_pd(limit);
+	const __m128d lower = _mm_set1_pd(-limit);
+
+	__m128d peaks = _mm_setzero_pd();
+	__m128d squares = _mm_setzero_pd();
+	__m128i nonFinites = _mm_setzero_si128();
+	__m128i clips = _mm_setzero_si128();
+
+	for(; i + 2 <= count; i += 2) {
+		__m128d value = _mm_loadu_pd(source + i);
+
+		__m128d isNonFinite = _mm_cmpnle_pd(_mm_and_pd(value, absMask), maxValue);
+		value = _mm_andnot_pd(isNonFinite, value);
+
+		__m128d magnitude = _mm_and_pd(value, absMask);
+		__m128d isClipped = _mm_cmpgt_pd(magnitude, upper);
+		value = _mm_min_pd(_mm_max_pd(value, lower), upper);
+		magnitude = _mm_min_pd(magnitude, upper);
+
+		peaks = _mm_max_pd(peaks, magnitude);
+		squares = _mm_add_pd(squares, _mm_mul_pd(value, value));
+
+		nonFinites = _mm_sub_epi64(nonFinites, _mm_castpd_si128(isNonFinite));
+		clips = _mm_sub_epi64(clips, _mm_castpd_si128(isClipped));
+
+		_mm_storeu_pd(dest + i, value);
+	}
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, peaks);
+	peak = std::max(lanes[0], lanes[1]);
+
+	_mm_storeu_pd(lanes, squares);
+	squareSum = lanes[0] + lanes[1];
+
+	u64 counters[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(counters), nonFinites);
+	nonFiniteCount = counters[0] + counters[1];
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(counters), clips);
+	clippedCount = counters[0] + counters[1];
+#endif
+
+	copyOutputScalar(dest + i, source + i, count - i, limit, &peak, &squareSum,
+			&nonFiniteCount, &clippedCount);
+
+	level->peak = std::max(level->peak, peak);
+	level->squareSum += squareSum;
+	level->nonFiniteCount += nonFiniteCount;
+	level->clippedCount += clippedCount;
+}
+
+
+} // namespace Airwave
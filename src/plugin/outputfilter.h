@@ -0,0 +1,33 @@
+#ifndef PLUGIN_OUTPUTFILTER_H
+#define PLUGIN_OUTPUTFILTER_H
+
+#include "common/types.h"
+
+
+namespace Airwave {
+
+
+// Level of the output channel, accumulated by copyOutput() over the blocks.
+struct OutputLevel {
+	double peak;
+	double squareSum;
+	u64 nonFiniteCount;
+	u64 clippedCount;
+};
+
+
+// Copies the output channel from the audio port to the buffer of the VST host in a
+// single pass. The NaN and infinite samples are replaced by zero, the samples beyond the
+// limit are clamped to it, and the peak and the sum of squares of the copied samples are
+// accumulated. Pass the infinity as the limit to disable the clamping.
+void copyOutput(float* dest, const float* source, int count, float limit,
+		OutputLevel* level);
+
+void copyOutput(double* dest, const double* source, int count, double limit,
+		OutputLevel* level);
+
+
+} // namespace Airwave
+
+
+#endif // PLUGIN_OUTPUTFILTER_H
@@ -1,27 +1,186 @@
 #include "plugin.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <ctime>
+#include <limits>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include "common/filesystem.h"
+#include "common/hostpark.h"
 #include "common/logger.h"
 #include "common/protocol.h"
+#include "common/timeline.h"
 
 
 #define XEMBED_EMBEDDED_NOTIFY	0
 #define XEMBED_FOCUS_OUT		5
 #define kVstExtMaxParamStrLen	24
 
+// Maximum time to wait for each step of the editor window embedding. When the event
+// doesn't come, the embedding just continues, as it was done with the fixed delays.
+#define kEmbedTimeout			100
+
+// Maximum time to wait for the boot slot of the WINE prefix, in milliseconds. The host
+// endpoint is started anyway after this time, so the stuck boot can't block others.
+#define kBootQueueTimeout		120000
+
+// The clamped output of the sanitizer stays within +12 dBFS, so the usual overs pass
+// through, while the runaway feedback can't blow up the bus of the VST host.
+#define kOutputLimit			4.0f
+
+// Duration of the output meter window, in seconds. It matches the refresh interval of
+// the airwave-manager, so no peak is missed.
+#define kOutputMeterWindow		1
+
 namespace Airwave {
 
 
+std::atomic<int> Plugin::statsRequests_(0);
+static std::atomic<int> instanceCount(0);
+
+
+// Starts the host endpoint without fork(). The page tables of the VST host could be huge,
+// and the copy-on-write faults after fork() would hit its audio threads. posix_spawn()
+// uses vfork semantics, so everything, the child needs, is prepared before the call.
+// The launcher script, generated by winegcc, is bypassed and the WINE loader is executed
+// directly, if the winelib binary is found next to the script.
+static pid_t spawnHost(const std::string& hostPath, const std::string& loaderPath,
+		const std::string& prefixPath, const std::vector<std::string>& hostArgs,
+		const std::vector<std::string>& extraEnv)
+{
+	std::vector<std::string> args;
+	std::vector<std::string> env;
+
+	std::string libraryPath = hostPath + ".so";
+	std::string path;
+
+	if(FileSystem::isFileExists(libraryPath)) {
+		path = loaderPath;
+		args.push_back(loaderPath);
+		args.push_back(libraryPath);
+
+		// The launcher script adds its directory to the DLL search path.
+		std::string dllPath = hostPath.substr(0, hostPath.rfind('/'));
+		const char* value = getenv("WINEDLLPATH");
+		if(value && *value)
+			dllPath = dllPath + ':' + value;
+
+		env.push_back("WINEDLLPATH=" + dllPath);
+	}
+	else {
+		path = "/bin/sh";
+		args.push_back("/bin/sh");
+		args.push_back(hostPath);
+	}
+
+	args.insert(args.end(), hostArgs.begin(), hostArgs.end());
+
+	env.push_back("WINEPREFIX=" + prefixPath);
+	env.push_back("WINELOADER=" + loaderPath);
+	env.insert(env.end(), extraEnv.begin(), extraEnv.end());
+
+	// Copy the environment of the VST host, except the overridden variables.
+	for(char** var = environ; *var; ++var) {
+		const char* separator = std::strchr(*var, '=');
+		if(!separator)
+			continue;
+
+		size_t length = separator - *var + 1;
+		bool isOverridden = false;
+
+		for(const std::string& item : env) {
+			if(item.compare(0, length, *var, length) == 0) {
+				isOverridden = true;
+				break;
+			}
+		}
+
+		if(!isOverridden)
+			env.push_back(*var);
+	}
+
+	std::vector<char*> argv;
+	for(std::string& arg : args)
+		argv.push_back(&arg[0]);
+
+	argv.push_back(nullptr);
+
+	std::vector<char*> envp;
+	for(std::string& item : env)
+		envp.push_back(&item[0]);
+
+	envp.push_back(nullptr);
+
+	// The VST host could block signals in the calling thread and ignore some of them,
+	// the host endpoint should start with the default state.
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+
+	sigset_t signals;
+	sigemptyset(&signals);
+	posix_spawnattr_setsigmask(&attr, &signals);
+
+	sigaddset(&signals, SIGPIPE);
+	sigaddset(&signals, SIGCHLD);
+	sigaddset(&signals, SIGUSR2);
+	posix_spawnattr_setsigdefault(&attr, &signals);
+
+	short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_USEVFORK
+	flags |= POSIX_SPAWN_USEVFORK;
+#endif
+	posix_spawnattr_setflags(&attr, flags);
+
+	pid_t pid;
+	int result = posix_spawn(&pid, path.c_str(), nullptr, &attr, argv.data(),
+			envp.data());
+
+	posix_spawnattr_destroy(&attr);
+
+	if(result != 0) {
+		ERROR("Unable to start %s: %s", path.c_str(), std::strerror(result));
+		return -1;
+	}
+
+	return pid;
+}
+
+
 Plugin::Plugin(const std::string& vstPath, const std::string& hostPath,
 		const std::string& prefixPath, const std::string& loaderPath,
-		const std::string& logSocketPath, AudioMasterProc masterProc) :
+		const std::string& logSocketPath, const std::string& senderId,
+		LogLevel logLevel, const HostOptions& hostOptions, int bootLimit,
+		const StartupProfile& profile, AudioMasterProc masterProc) :
+	logContext_(senderId, logLevel),
 	masterProc_(masterProc),
 	effect_(nullptr),
 	data_(nullptr),
 	dataLength_(0),
 	childPid_(-1),
+	display_(nullptr),
+	xembedAtom_(None),
+	xembedInfoAtom_(None),
+	isEditorObscured_(false),
+	isEditorVisible_(false),
+	hostKeepAlive_(0),
+	isChildProcess_(true),
+	isHostParked_(false),
+	processDeadline_(0),
+	sampleRate_(0.0f),
+	isResponsePending_(false),
+	xrunCount_(0),
+	droppedCount_(0),
+	isOutputSanitized_(false),
+	outputLimit_(std::numeric_limits<float>::infinity()),
+	meterFrameCount_(0),
+	profile_(profile),
+	stats_(nullptr),
+	statsGeneration_(0),
 	processCallbacks_(ATOMIC_FLAG_INIT),
 	mainThreadId_(std::this_thread::get_id()),
 	lastIndex_(-1),
@@ -30,8 +189,21 @@ Plugin::Plugin(const std::string& vstPath, const std::string& hostPath,
 	// The constructor will return early when error occurs. In this case the effect()
 	// fucntion will be returning nullptr, indicating the error.
 
+	LogScope logScope(&logContext_);
 	DEBUG("Main thread id: %p", mainThreadId_);
 
+	std::memset(outputLevels_, 0, sizeof(outputLevels_));
+	Timeline::setThreadName("VST host main thread");
+
+	for(int i = 0; i < kEditorWindowCount; ++i) {
+		editorWindows_[i] = None;
+		isEditorMapped_[i] = false;
+	}
+
+	statsGeneration_ = statsRequests_;
+	controlPort_.setLatencyStats(&latencyStats_);
+	audioPort_.setLatencyStats(&latencyStats_);
+
 	// FIXME: frame size should be verified.
 	if(!controlPort_.create(65536)) {
 		ERROR("Unable to create control port");
@@ -45,30 +217,65 @@ Plugin::Plugin(const std::string& vstPath, const std::string& hostPath,
 		return;
 	}
 
+	// The host endpoint saves its part of the timeline into the separate file, which is
+	// merged with the events of this process, when the plugin is closed.
+	if(Timeline::isEnabled()) {
+		timelinePartPath_ = Timeline::directory() + "/host-" + std::to_string(getpid()) +
+				'-' + std::to_string(instanceCount++) + ".part";
+	}
+
+	// The timeline part of the host endpoint is written on its exit, so the parked
+	// process can't be used while the timeline is recorded.
+	if(timelinePartPath_.empty()) {
+		parkName_ = HostPark::name(vstPath, prefixPath, loaderPath);
+
+		childPid_ = HostPark::adopt(parkName_, controlPort_.id(),
+				static_cast<int>(logContext_.logLevel()));
+
+		if(childPid_ != -1) {
+			isChildProcess_ = false;
+			TRACE("Parked host endpoint is adopted, pid=%d", childPid_);
+		}
+	}
+
 	// Start the host endpoint's process.
-	childPid_ = fork();
 	if(childPid_ == -1) {
-		ERROR("fork() call failed");
-		controlPort_.disconnect();
-		callbackPort_.disconnect();
-		return;
-	}
-	else if(childPid_ == 0) {
-		setenv("WINEPREFIX", prefixPath.c_str(), 1);
-		setenv("WINELOADER", loaderPath.c_str(), 1);
+		profile_.end(StartupProfile::kSpawn);
 
-		std::string id = std::to_string(controlPort_.id());
-		std::string level = std::to_string(static_cast<int>(loggerLogLevel()));
+		if(bootLimit > 0) {
+			DEBUG("Waiting for the boot slot of the WINE prefix...");
 
-		execl("/bin/sh", "/bin/sh", hostPath.c_str(), vstPath.c_str(), id.c_str(),
-				level.c_str(), logSocketPath.c_str(), nullptr);
+			if(!bootGate_.acquire(prefixPath, bootLimit, kBootQueueTimeout))
+				TRACE("Boot slot of the WINE prefix isn't acquired, booting anyway");
 
-		// We should never reach this point on success child execution.
-		ERROR("execl() call failed");
-		return;
+			profile_.end(StartupProfile::kQueue);
+		}
+
+		std::vector<std::string> hostArgs;
+		hostArgs.push_back(vstPath);
+		hostArgs.push_back(std::to_string(controlPort_.id()));
+		hostArgs.push_back(std::to_string(static_cast<int>(logContext_.logLevel())));
+		hostArgs.push_back(logSocketPath);
+
+		std::vector<std::string> extraEnv;
+		if(!timelinePartPath_.empty())
+			extraEnv.push_back(std::string(Timeline::kPartEnv) + '=' + timelinePartPath_);
+
+		if(!parkName_.empty())
+			extraEnv.push_back(std::string(HostPark::kNameEnv) + '=' + parkName_);
+
+		childPid_ = spawnHost(hostPath, loaderPath, prefixPath, hostArgs, extraEnv);
+		if(childPid_ == -1) {
+			bootGate_.release();
+			controlPort_.disconnect();
+			callbackPort_.disconnect();
+			return;
+		}
+
+		DEBUG("Child process started, pid=%d", childPid_);
 	}
 
-	DEBUG("Child process started, pid=%d", childPid_);
+	profile_.end(StartupProfile::kSpawn);
 
 	std::memset(&rect_, 0, sizeof(ERect));
 
@@ -77,25 +284,45 @@ Plugin::Plugin(const std::string& vstPath, const std::string& hostPath,
 
 	condition_.wait();
 
+	// Claim the live statistics slot, which is shared with the host endpoint.
+	StatsRegistry* registry = StatsRegistry::instance();
+	if(registry->open())
+		stats_ = registry->acquire(logContext_.senderId());
+
+	if(!stats_)
+		DEBUG("Live statistics are unavailable");
+
 	// Send host info to the host endpoint.
 	DataFrame* frame = controlPort_.frame<DataFrame>();
 	frame->command = Command::HostInfo;
 	frame->opcode = callbackPort_.id();
+	frame->index = registry->indexOf(stats_);
+	std::memcpy(frame->data, &hostOptions, sizeof(HostOptions));
 	controlPort_.sendRequest();
 
 	TRACE("Waiting response from host endpoint...");
 
 	// Wait for the host endpoint initialization.
-	if(!controlPort_.waitResponse()) {
+	bool isResponded = controlPort_.waitResponse();
+	bootGate_.release();
+
+	if(!isResponded) {
 		ERROR("Host endpoint is not responding");
 		kill(childPid_, SIGKILL);
 		controlPort_.disconnect();
 		callbackPort_.disconnect();
-		childPid_ = -1;
+		registry->release(stats_);
+		stats_ = nullptr;
 		return;
 	}
 
 	PluginInfo* info = reinterpret_cast<PluginInfo*>(frame->data);
+
+	// The rest of the handshake is counted as a part of VSTPluginMain(), since the host
+	// endpoint calls the VST plugin once more before the response.
+	profile_.addHostTimings(*reinterpret_cast<HostTimings*>(info + 1));
+	profile_.end(StartupProfile::kVstMain);
+
 	effect_ = new AEffect;
 	std::memset(effect_, 0, sizeof(AEffect));
 
@@ -116,6 +343,8 @@ Plugin::Plugin(const std::string& vstPath, const std::string& hostPath,
 	effect_->uniqueID               = info->uniqueId;
 	effect_->version                = info->version;
 
+	parameterValues_.assign(std::max(effect_->numParams, 0), 0.0f);
+
 	DEBUG("VST plugin summary:");
 	DEBUG("  flags:         0x%08X", effect_->flags);
 	DEBUG("  program count: %d",     effect_->numPrograms);
@@ -130,6 +359,7 @@ Plugin::Plugin(const std::string& vstPath, const std::string& hostPath,
 
 Plugin::~Plugin()
 {
+	LogScope logScope(&logContext_);
 	TRACE("Waiting for callback thread termination...");
 
 	processCallbacks_.clear();
@@ -140,10 +370,44 @@ Plugin::~Plugin()
 	callbackPort_.disconnect();
 	audioPort_.disconnect();
 
-	TRACE("Waiting for child process termination...");
+	if(isHostParked_) {
+		// Nobody waits for the parked process, so it is reaped in the background.
+		if(isChildProcess_) {
+			int pid = childPid_;
+			std::thread([pid]() {
+				int status;
+				waitpid(pid, &status, 0);
+			}).detach();
+		}
+	}
+	else if(isChildProcess_ && childPid_ > 0) {
+		// The killed host endpoint of the failed instantiation is reaped here too.
+		TRACE("Waiting for child process termination...");
 
-	int status;
-	waitpid(childPid_, &status, 0);
+		int status;
+		waitpid(childPid_, &status, 0);
+	}
+
+	StatsRegistry::instance()->release(stats_);
+
+	if(!timelinePartPath_.empty()) {
+		std::string name = logContext_.senderId();
+		if(name.size() > 3 && name.compare(name.size() - 3, 3, ".so") == 0)
+			name.resize(name.size() - 3);
+
+		std::string path = Timeline::directory() + '/' + name + '-' +
+				std::to_string(getpid()) + '-' + std::to_string(childPid_) + ".json";
+
+		if(Timeline::exportTrace(path, timelinePartPath_)) {
+			TRACE("Timeline is written to %s", path.c_str());
+		}
+		else {
+			ERROR("Unable to write the timeline to %s", path.c_str());
+		}
+	}
+
+	if(display_)
+		XCloseDisplay(display_);
 
 	if(effect_)
 		delete effect_;
@@ -158,9 +422,49 @@ AEffect* Plugin::effect()
 }
 
 
+int Plugin::processDeadline() const
+{
+	return processDeadline_;
+}
+
+
+void Plugin::setProcessDeadline(int percent)
+{
+	processDeadline_ = percent;
+}
+
+
+void Plugin::setOutputFilter(bool isSanitized, bool isClamped)
+{
+	isOutputSanitized_ = isSanitized;
+	outputLimit_ = isClamped ? kOutputLimit : std::numeric_limits<float>::infinity();
+}
+
+
+int Plugin::hostKeepAlive() const
+{
+	return hostKeepAlive_;
+}
+
+
+void Plugin::setHostKeepAlive(int seconds)
+{
+	hostKeepAlive_ = seconds;
+}
+
+
+void Plugin::requestStatsDump()
+{
+	// Called from the signal handler, so it must be async-signal-safe.
+	statsRequests_++;
+}
+
+
 void Plugin::callbackThread()
 {
+	LogScope logScope(&logContext_);
 	TRACE("Callback thread started");
+	Timeline::setThreadName("Plugin callback thread");
 
 	condition_.post();
 
@@ -178,11 +482,15 @@ void Plugin::callbackThread()
 
 intptr_t Plugin::setBlockSize(DataPort* port, intptr_t frames)
 {
-	size_t frameSize = sizeof(DataFrame) + sizeof(double) *
-			(frames * effect_->numInputs + frames * effect_->numOutputs);
+	size_t frameSize = sizeof(DataFrame) + sizeof(double) * channelStride<double>(frames) *
+			(effect_->numInputs + effect_->numOutputs);
+
+	if(stats_)
+		stats_->blockSize = frames;
 
 	if(audioPort_.frameSize() < frameSize) {
 		DEBUG("Setting block size to %d frames", frames);
+		syncAudioPort(true);
 		audioPort_.disconnect();
 
 		if(!audioPort_.create(frameSize)) {
@@ -203,9 +511,145 @@ intptr_t Plugin::setBlockSize(DataPort* port, intptr_t frames)
 }
 
 
+void Plugin::dumpStats(DataPort* port)
+{
+	latencyStats_.dump("Plugin endpoint");
+
+	DataFrame* frame = port->frame<DataFrame>();
+	frame->command = Command::DumpStats;
+	port->sendRequest();
+	port->waitResponse();
+}
+
+
+bool Plugin::syncAudioPort(bool wait)
+{
+	if(!isResponsePending_)
+		return true;
+
+	// The host endpoint is still processing the request, which has missed its
+	// deadline. Its response should be consumed first, otherwise the next request would
+	// get the stale response.
+	if(!audioPort_.waitResponse(wait ? -1 : 0))
+		return false;
+
+	isResponsePending_ = false;
+	return true;
+}
+
+
+bool Plugin::acquireAudioPort(const char* request)
+{
+	if(syncAudioPort(false))
+		return true;
+
+	droppedCount_++;
+
+	// Same as with the xruns, only the first drop and every power of two of them are
+	// reported.
+	if((droppedCount_ & (droppedCount_ - 1)) == 0) {
+		ERROR("Audio port is busy, dropping %s request (dropped: %llu)", request,
+				droppedCount_);
+	}
+
+	return false;
+}
+
+
+void Plugin::countXrun()
+{
+	xrunCount_++;
+
+	// Report only the first xrun and then every power of two of them to avoid flooding
+	// the log from the audio thread.
+	if((xrunCount_ & (xrunCount_ - 1)) == 0)
+		ERROR("Host endpoint missed the process deadline (xruns: %llu)", xrunCount_);
+}
+
+
+bool Plugin::waitProcessResponse(const timespec& start, i32 count)
+{
+	if(processDeadline_ <= 0 || sampleRate_ <= 0.0f) {
+		audioPort_.waitResponse();
+		return true;
+	}
+
+	i64 timeout = static_cast<i64>(count * 1e9 / sampleRate_) * processDeadline_ / 100;
+
+	timespec deadline;
+	deadline.tv_sec  = start.tv_sec + timeout / 1000000000;
+	deadline.tv_nsec = start.tv_nsec + timeout % 1000000000;
+
+	if(deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	if(audioPort_.waitResponseUntil(deadline))
+		return true;
+
+	isResponsePending_ = true;
+	countXrun();
+	return false;
+}
+
+
+void Plugin::updateProcessStats(const timespec& start, bool isCompleted)
+{
+	if(!stats_)
+		return;
+
+	statsAdd(&stats_->blockCount, 1);
+	statsStore(&stats_->xrunCount, xrunCount_);
+
+	if(isCompleted) {
+		u64 elapsed = monotonicTime() - (static_cast<u64>(start.tv_sec) * 1000000000 +
+				start.tv_nsec);
+
+		statsAdd(&stats_->roundTripSum, elapsed);
+		statsMax(&stats_->roundTripMax, elapsed);
+	}
+}
+
+
+void Plugin::updateOutputLevels(i32 count)
+{
+	meterFrameCount_ += count;
+
+	float sampleRate = sampleRate_ > 0.0f ? sampleRate_ : 44100.0f;
+	if(meterFrameCount_ < sampleRate * kOutputMeterWindow)
+		return;
+
+	if(stats_) {
+		int channelCount = std::min(effect_->numOutputs, kStatsMeterChannels);
+		u64 nonFiniteCount = 0;
+		u64 clippedCount = 0;
+
+		for(int i = 0; i <= kStatsMeterChannels; ++i) {
+			const OutputLevel& level = outputLevels_[i];
+			nonFiniteCount += level.nonFiniteCount;
+			clippedCount += level.clippedCount;
+
+			if(i < channelCount) {
+				stats_->outputPeak[i] = level.peak;
+				stats_->outputRms[i] = std::sqrt(level.squareSum / meterFrameCount_);
+			}
+		}
+
+		stats_->meterChannelCount = channelCount;
+		statsAdd(&stats_->nonFiniteOutputs, nonFiniteCount);
+		statsAdd(&stats_->clippedOutputs, clippedCount);
+	}
+
+	std::memset(outputLevels_, 0, sizeof(outputLevels_));
+	meterFrameCount_ = 0;
+}
+
+
 intptr_t Plugin::handleAudioMaster()
 {
 	DataFrame* frame = callbackPort_.frame<DataFrame>();
+	TimelineScope scope("Plugin::handleAudioMaster", kAudioMasterEvents[frame->opcode]);
 
 	if(frame->opcode != audioMasterGetTime && frame->opcode != audioMasterIdle) {
 		FLOOD("(%p) handleAudioMaster(opcode: %s, index: %d, value: %d, opt: %g)",
@@ -296,6 +740,26 @@ intptr_t Plugin::dispatch(DataPort* port, i32 opcode, i32 index, intptr_t value,
 	if(opcode != effEditIdle && opcode)
 		FLOOD("(%p) dispatch: %s", std::this_thread::get_id(), kDispatchEvents[opcode]);
 
+	// The audio threads never wait for the late process response, except for effClose,
+	// which destroys the plugin.
+	if(port == &audioPort_) {
+		if(opcode == effClose)
+			syncAudioPort(true);
+		else if(!acquireAudioPort(kDispatchEvents[opcode]))
+			return 0;
+	}
+
+	// The statistics dump is requested asynchronously (with SIGUSR2), but it is performed
+	// in the main thread, since only this thread is allowed to use the control port.
+	if(port == &controlPort_ && statsGeneration_ != statsRequests_) {
+		statsGeneration_ = statsRequests_;
+		dumpStats(port);
+	}
+
+	// The editor state is reported before the request, since it uses the same frame.
+	if(port == &controlPort_ && display_)
+		updateEditorState();
+
 	DataFrame* frame = port->frame<DataFrame>();
 	frame->command = Command::Dispatch;
 	frame->opcode  = opcode;
@@ -311,18 +775,23 @@ intptr_t Plugin::dispatch(DataPort* port, i32 opcode, i32 index, intptr_t value,
 		return 1;
 
 	case effOpen: {
+		profile_.begin();
+
 		port->sendRequest();
 		port->waitResponse();
 		int result = frame->value;
 
+		profile_.end(StartupProfile::kOpen);
+
 		setBlockSize(port, 256);
+
+		profile_.end(StartupProfile::kSetBlockSize);
+		profile_.report();
 		return result; }
 
 	case effGetVstVersion:
 	case effGetPlugCategory:
-	case effSetSampleRate:
 	case effGetVendorVersion:
-	case effEditClose:
 	case effMainsChanged:
 	case effCanBeAutomated:
 	case effGetProgram:
@@ -344,10 +813,37 @@ intptr_t Plugin::dispatch(DataPort* port, i32 opcode, i32 index, intptr_t value,
 		port->waitResponse();
 		return frame->value;
 
+	case effSetSampleRate:
+		sampleRate_ = opt;
+		if(stats_)
+			stats_->sampleRate = opt;
+
+		port->sendRequest();
+		port->waitResponse();
+		return frame->value;
+
 	case effClose:
 		port->sendRequest();
 		port->waitResponse();
 
+		if(port == &controlPort_ && hostKeepAlive_ > 0 && !parkName_.empty()) {
+			frame->command = Command::Park;
+			frame->value = hostKeepAlive_;
+			port->sendRequest();
+			isHostParked_ = port->waitResponse();
+		}
+
+		if(xrunCount_)
+			TRACE("Process deadline was missed %llu times", xrunCount_);
+
+		if(droppedCount_)
+			TRACE("Audio port requests were dropped %llu times", droppedCount_);
+
+		// The plugin could be closed without being opened, report what was measured.
+		profile_.report();
+
+		latencyStats_.dump("Plugin endpoint");
+
 		TRACE("Closing plugin");
 		delete this;
 		loggerFree();
@@ -357,7 +853,11 @@ intptr_t Plugin::dispatch(DataPort* port, i32 opcode, i32 index, intptr_t value,
 		return setBlockSize(port, value);
 
 	case effEditOpen: {
-		Display* display = XOpenDisplay(nullptr);
+		if(!openDisplay()) {
+			ERROR("Unable to open X display");
+			return 0;
+		}
+
 		Window parent = reinterpret_cast<Window>(ptr);
 
 		port->sendRequest();
@@ -377,32 +877,61 @@ intptr_t Plugin::dispatch(DataPort* port, i32 opcode, i32 index, intptr_t value,
 
 		DEBUG("Requested window size: %dx%d", width, height);
 
-		XResizeWindow(display, parent, width, height);
-		XSync(display, false);
+		Window child = frame->value;
 
-		// FIXME without this delay, the VST window sometimes stays black.
-		usleep(100000);
+		// Drop the events, left from the previously opened editor.
+		XSync(display_, true);
+
+		XSelectInput(display_, parent, StructureNotifyMask);
+		XSelectInput(display_, child, StructureNotifyMask | PropertyChangeMask);
+
+		// The VST window sometimes stays black, if it is reparented before the parent
+		// is resized.
+		Window root;
+		int x, y;
+		unsigned int parentWidth, parentHeight, border, depth;
+		XGetGeometry(display_, parent, &root, &x, &y, &parentWidth, &parentHeight,
+				&border, &depth);
+
+		if(static_cast<int>(parentWidth) != width ||
+				static_cast<int>(parentHeight) != height) {
+			XResizeWindow(display_, parent, width, height);
+			if(!waitWindowEvent(parent, ConfigureNotify))
+				DEBUG("Parent window resize isn't confirmed");
+		}
 
-		Window child = frame->value;
-		XReparentWindow(display, child, parent, 0, 0);
+		XReparentWindow(display_, child, parent, 0, 0);
+		if(!waitWindowEvent(child, ReparentNotify))
+			DEBUG("Editor window reparenting isn't confirmed");
 
-		sendXembedMessage(display, child, XEMBED_EMBEDDED_NOTIFY, 0, parent, 0);
-		sendXembedMessage(display, child, XEMBED_FOCUS_OUT, 0, 0, 0);
+		sendXembedMessage(child, XEMBED_EMBEDDED_NOTIFY, 0, parent, 0);
+		sendXembedMessage(child, XEMBED_FOCUS_OUT, 0, 0, 0);
 
 		frame->command = Command::ShowWindow;
 		port->sendRequest();
 		port->waitResponse();
 
-		// FIXME without this delay, the VST window sometimes stays black.
-		usleep(100000);
-
-		XMapWindow(display, child);
-		XSync(display, false);
+		// WINE doesn't map the embedded window by itself, it sets the XEMBED_MAPPED flag
+		// of the _XEMBED_INFO property instead and leaves the mapping to the embedder.
+		if(!waitWindowEvent(child, PropertyNotify, xembedInfoAtom_))
+			DEBUG("Editor window XEMBED info isn't updated");
 
-		XCloseDisplay(display);
+		XMapWindow(display_, child);
+		if(!waitWindowEvent(child, MapNotify))
+			DEBUG("Editor window mapping isn't confirmed");
 
+		watchEditor(child, parent);
 		return frame->value; }
 
+	case effEditClose:
+		// The windows aren't touched here, the parent could be already destroyed.
+		editorWindows_[0] = None;
+		isEditorVisible_ = false;
+
+		port->sendRequest();
+		port->waitResponse();
+		return frame->value;
+
 	case effEditGetRect: {
 		port->sendRequest();
 		port->waitResponse();
@@ -588,6 +1117,9 @@ intptr_t Plugin::dispatch(DataPort* port, i32 opcode, i32 index, intptr_t value,
 
 		DEBUG("effGetChunk: received %d bytes", chunkSize);
 
+		if(stats_)
+			statsAdd(&stats_->chunkBytes, chunkSize);
+
 		void** chunk = static_cast<void**>(ptr);
 		*chunk = static_cast<void*>(chunk_.data());
 		return chunkSize; }
@@ -625,6 +1157,9 @@ intptr_t Plugin::dispatch(DataPort* port, i32 opcode, i32 index, intptr_t value,
 
 		DEBUG("effSetChunk: sent %d bytes", chunkSize);
 
+		if(stats_)
+			statsAdd(&stats_->chunkBytes, chunkSize);
+
 		return frame->value; }
 
 	case effBeginLoadBank:
@@ -654,15 +1189,179 @@ intptr_t Plugin::dispatch(DataPort* port, i32 opcode, i32 index, intptr_t value,
 }
 
 
-void Plugin::sendXembedMessage(Display* display, Window window, long message, long detail,
-		long data1, long data2)
+bool Plugin::openDisplay()
+{
+	if(display_)
+		return true;
+
+	display_ = XOpenDisplay(nullptr);
+	if(!display_)
+		return false;
+
+	xembedAtom_ = XInternAtom(display_, "_XEMBED", false);
+	xembedInfoAtom_ = XInternAtom(display_, "_XEMBED_INFO", false);
+	return true;
+}
+
+
+struct EventFilter {
+	Window window;
+	int type;
+	Atom property;
+};
+
+
+static Bool matchEvent(Display* display, XEvent* event, XPointer arg)
+{
+	(void) display;
+	const EventFilter* filter = reinterpret_cast<const EventFilter*>(arg);
+
+	if(event->type != filter->type || event->xany.window != filter->window)
+		return false;
+
+	return filter->property == None || event->xproperty.atom == filter->property;
+}
+
+
+bool Plugin::waitWindowEvent(Window window, int type, Atom property)
+{
+	EventFilter filter = { window, type, property };
+
+	timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_nsec += kEmbedTimeout * 1000000L;
+	if(deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	XFlush(display_);
+
+	for(;;) {
+		// XCheckIfEvent() reads all events available on the connection without blocking.
+		XEvent event;
+		if(XCheckIfEvent(display_, &event, matchEvent, reinterpret_cast<XPointer>(&filter)))
+			return true;
+
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		long remaining = (deadline.tv_sec - now.tv_sec) * 1000 +
+				(deadline.tv_nsec - now.tv_nsec) / 1000000;
+
+		if(remaining <= 0)
+			return false;
+
+		pollfd pfd;
+		pfd.fd = ConnectionNumber(display_);
+		pfd.events = POLLIN;
+		poll(&pfd, 1, static_cast<int>(remaining));
+	}
+}
+
+
+void Plugin::watchEditor(Window window, Window parent)
+{
+	// Find the top-level window of the VST host.
+	Window topLevel = parent;
+	for(;;) {
+		Window root, windowParent;
+		Window* children;
+		unsigned int count;
+
+		if(!XQueryTree(display_, topLevel, &root, &windowParent, &children, &count))
+			break;
+
+		if(children)
+			XFree(children);
+
+		if(windowParent == root || windowParent == None)
+			break;
+
+		topLevel = windowParent;
+	}
+
+	editorWindows_[0] = window;
+	editorWindows_[1] = parent;
+	editorWindows_[2] = topLevel;
+
+	for(int i = 0; i < kEditorWindowCount; ++i)
+		isEditorMapped_[i] = true;
+
+	isEditorObscured_ = false;
+	isEditorVisible_ = true;
+
+	XSelectInput(display_, window, StructureNotifyMask | VisibilityChangeMask);
+	XSelectInput(display_, parent, StructureNotifyMask);
+	if(topLevel != parent)
+		XSelectInput(display_, topLevel, StructureNotifyMask);
+
+	XFlush(display_);
+}
+
+
+void Plugin::updateEditorState()
+{
+	// The events are drained even when the editor is closed, because the windows of
+	// the VST host stay selected until they are destroyed.
+	while(XPending(display_)) {
+		XEvent event;
+		XNextEvent(display_, &event);
+
+		if(editorWindows_[0] == None)
+			continue;
+
+		if(event.type == VisibilityNotify && event.xvisibility.window == editorWindows_[0]) {
+			isEditorObscured_ = event.xvisibility.state == VisibilityFullyObscured;
+			continue;
+		}
+
+		for(int i = 0; i < kEditorWindowCount; ++i) {
+			if(event.xany.window != editorWindows_[i])
+				continue;
+
+			if(event.type == MapNotify) {
+				isEditorMapped_[i] = true;
+			}
+			else if(event.type == UnmapNotify) {
+				isEditorMapped_[i] = false;
+			}
+			else if(event.type == DestroyNotify) {
+				editorWindows_[0] = None;
+			}
+		}
+	}
+
+	if(editorWindows_[0] == None)
+		return;
+
+	bool isVisible = !isEditorObscured_;
+	for(int i = 0; i < kEditorWindowCount; ++i)
+		isVisible = isVisible && isEditorMapped_[i];
+
+	if(isVisible == isEditorVisible_)
+		return;
+
+	isEditorVisible_ = isVisible;
+	DEBUG("Editor is %s", isVisible ? "visible" : "hidden");
+
+	DataFrame* frame = controlPort_.frame<DataFrame>();
+	frame->command = Command::EditorState;
+	frame->index = isVisible;
+	controlPort_.sendRequest();
+	controlPort_.waitResponse();
+}
+
+
+void Plugin::sendXembedMessage(Window window, long message, long detail, long data1,
+		long data2)
 {
 	XEvent event;
 
 	memset(&event, 0, sizeof(event));
 	event.xclient.type = ClientMessage;
 	event.xclient.window = window;
-	event.xclient.message_type = XInternAtom(display, "_XEMBED", false);
+	event.xclient.message_type = xembedAtom_;
 	event.xclient.format = 32;
 	event.xclient.data.l[0] = CurrentTime;
 	event.xclient.data.l[1] = message;
@@ -670,25 +1369,36 @@ void Plugin::sendXembedMessage(Display* display, Window window, long message, lo
 	event.xclient.data.l[3] = data1;
 	event.xclient.data.l[4] = data2;
 
-	XSendEvent(display, window, false, NoEventMask, &event);
-	XSync(display, false);
+	XSendEvent(display_, window, false, NoEventMask, &event);
 }
 
 
 float Plugin::getParameter(i32 index)
 {
+	bool isKnown = index >= 0 && index < static_cast<i32>(parameterValues_.size());
+
+	if(!acquireAudioPort("getParameter"))
+		return isKnown ? parameterValues_[index] : 0.0f;
+
 	DataFrame* frame = audioPort_.frame<DataFrame>();
 	frame->command = Command::GetParameter;
 	frame->index = index;
 
 	audioPort_.sendRequest();
 	audioPort_.waitResponse();
+
+	if(isKnown)
+		parameterValues_[index] = frame->opt;
+
 	return frame->opt;
 }
 
 
 void Plugin::setParameter(i32 index, float value)
 {
+	if(!acquireAudioPort("setParameter"))
+		return;
+
 	DataFrame* frame = audioPort_.frame<DataFrame>();
 	frame->command = Command::SetParameter;
 	frame->index = index;
@@ -696,50 +1406,127 @@ void Plugin::setParameter(i32 index, float value)
 
 	audioPort_.sendRequest();
 	audioPort_.waitResponse();
+
+	if(index >= 0 && index < static_cast<i32>(parameterValues_.size()))
+		parameterValues_[index] = value;
 }
 
 
 void Plugin::processReplacing(float** inputs, float** outputs, i32 count)
 {
+	timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if(!syncAudioPort(false)) {
+		countXrun();
+		updateProcessStats(start, false);
+
+		for(int i = 0; i < effect_->numOutputs; ++i)
+			std::memset(outputs[i], 0, sizeof(float) * count);
+
+		return;
+	}
+
 	DataFrame* frame = audioPort_.frame<DataFrame>();
 	frame->command = Command::ProcessSingle;
 	frame->value = count;
 	float* data = reinterpret_cast<float*>(frame->data);
+	size_t stride = channelStride<float>(count);
 
 	for(int i = 0; i < effect_->numInputs; ++i) {
 		std::memcpy(data, inputs[i], sizeof(float) * count);
-		data += count;
+		data += stride;
 	}
 
 	audioPort_.sendRequest();
-	audioPort_.waitResponse();
+
+	if(!waitProcessResponse(start, count)) {
+		updateProcessStats(start, false);
+
+		for(int i = 0; i < effect_->numOutputs; ++i)
+			std::memset(outputs[i], 0, sizeof(float) * count);
+
+		return;
+	}
+
+	updateProcessStats(start, true);
 
 	data = reinterpret_cast<float*>(frame->data);
 
+	if(isOutputSanitized_) {
+		for(int i = 0; i < effect_->numOutputs; ++i) {
+			OutputLevel* level = &outputLevels_[std::min(i, kStatsMeterChannels)];
+			copyOutput(outputs[i], data, count, outputLimit_, level);
+			data += stride;
+		}
+
+		updateOutputLevels(count);
+		return;
+	}
+
 	for(int i = 0; i < effect_->numOutputs; ++i) {
 		std::memcpy(outputs[i], data, sizeof(float) * count);
-		data += count;
+		data += stride;
 	}
 }
 
 
 void Plugin::processDoubleReplacing(double** inputs, double** outputs, i32 count)
 {
+	timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if(!syncAudioPort(false)) {
+		countXrun();
+		updateProcessStats(start, false);
+
+		for(int i = 0; i < effect_->numOutputs; ++i)
+			std::fill(outputs[i], outputs[i] + count, 0.0);
+
+		return;
+	}
+
 	DataFrame* frame = audioPort_.frame<DataFrame>();
 	frame->command = Command::ProcessDouble;
 	frame->value = count;
 	double* data = reinterpret_cast<double*>(frame->data);
+	size_t stride = channelStride<double>(count);
 
-	for(int i = 0; i < effect_->numInputs; ++i)
-		data = std::copy(inputs[i], inputs[i] + count, data);
+	for(int i = 0; i < effect_->numInputs; ++i) {
+		std::copy(inputs[i], inputs[i] + count, data);
+		data += stride;
+	}
 
 	audioPort_.sendRequest();
-	audioPort_.waitResponse();
+
+	if(!waitProcessResponse(start, count)) {
+		updateProcessStats(start, false);
+
+		for(int i = 0; i < effect_->numOutputs; ++i)
+			std::fill(outputs[i], outputs[i] + count, 0.0);
+
+		return;
+	}
+
+	updateProcessStats(start, true);
 
 	data = reinterpret_cast<double*>(frame->data);
 
-	for(int i = 0; i < effect_->numOutputs; ++i)
-		data = std::copy(outputs[i], outputs[i] + count, data);
+	if(isOutputSanitized_) {
+		for(int i = 0; i < effect_->numOutputs; ++i) {
+			OutputLevel* level = &outputLevels_[std::min(i, kStatsMeterChannels)];
+			copyOutput(outputs[i], data, count, double(outputLimit_), level);
+			data += stride;
+		}
+
+		updateOutputLevels(count);
+		return;
+	}
+
+	for(int i = 0; i < effect_->numOutputs; ++i) {
+		std::copy(data, data + count, outputs[i]);
+		data += stride;
+	}
 }
 
 
@@ -751,7 +1538,12 @@ intptr_t Plugin::dispatchProc(AEffect* effect, i32 opcode, i32 index, intptr_t v
 	// the audio port for processing it inside the dedicated audio thread by the host
 	// endpoint.
 
+	TimelineScope scope("Plugin::dispatch", kDispatchEvents[opcode]);
+
+	// On effClose the context is destroyed along with the plugin, nothing is logged
+	// after that until the scope ends.
 	Plugin* plugin = static_cast<Plugin*>(effect->object);
+	LogScope logScope(&plugin->logContext_);
 	DataPort* port;
 	RecursiveMutex* guard;
 
@@ -782,7 +1574,9 @@ intptr_t Plugin::dispatchProc(AEffect* effect, i32 opcode, i32 index, intptr_t v
 
 float Plugin::getParameterProc(AEffect* effect, i32 index)
 {
+	TimelineScope scope("Plugin::getParameter");
 	Plugin* plugin = static_cast<Plugin*>(effect->object);
+	LogScope logScope(&plugin->logContext_);
 
 	if(plugin->lastIndex_ != -1 && std::this_thread::get_id() == plugin->lastThreadId_) {
 		if(plugin->lastIndex_ != index) {
@@ -800,7 +1594,9 @@ float Plugin::getParameterProc(AEffect* effect, i32 index)
 
 void Plugin::setParameterProc(AEffect* effect, i32 index, float value)
 {
+	TimelineScope scope("Plugin::setParameter");
 	Plugin* plugin = static_cast<Plugin*>(effect->object);
+	LogScope logScope(&plugin->logContext_);
 	RecursiveLock lock(plugin->audioGuard_);
 	plugin->setParameter(index, value);
 }
@@ -809,7 +1605,9 @@ void Plugin::setParameterProc(AEffect* effect, i32 index, float value)
 void Plugin::processReplacingProc(AEffect* effect, float** inputs, float** outputs,
 		i32 sampleCount)
 {
+	TimelineScope scope("Plugin::processReplacing");
 	Plugin* plugin = static_cast<Plugin*>(effect->object);
+	LogScope logScope(&plugin->logContext_);
 	RecursiveLock lock(plugin->audioGuard_);
 	plugin->processReplacing(inputs, outputs, sampleCount);
 }
@@ -818,7 +1616,9 @@ void Plugin::processReplacingProc(AEffect* effect, float** inputs, float** outpu
 void Plugin::processDoubleReplacingProc(AEffect* effect, double** inputs,
 		double** outputs, i32 sampleCount)
 {
+	TimelineScope scope("Plugin::processDoubleReplacing");
 	Plugin* plugin = static_cast<Plugin*>(effect->object);
+	LogScope logScope(&plugin->logContext_);
 	RecursiveLock lock(plugin->audioGuard_);
 	plugin->processDoubleReplacing(inputs, outputs, sampleCount);
 }
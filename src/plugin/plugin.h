@@ -9,8 +9,15 @@
 #include <X11/Xlib.h>
 #include "common/dataport.h"
 #include "common/event.h"
+#include "common/latencystats.h"
+#include "common/logger.h"
+#include "common/protocol.h"
+#include "common/statsregistry.h"
 #include "common/vst24.h"
 #include "common/vsteventkeeper.h"
+#include "bootgate.h"
+#include "outputfilter.h"
+#include "startupprofile.h"
 
 
 namespace Airwave {
@@ -24,13 +31,30 @@ class Plugin {
 public:
 	Plugin(const std::string& vstPath, const std::string& hostPath,
 		   const std::string& prefixPath, const std::string& loaderPath,
-		   const std::string& logSocketPath, AudioMasterProc masterProc);
+		   const std::string& logSocketPath, const std::string& senderId,
+		   LogLevel logLevel, const HostOptions& hostOptions, int bootLimit,
+		   const StartupProfile& profile, AudioMasterProc masterProc);
 
 	~Plugin();
 
 	AEffect* effect();
 
+	int processDeadline() const;
+	void setProcessDeadline(int percent);
+
+	int hostKeepAlive() const;
+	void setHostKeepAlive(int seconds);
+
+	// The sanitized output is also metered, the clamping is applied only to it.
+	void setOutputFilter(bool isSanitized, bool isClamped);
+
+	static void requestStatsDump();
+
 private:
+	// The logger is shared by all plugin endpoints of the process, so every entry point
+	// of the endpoint logs with its own sender id and log level.
+	LogContext logContext_;
+
 	AudioMasterProc masterProc_;
 	AEffect* effect_;
 	ERect rect_;
@@ -50,6 +74,59 @@ private:
 	Event condition_;
 
 	int childPid_;
+	std::string timelinePartPath_;
+
+	// The boot slot of the WINE prefix is held until the VST plugin is initialized.
+	BootGate bootGate_;
+
+	// The X connection is opened on the first effEditOpen and kept until the plugin is
+	// closed, the atoms are interned once.
+	Display* display_;
+	Atom xembedAtom_;
+	Atom xembedInfoAtom_;
+
+	// The editor is hidden, when its window, the parent or the top-level window is
+	// unmapped, or when it is fully obscured. The state is tracked by X events only,
+	// since the windows of the VST host could be destroyed at any moment.
+	static const int kEditorWindowCount = 3;
+	Window editorWindows_[kEditorWindowCount];
+	bool isEditorMapped_[kEditorWindowCount];
+	bool isEditorObscured_;
+	bool isEditorVisible_;
+
+	// On close, the host process is parked for the keep-alive time instead of exiting,
+	// so the next instance of the same link could adopt it. The adopted process isn't a
+	// child of this endpoint, it is reaped by the endpoint, that started it.
+	std::string parkName_;
+	int hostKeepAlive_;
+	bool isChildProcess_;
+	bool isHostParked_;
+
+	// The process deadline is measured in percents of the block duration. When the
+	// host endpoint misses it, the output is filled with silence and the late response
+	// is consumed before the next request is sent through the audio port. Until then,
+	// the other requests of the audio threads are dropped instead of being waited for.
+	int processDeadline_;
+	float sampleRate_;
+	bool isResponsePending_;
+	u64 xrunCount_;
+	u64 droppedCount_;
+
+	// The output of the host endpoint is copied by copyOutput(), if it's sanitized. The
+	// channels beyond the metered ones share the last level, which is used only for the
+	// counters. The levels are published once per meter window.
+	bool isOutputSanitized_;
+	float outputLimit_;
+	OutputLevel outputLevels_[kStatsMeterChannels + 1];
+	i32 meterFrameCount_;
+
+	// The phases of the instantiation are reported once, after the first effOpen.
+	StartupProfile profile_;
+
+	LatencyStats latencyStats_;
+	InstanceStats* stats_;
+	int statsGeneration_;
+	static std::atomic<int> statsRequests_;
 
 	std::thread callbackThread_;
 	std::atomic_flag processCallbacks_;
@@ -64,8 +141,21 @@ private:
 	float lastValue_;
 	std::thread::id lastThreadId_;
 
+	// The last known values of the parameters, which are returned by getParameter(),
+	// while the audio port is busy with the late response.
+	std::vector<float> parameterValues_;
+
 	void callbackThread();
 
+	void dumpStats(DataPort* port);
+
+	bool syncAudioPort(bool wait);
+	bool acquireAudioPort(const char* request);
+	void countXrun();
+	bool waitProcessResponse(const timespec& start, i32 count);
+	void updateProcessStats(const timespec& start, bool isCompleted);
+	void updateOutputLevels(i32 count);
+
 	intptr_t setBlockSize(DataPort* port, intptr_t frames);
 
 	intptr_t handleAudioMaster();
@@ -73,8 +163,13 @@ private:
 	intptr_t dispatch(DataPort* port, i32 opcode, i32 index, intptr_t value, void* ptr,
 			float opt);
 
-	void sendXembedMessage(Display* display, Window window, long message, long detail,
-			long data1, long data2);
+	bool openDisplay();
+	bool waitWindowEvent(Window window, int type, Atom property = None);
+	void watchEditor(Window window, Window parent);
+	void updateEditorState();
+
+	void sendXembedMessage(Window window, long message, long detail, long data1,
+			long data2);
 
 	float getParameter(i32 index);
 	void setParameter(i32 index, float value);
@@ -0,0 +1,78 @@
+#include "startupprofile.h"
+
+#include "common/latencystats.h"
+#include "common/logger.h"
+#include "common/protocol.h"
+
+
+namespace Airwave {
+
+
+StartupProfile::StartupProfile() :
+	last_(monotonicTime()),
+	isAdopted_(false),
+	isReported_(false)
+{
+	for(int i = 0; i < kPhaseCount; ++i)
+		durations_[i] = 0;
+}
+
+
+void StartupProfile::begin()
+{
+	last_ = monotonicTime();
+}
+
+
+void StartupProfile::end(Phase phase)
+{
+	end(phase, monotonicTime());
+}
+
+
+void StartupProfile::end(Phase phase, u64 time)
+{
+	// The host timestamps could be taken before the previous phase was finished here.
+	if(time > last_) {
+		durations_[phase] += time - last_;
+		last_ = time;
+	}
+}
+
+
+void StartupProfile::addHostTimings(const HostTimings& timings)
+{
+	isAdopted_ = timings.isAdopted;
+
+	end(kBoot, timings.bootTime);
+	end(kLoadLibrary, timings.loadTime);
+	end(kConnect, timings.attachTime);
+	end(kVstMain, timings.mainTime);
+}
+
+
+void StartupProfile::report()
+{
+	if(isReported_)
+		return;
+
+	isReported_ = true;
+
+	u64 total = 0;
+	u64 us[kPhaseCount];
+	for(int i = 0; i < kPhaseCount; ++i) {
+		us[i] = durations_[i] / 1000;
+		total += us[i];
+	}
+
+	// All values are in microseconds. The format is parsed by the airwave-manager, so
+	// the record is sent even if the log level of the link is lower than trace.
+	REPORT("Startup profile: total=%llu config=%llu arch=%llu queue=%llu spawn=%llu "
+			"boot=%llu load=%llu connect=%llu main=%llu open=%llu block=%llu adopted=%d",
+			total, us[kConfig], us[kArch], us[kQueue], us[kSpawn], us[kBoot],
+			us[kLoadLibrary], us[kConnect], us[kVstMain], us[kOpen], us[kSetBlockSize],
+			isAdopted_);
+}
+
+
+} // namespace Airwave
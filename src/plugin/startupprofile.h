@@ -0,0 +1,58 @@
+#ifndef PLUGIN_STARTUPPROFILE_H
+#define PLUGIN_STARTUPPROFILE_H
+
+#include "common/types.h"
+
+
+namespace Airwave {
+
+
+struct HostTimings;
+
+
+// Durations of the plugin instantiation phases. The phases of the host endpoint are
+// measured by its own timestamps, which are comparable with the ones of this process,
+// because both use CLOCK_MONOTONIC. The profile is written to the log as a single
+// record, which is aggregated per link by the airwave-manager.
+class StartupProfile {
+public:
+	enum Phase {
+		kConfig,            // Lookup of the link
+		kArch,              // Detection of the VST plugin architecture
+		kQueue,             // Wait for the boot slot of the WINE prefix
+		kSpawn,             // posix_spawn() of the host endpoint
+		kBoot,              // WINE boot until the host endpoint's main()
+		kLoadLibrary,       // LoadLibrary() of the VST plugin
+		kConnect,           // Connection of the control port and the handshake
+		kVstMain,           // VSTPluginMain() of the VST plugin
+		kOpen,              // The first effOpen
+		kSetBlockSize,      // The first effSetBlockSize
+		kPhaseCount
+	};
+
+	StartupProfile();
+
+	// Starts the next phase, the time before it isn't counted.
+	void begin();
+
+	// Finishes the phase now or at the given time point.
+	void end(Phase phase);
+	void end(Phase phase, u64 time);
+
+	void addHostTimings(const HostTimings& timings);
+
+	// Writes the profile to the log, only the first call has an effect.
+	void report();
+
+private:
+	u64 durations_[kPhaseCount];
+	u64 last_;
+	bool isAdopted_;
+	bool isReported_;
+};
+
+
+} // namespace Airwave
+
+
+#endif // PLUGIN_STARTUPPROFILE_H
@@ -0,0 +1,70 @@
+// The plugin stub, copied for every link. It contains nothing but the VST entry points,
+// which forward to the bridge core library shared by all links, so the VST host maps the
+// bridge code only once.
+
+#include <cstdio>
+#include <dlfcn.h>
+#include "core.h"
+#include "common/config.h"
+
+
+using namespace Airwave;
+
+
+extern "C" {
+
+AEffect* VSTPluginMain(AudioMasterProc audioMasterProc);
+AEffect* mainStub(AudioMasterProc audioMasterProc) asm ("main");
+
+}
+
+
+static CoreEntryProc loadCore()
+{
+	// The core is never unloaded, its threads could still run when the last endpoint
+	// is closed.
+	void* handle = dlopen(CORE_PATH, RTLD_NOW | RTLD_LOCAL);
+	if(!handle) {
+		fprintf(stderr, PLUGIN_BASENAME ": unable to load %s: %s\n", CORE_PATH, dlerror());
+		return nullptr;
+	}
+
+	void* entry = dlsym(handle, kCoreEntryName);
+	if(!entry) {
+		fprintf(stderr, PLUGIN_BASENAME ": %s doesn't export %s\n", CORE_PATH,
+				kCoreEntryName);
+		return nullptr;
+	}
+
+	return reinterpret_cast<CoreEntryProc>(entry);
+}
+
+
+// Both entry points call this function directly, because the call to the exported
+// function could be resolved to another stub, that is loaded into the same process.
+static AEffect* createEndpoint(AudioMasterProc audioMasterProc)
+{
+	static CoreEntryProc coreEntry = loadCore();
+	if(!coreEntry)
+		return nullptr;
+
+	Dl_info info;
+	const char* linkPath = nullptr;
+	if(dladdr(reinterpret_cast<void*>(loadCore), &info) != 0)
+		linkPath = info.dli_fname;
+
+	return coreEntry(kCoreInterfaceVersion, linkPath, audioMasterProc);
+}
+
+
+AEffect* VSTPluginMain(AudioMasterProc audioMasterProc)
+{
+	return createEndpoint(audioMasterProc);
+}
+
+
+// Deprecated main() stub which is still used by some hosts
+AEffect* mainStub(AudioMasterProc audioMasterProc)
+{
+	return createEndpoint(audioMasterProc);
+}